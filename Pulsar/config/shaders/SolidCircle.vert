@@ -11,7 +11,7 @@ out vec4 t_Color;
 out vec2 t_LBPos;
 
 void main() {
-	t_Color = i_Color;
+	t_Color = premultiply(i_Color);
 	t_LBPos = i_PositionAndLocalBounds.zw;
 
 	// model matrix
@@ -13,8 +13,8 @@ out float t_InnerRadius;
 out vec4 t_InnerColor, t_OuterColor;
 
 void main() {
-	t_OuterColor = i_OuterColor;
-	t_InnerColor = i_InnerColor;
+	t_OuterColor = premultiply(i_OuterColor);
+	t_InnerColor = premultiply(i_InnerColor);
 	gl_PointSize = i_PointSizeInnerRadius.x;
 	t_InnerRadius = i_PointSizeInnerRadius.y;
 	
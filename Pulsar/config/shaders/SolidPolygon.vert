@@ -10,7 +10,7 @@ uniform mat3 u_VP = mat3(vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0
 out vec4 t_Color;
 
 void main() {
-	t_Color = i_Color;
+	t_Color = premultiply(i_Color);
 	
 	// model matrix
 	mat3 M = mat3(vec3(i_TransformRS[0], i_TransformRS[1], 0.0), vec3(i_TransformRS[2], i_TransformRS[3], 0.0), vec3(i_TransformP[0], i_TransformP[1], 1.0));
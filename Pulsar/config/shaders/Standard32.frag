@@ -6,13 +6,34 @@ in vec4 t_Color;
 in float t_TexSlot;
 in vec2 t_TexCoord;
 
+#if defined(PULSAR_SINGLE_TEXTURE)
+layout(binding=0) uniform sampler2D TEXTURE_SLOTS[1];
+#elif !defined(PULSAR_UNTEXTURED)
 layout(binding=0) uniform sampler2D TEXTURE_SLOTS[32];
+#endif
 
+// Variants: PULSAR_UNTEXTURED and PULSAR_SINGLE_TEXTURE remove the slot branch and dynamic sampler indexing, PULSAR_UNMODULATED removes the color multiply.
 void main() {
+#if defined(PULSAR_UNTEXTURED)
+#if defined(PULSAR_UNMODULATED)
+	o_Color = vec4(1.0);
+#else
+	o_Color = t_Color;
+#endif
+#else
+#if defined(PULSAR_SINGLE_TEXTURE)
+	vec4 texel = texture(TEXTURE_SLOTS[0], t_TexCoord);
+#else
 	if (t_TexSlot < 0) {
 		o_Color = t_Color;
-	} else {
-	// TODO BPP in shaders only work for =4. Create different shaders for each BPP? Or define attribute? Or define uniform instead of different shaders.
-		o_Color = t_Color * texture(TEXTURE_SLOTS[int(t_TexSlot)], t_TexCoord);
+		return;
 	}
+	vec4 texel = texture(TEXTURE_SLOTS[int(t_TexSlot)], t_TexCoord);
+#endif
+#if defined(PULSAR_UNMODULATED)
+	o_Color = texel;
+#else
+	o_Color = t_Color * texel;
+#endif
+#endif
 }
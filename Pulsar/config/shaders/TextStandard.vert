@@ -14,7 +14,7 @@ out float t_TexSlot;
 out vec2 t_TexCoord;
 
 void main() {
-	t_Color = i_Color;
+	t_Color = premultiply(i_Color);
 	t_TexSlot = i_TexSlot;
 	t_TexCoord = i_TexCoord;
 
@@ -13,6 +13,10 @@ void main() {
 		o_Color = t_Color;
 	} else {
 		float grayscale = texture(TEXTURE_SLOTS[int(t_TexSlot)], t_TexCoord).r;
+#if defined(PULSAR_PREMULTIPLIED_ALPHA)
+		o_Color = t_Color * grayscale;
+#else
 		o_Color = t_Color * vec4(1.0, 1.0, 1.0, grayscale);
+#endif
 	}
 }
@@ -0,0 +1,608 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+#include <toml/toml.hpp>
+
+#include "JobSystem.h"
+#include "Logger.inl"
+#include "Macros.h"
+#include "registry/Texture.h"
+#include "registry/TextureCache.h"
+#include "registry/Tile.h"
+#include "registry/compound/Atlas.h"
+#include "registry/compound/AtlasCache.h"
+#include "render/Renderer.h"
+#include "render/TextureUploader.h"
+#include "utils/FrameArena.h"
+#include "utils/PixelKernels.h"
+#include "utils/Functor.inl"
+
+static std::atomic<unsigned long long> heap_allocations = 0;
+
+#if PULSAR_RUN_BENCHMARKS
+// Counts every heap allocation of the process, so that per-frame allocations can be reported.
+void* operator new(size_t bytes)
+{
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(bytes ? bytes : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+// Times a parallel-for over a transcendental-heavy array update for 1 to N threads, where N is the hardware concurrency.
+void Sandbox::benchmark_job_scaling()
+{
+	constexpr size_t count = 1 << 20;
+	constexpr int iterations = 20;
+	std::vector<float> data(count, 1.0f);
+	unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	double serial_ms = 0.0;
+	for (unsigned int threads = 1; threads <= max_threads; ++threads)
+	{
+		JobSystem::Init(threads - 1);
+		auto start = std::chrono::steady_clock::now();
+		for (int it = 0; it < iterations; ++it)
+		{
+			JobSystem::ParallelFor(count, 4096, [&data](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i)
+					data[i] = std::sin(data[i]) * std::cos(data[i]) + 1.0f;
+			});
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+		if (threads == 1)
+			serial_ms = ms;
+		Logger::LogInfo("Job scaling: " + std::to_string(threads) + " thread(s): " + std::to_string(ms) + " ms/iteration, speedup "
+			+ std::to_string(serial_ms / ms) + "x");
+	}
+	JobSystem::Terminate();
+}
+
+// Called once per frame. Logs the average number of heap allocations per frame over the last 300 frames, and the frame arena usage of the last completed frame.
+// Compare runs with frame_arena_block_size = 0 (transient allocations on the heap) and the default block size.
+void Sandbox::report_frame_allocations()
+{
+	constexpr unsigned int report_period = 300;
+	static unsigned int frames = 0;
+	static unsigned long long last_allocations = heap_allocations.load();
+	if (++frames < report_period)
+		return;
+	unsigned long long allocations = heap_allocations.load();
+	Logger::LogInfo("Heap allocations per frame: " + std::to_string(static_cast<double>(allocations - last_allocations) / frames)
+		+ " (frame arena " + (FrameArena::Enabled() ? "enabled, " + std::to_string(FrameArena::LastFrameBytes()) + " bytes last frame" : std::string("disabled")) + ")");
+	last_allocations = heap_allocations.load();
+	frames = 0;
+}
+
+// The previous Functor design, kept for comparison: the enclosure lives on the heap, calls are virtual, and every copy clones.
+template<typename Ret, typename Arg, typename Cls>
+class LegacyFunctor
+{
+	struct Interface
+	{
+		virtual ~Interface() = default;
+		virtual Ret operator()(Arg arg) = 0;
+		virtual Interface* clone() = 0;
+	};
+	struct Enclosure : public Interface
+	{
+		Ret(*function)(Arg, Cls);
+		Cls closure;
+		Enclosure(Ret(*function)(Arg, Cls), Cls closure) : function(function), closure(closure) {}
+		Ret operator()(Arg arg) override { return function(arg, closure); }
+		Interface* clone() override { return new Enclosure(function, closure); }
+	};
+	Interface* f = nullptr;
+
+public:
+	LegacyFunctor(Ret(*function)(Arg, Cls), Cls closure) : f(new Enclosure(function, closure)) {}
+	LegacyFunctor(const LegacyFunctor& other) : f(other.f->clone()) {}
+	LegacyFunctor(LegacyFunctor&& other) noexcept : f(other.f) { other.f = nullptr; }
+	~LegacyFunctor() { delete f; }
+	Ret operator()(Arg arg) const { return (*f)(arg); }
+};
+
+template<typename F>
+static void time_functor(const char* name, const F& make)
+{
+	constexpr size_t count = 1 << 16;
+	constexpr int calls = 64;
+	std::vector<decltype(make(0))> functors;
+	functors.reserve(count);
+	unsigned long long allocations = heap_allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+		functors.push_back(make(static_cast<int>(i)));
+	auto constructed = std::chrono::steady_clock::now();
+	std::vector<decltype(make(0))> copies(functors.begin(), functors.end());
+	auto copied = std::chrono::steady_clock::now();
+	long long sum = 0;
+	for (int c = 0; c < calls; ++c)
+	{
+		for (const auto& f : copies)
+			sum += f(c);
+	}
+	auto called = std::chrono::steady_clock::now();
+	auto ns = [](auto a, auto b, double n) { return std::to_string(std::chrono::duration<double, std::nano>(b - a).count() / n); };
+	Logger::LogInfo(std::string("Functor (") + name + "): construct " + ns(start, constructed, count) + " ns, copy " + ns(constructed, copied, count)
+		+ " ns, call " + ns(copied, called, static_cast<double>(count) * calls) + " ns, heap allocations " + std::to_string(heap_allocations.load() - allocations)
+		+ " (checksum " + std::to_string(sum) + ")");
+}
+
+// Compares construction, copy and call cost of Functor with the previous heap-allocated, virtual design. Heap allocations are only counted with PULSAR_RUN_BENCHMARKS.
+void Sandbox::benchmark_functor()
+{
+	struct Closure { int offset; float scale; void* owner; };
+	time_functor("legacy", [](int i) {
+		return LegacyFunctor<int, int, Closure>([](int x, Closure c) { return static_cast<int>(x * c.scale) + c.offset; }, { i, 2.0f, nullptr });
+	});
+	time_functor("inline", [](int i) {
+		return make_functor<true>([](int x, Closure c) { return static_cast<int>(x * c.scale) + c.offset; }, Closure{ i, 2.0f, nullptr });
+	});
+	time_functor("lambda capture", [](int i) {
+		return Functor<int, int>([i](int x) { return 2 * x + i; });
+	});
+}
+
+// Cooks every image in res/textures to BCn, and checks the round trip through decompression against a PSNR threshold, and through a KTX2 file for exact equality.
+// Also compares loading the KTX2 file with decoding the source image. Only uses the CPU, so it runs before the renderer starts.
+void Sandbox::benchmark_texture_cache()
+{
+	constexpr double min_psnr = 30.0;
+	JobSystem::Init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "pulsar_texture_cache_benchmark";
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	auto ms = [](auto a, auto b) { return std::to_string(std::chrono::duration<double, std::milli>(b - a).count()); };
+	for (const auto& entry : std::filesystem::directory_iterator("res/textures", ec))
+	{
+		if (entry.path().extension() != ".png")
+			continue;
+		std::string filepath = entry.path().string();
+		auto start = std::chrono::steady_clock::now();
+		Tile tile{ TileConstructArgs_filepath(filepath) };
+		auto decoded = std::chrono::steady_clock::now();
+		CompressedImage image;
+		if (!TextureCache::Cook(tile, Texture::linear_settings, image, 0.0f))
+			continue;
+		auto cooked = std::chrono::steady_clock::now();
+
+		std::vector<unsigned char> source, round_trip;
+		CompressedImage uncompressed;
+		TextureCache::Cook(tile, Texture::linear_settings, uncompressed, INFINITY);
+		TextureCache::Decompress(uncompressed, 0, source);
+		TextureCache::Decompress(image, 0, round_trip);
+		bool alpha = image.format == CompressedFormat::BC3;
+		double psnr = TextureCache::PSNR(round_trip.data(), source.data(), source.size() / 4, alpha);
+
+		std::string ktx2 = (directory / (entry.path().stem().string() + ".ktx2")).string();
+		CompressedImage loaded;
+		TextureCache::WriteKTX2(ktx2, image);
+		auto load_start = std::chrono::steady_clock::now();
+		bool read = TextureCache::ReadKTX2(ktx2, loaded);
+		auto load_end = std::chrono::steady_clock::now();
+		if (!read || loaded.format != image.format || loaded.data != image.data)
+			Logger::LogError("Texture cache: KTX2 round trip of \"" + filepath + "\" does not match.");
+
+		Logger::LogInfo("Texture cache: " + filepath + " " + std::to_string(tile.GetWidth()) + "x" + std::to_string(tile.GetHeight()) + " " + (alpha ? "BC3" : "BC1")
+			+ ": PSNR " + std::to_string(psnr) + " dB" + (psnr < min_psnr ? " (below " + std::to_string(min_psnr) + ")" : "")
+			+ ", decode " + ms(start, decoded) + " ms, cook " + ms(decoded, cooked) + " ms, KTX2 load " + ms(load_start, load_end) + " ms, "
+			+ std::to_string(image.data.size()) + " of " + std::to_string(uncompressed.data.size()) + " bytes");
+	}
+	std::filesystem::remove_all(directory, ec);
+	JobSystem::Terminate();
+}
+
+// Packs the images in res/textures, and synthetic sets of small tiles, with every strategy, with and without rotation, into atlases sized to fit.
+// Only image headers are read, so it runs before the renderer starts. The guillotine packer is skipped for large sets, which take it seconds.
+void Sandbox::benchmark_atlas_packing()
+{
+	constexpr int border = 1;
+	constexpr size_t guillotine_limit = 500;
+	std::vector<std::pair<std::string, std::vector<Placement>>> sets;
+	std::vector<Placement> textures;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator("res/textures", ec))
+	{
+		int width, height, bpp;
+		if (stbi_info(entry.path().string().c_str(), &width, &height, &bpp))
+			textures.push_back({ static_cast<TileHandle>(textures.size() + 1), 0, 0, width + border, height + border, false });
+	}
+	sets.push_back({ "res/textures", std::move(textures) });
+	std::mt19937 rng(1);
+	for (size_t count : { 250, 2000 })
+	{
+		std::vector<Placement> tiles;
+		for (size_t i = 0; i < count; ++i)
+			tiles.push_back({ static_cast<TileHandle>(i + 1), 0, 0, 8 + static_cast<int>(rng() % 57) + border, 8 + static_cast<int>(rng() % 57) + border, false });
+		sets.push_back({ std::to_string(count) + " tiles of 8-64 px", std::move(tiles) });
+	}
+
+	const std::pair<AtlasPacking, const char*> packings[] = {
+		{ AtlasPacking::Guillotine, "guillotine" }, { AtlasPacking::MaxRects, "maxrects" }, { AtlasPacking::Skyline, "skyline" } };
+	for (auto& [name, rects] : sets)
+	{
+		std::stable_sort(rects.begin(), rects.end(), [](const Placement& a, const Placement& b) { return std::max(a.w, a.h) > std::max(b.w, b.h); });
+		for (const auto& [packing, packing_name] : packings)
+		{
+			if (packing == AtlasPacking::Guillotine && rects.size() > guillotine_limit)
+				continue;
+			for (bool rotation : { false, true })
+			{
+				std::vector<Placement> placements = rects;
+				int width = -1, height = -1;
+				AtlasPackStats stats = Atlas::PackRects(placements, width, height, packing, rotation);
+				Logger::LogInfo("Atlas packing: " + name + ", " + packing_name + (rotation ? " with rotation" : "") + ": " + std::to_string(width) + "x"
+					+ std::to_string(height) + ", " + std::to_string(stats.occupancy * 100.0f) + "% occupancy, " + std::to_string(stats.failed) + " failed, "
+					+ std::to_string(stats.milliseconds) + " ms");
+			}
+		}
+	}
+}
+
+// Expected RGBA of texel (x, y) of a tile, read one channel at a time.
+static void reference_texel(const std::vector<unsigned char>& tile, int width, int bpp, int x, int y, unsigned char* rgba)
+{
+	const unsigned char* texel = tile.data() + (static_cast<size_t>(y) * width + x) * bpp;
+	if (bpp >= 3)
+	{
+		rgba[0] = texel[0];
+		rgba[1] = texel[1];
+		rgba[2] = texel[2];
+	}
+	else
+		rgba[0] = rgba[1] = rgba[2] = texel[0];
+	rgba[3] = bpp == 4 ? texel[3] : bpp == 2 ? texel[1] : 255;
+}
+
+// Places random tiles of every BPP, rotated and not, into an atlas with Atlas::BlitTile in parallel, and verifies every texel against a per-texel reference.
+// Also times the reference placement against the blits.
+void Sandbox::benchmark_atlas_placement()
+{
+	constexpr int border = 1;
+	JobSystem::Init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	std::mt19937 rng(2);
+	std::vector<std::vector<unsigned char>> tiles;
+	std::vector<int> bpps;
+	std::vector<Placement> placements;
+	for (size_t i = 0; i < 2000; ++i)
+	{
+		int width = 4 + static_cast<int>(rng() % 93), height = 4 + static_cast<int>(rng() % 93), bpp = 1 + static_cast<int>(rng() % 4);
+		std::vector<unsigned char> tile(static_cast<size_t>(width) * height * bpp);
+		for (unsigned char& c : tile)
+			c = static_cast<unsigned char>(rng());
+		tiles.push_back(std::move(tile));
+		bpps.push_back(bpp);
+		placements.push_back({ static_cast<TileHandle>(i), 0, 0, width + border, height + border, false });
+	}
+	int atlas_width = -1, atlas_height = -1;
+	Atlas::PackRects(placements, atlas_width, atlas_height, AtlasPacking::Skyline, true);
+	auto tile_size = [&](const Placement& p) { return std::pair<int, int>{ (p.r ? p.h : p.w) - border, (p.r ? p.w : p.h) - border }; };
+
+	std::vector<unsigned char> expected(static_cast<size_t>(atlas_width) * atlas_height * Atlas::BPP, 0);
+	auto start = std::chrono::steady_clock::now();
+	for (const Placement& p : placements)
+	{
+		if (p.x < 0)
+			continue;
+		auto [width, height] = tile_size(p);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				int ax = p.x + border + (p.r ? y : x), ay = p.y + border + (p.r ? x : y);
+				reference_texel(tiles[p.tile], width, bpps[p.tile], x, y, expected.data() + (static_cast<size_t>(ay) * atlas_width + ax) * Atlas::BPP);
+			}
+		}
+	}
+	auto reference_end = std::chrono::steady_clock::now();
+
+	std::vector<unsigned char> atlas(expected.size(), 0);
+	auto blit_start = std::chrono::steady_clock::now();
+	JobSystem::ParallelFor(placements.size(), 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const Placement& p = placements[i];
+			if (p.x < 0)
+				continue;
+			auto [width, height] = tile_size(p);
+			Atlas::BlitTile(tiles[p.tile].data(), width, height, bpps[p.tile], p.r, atlas.data(), atlas_width, p.x + border, p.y + border);
+		}
+	});
+	auto blit_end = std::chrono::steady_clock::now();
+
+	size_t rotated = std::count_if(placements.begin(), placements.end(), [](const Placement& p) { return p.r; });
+	size_t mismatches = 0;
+	for (size_t i = 0; i < atlas.size(); i += Atlas::BPP)
+		mismatches += memcmp(atlas.data() + i, expected.data() + i, Atlas::BPP) != 0;
+	auto ms = [](auto a, auto b) { return std::to_string(std::chrono::duration<double, std::milli>(b - a).count()); };
+	Logger::LogInfo("Atlas placement: " + std::to_string(placements.size()) + " tiles (" + std::to_string(rotated) + " rotated) into " + std::to_string(atlas_width)
+		+ "x" + std::to_string(atlas_height) + ": reference " + ms(start, reference_end) + " ms, blits " + ms(blit_start, blit_end) + " ms.");
+	if (mismatches)
+		Logger::LogError("Atlas placement: " + std::to_string(mismatches) + " texels differ from the reference.");
+	JobSystem::Terminate();
+}
+
+// Packs the images in res/textures into an atlas, saved like Loader::saveAtlas as an asset file and a PNG, and as atlas cache files with and without LZ4.
+// Compares loading each: parsing the asset file and decoding the PNG, against mapping the cache file, hashing the sources and copying or decompressing the pixels.
+// Only uses the CPU, so it runs before the renderer starts.
+void Sandbox::benchmark_atlas_cache()
+{
+	constexpr int border = 1;
+	constexpr int max_source_size = 4096;
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "pulsar_atlas_cache_benchmark";
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	std::vector<Tile> tiles;
+	std::vector<Placement> placements;
+	for (const auto& entry : std::filesystem::directory_iterator("res/textures", ec))
+	{
+		int width, height, bpp;
+		std::string filepath = entry.path().string();
+		if (entry.path().extension() != ".png" || !stbi_info(filepath.c_str(), &width, &height, &bpp) || width > max_source_size || height > max_source_size)
+			continue;
+		Tile tile{ TileConstructArgs_filepath(filepath) };
+		if (!tile)
+			continue;
+		placements.push_back({ static_cast<TileHandle>(tiles.size()), 0, 0, width + border, height + border, false });
+		tiles.push_back(std::move(tile));
+	}
+	if (tiles.empty())
+		return;
+	int width = -1, height = -1;
+	Atlas::PackRects(placements, width, height, AtlasPacking::MaxRects);
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * Atlas::BPP, 0);
+	for (Placement& p : placements)
+	{
+		if (p.x >= 0)
+		{
+			const Tile& tile = tiles[p.tile];
+			Atlas::BlitTile(tile.GetImageBuffer(), tile.GetWidth(), tile.GetHeight(), tile.GetBPP(), p.r, pixels.data(), width, p.x + border, p.y + border);
+		}
+		p.tile = 0;
+	}
+
+	std::string png = (directory / "atlas.png").string(), asset = (directory / "atlas.toml").string();
+	stbi_flip_vertically_on_write(true);
+	stbi_write_png(png.c_str(), width, height, Atlas::BPP, pixels.data(), width * Atlas::STRIDE_BYTES);
+	{
+		toml::array placement_array;
+		for (const Placement& p : placements)
+			placement_array.push_back(toml::table{ { "x", p.x }, { "y", p.y }, { "w", p.w }, { "h", p.h }, { "r", p.r } });
+		std::ofstream out(asset);
+		out << toml::table{ { "header", "atlas" }, { "atlas", toml::table{ { "path", png }, { "border", border }, { "placement", placement_array } } } };
+	}
+
+	auto ms = [](auto a, auto b) { return std::to_string(std::chrono::duration<double, std::milli>(b - a).count()); };
+	auto kib = [](const std::string& filepath) { std::error_code ec; return std::to_string(std::filesystem::file_size(filepath, ec) / 1024) + " KiB"; };
+	auto parse_start = std::chrono::steady_clock::now();
+	std::vector<Placement> parsed;
+	auto file = toml::parse_file(asset);
+	if (auto placement_array = file["atlas"]["placement"].as_array())
+	{
+		for (const auto& node : *placement_array)
+		{
+			const toml::table& t = *node.as_table();
+			parsed.push_back({ 0, t["x"].value_or(0), t["y"].value_or(0), t["w"].value_or(0), t["h"].value_or(0), t["r"].value_or(false) });
+		}
+	}
+	Tile decoded{ TileConstructArgs_filepath(png) };
+	auto parse_end = std::chrono::steady_clock::now();
+	std::string report = "Atlas cache: " + std::to_string(width) + "x" + std::to_string(height) + ", " + std::to_string(placements.size()) + " placements: asset file and PNG "
+		+ ms(parse_start, parse_end) + " ms (" + kib(png) + ")";
+	if (parsed != placements)
+		Logger::LogError("Atlas cache: the asset file round trip does not match.");
+
+	AtlasCacheEntry entry;
+	entry.texture_filepath = png;
+	entry.width = decoded.GetWidth();
+	entry.height = decoded.GetHeight();
+	entry.bpp = decoded.GetBPP();
+	entry.border = border;
+	entry.premultiplied = PulsarSettings::premultiplied_alpha();
+	entry.placements = parsed;
+	AtlasCache::SourceHash(asset.c_str(), png.c_str(), entry.source_hash);
+	size_t size = static_cast<size_t>(entry.width) * entry.height * entry.bpp;
+	for (bool compress : { false, true })
+	{
+		std::string cache = (directory / (compress ? "lz4.atlas" : "raw.atlas")).string();
+		AtlasCache::Write(cache, entry, decoded.GetImageBuffer(), compress);
+		AtlasCacheEntry read;
+		const unsigned char* read_pixels = nullptr;
+		std::unique_ptr<MappedFile> mapping;
+		auto load_start = std::chrono::steady_clock::now();
+		bool loaded = AtlasCache::Read(cache, asset.c_str(), read, read_pixels, mapping);
+		auto load_end = std::chrono::steady_clock::now();
+		if (!loaded || read.placements != entry.placements || read.width != entry.width || read.height != entry.height || read.bpp != entry.bpp
+			|| memcmp(read_pixels, decoded.GetImageBuffer(), size) != 0)
+			Logger::LogError(std::string("Atlas cache: the ") + (compress ? "LZ4 " : "") + "cache round trip does not match.");
+		if (!mapping)
+			delete[] read_pixels;
+		report += std::string(", ") + (compress ? "LZ4 cache " : "cache ") + ms(load_start, load_end) + " ms (" + kib(cache) + ")";
+	}
+	Logger::LogInfo(report);
+
+	// a changed source must invalidate the cache
+	{
+		std::ofstream out(asset, std::ios_base::app);
+		out << "\n";
+	}
+	AtlasCacheEntry stale;
+	const unsigned char* stale_pixels = nullptr;
+	std::unique_ptr<MappedFile> stale_mapping;
+	if (AtlasCache::Read((directory / "raw.atlas").string(), asset.c_str(), stale, stale_pixels, stale_mapping))
+	{
+		Logger::LogError("Atlas cache: a cache file of a changed asset file was loaded.");
+		if (!stale_mapping)
+			delete[] stale_pixels;
+	}
+	std::filesystem::remove_all(directory, ec);
+}
+
+// Times every pixel kernel with every instruction set the CPU supports on a 2048x2048 image of random texels,
+// and checks each output for exact equality with the scalar kernel's. Premultiplication is also checked for every color and alpha pair.
+void Sandbox::benchmark_pixel_kernels()
+{
+	using PixelKernels::ISA;
+	constexpr int size = 2048;
+	constexpr size_t texels = static_cast<size_t>(size) * size;
+	constexpr int repeats = 5;
+	ISA active = PixelKernels::Active();
+	std::mt19937 rng(3);
+	std::vector<unsigned char> source(texels * 4);
+	for (unsigned char& c : source)
+		c = static_cast<unsigned char>(rng());
+	std::vector<unsigned char> pairs(256 * 256 * 4);
+	for (size_t i = 0; i < 256 * 256; ++i)
+	{
+		pairs[i * 4] = pairs[i * 4 + 1] = pairs[i * 4 + 2] = static_cast<unsigned char>(i >> 8);
+		pairs[i * 4 + 3] = static_cast<unsigned char>(i);
+	}
+
+	// in place kernels start from a copy of their input, made outside the timing
+	struct Kernel
+	{
+		const char* name;
+		const std::vector<unsigned char>* in_place;
+		size_t out_size;
+		std::function<void(unsigned char* out)> run;
+	};
+	const Kernel kernels[] = {
+		{ "flip", &source, 0, [&](unsigned char* out) { PixelKernels::FlipVertically(out, size, static_cast<size_t>(size) * 4); } },
+		{ "RGB to RGBA", nullptr, texels * 4, [&](unsigned char* out) { PixelKernels::RGBToRGBA(source.data(), out, texels); } },
+		{ "grey to RGBA", nullptr, texels * 4, [&](unsigned char* out) { PixelKernels::GreyToRGBA(source.data(), out, texels); } },
+		{ "grey alpha to RGBA", nullptr, texels * 4, [&](unsigned char* out) { PixelKernels::GreyAlphaToRGBA(source.data(), out, texels); } },
+		{ "premultiply", &source, 0, [&](unsigned char* out) { PixelKernels::Premultiply(out, texels); } },
+		{ "premultiply every color and alpha", &pairs, 0, [&](unsigned char* out) { PixelKernels::Premultiply(out, pairs.size() / 4); } },
+		{ "downsample", nullptr, texels, [&](unsigned char* out) { PixelKernels::Downsample(source.data(), size, size, out); } },
+	};
+	for (const Kernel& kernel : kernels)
+	{
+		std::vector<unsigned char> reference, out;
+		std::string report = std::string("Pixel kernels: ") + kernel.name + ":";
+		for (ISA isa : { ISA::Scalar, ISA::SSE2, ISA::AVX2, ISA::NEON })
+		{
+			if (!PixelKernels::Select(isa))
+				continue;
+			double best = INFINITY;
+			for (int i = 0; i < repeats; ++i)
+			{
+				if (kernel.in_place)
+					out = *kernel.in_place;
+				else
+					out.assign(kernel.out_size, 0);
+				auto start = std::chrono::steady_clock::now();
+				kernel.run(out.data());
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			if (isa == ISA::Scalar)
+				reference = out;
+			else if (out != reference)
+				Logger::LogError(std::string("Pixel kernels: ") + kernel.name + " with " + PixelKernels::Name(isa) + " does not match the scalar kernel.");
+			report += std::string(" ") + PixelKernels::Name(isa) + " " + std::to_string(best) + " ms";
+		}
+		Logger::LogInfo(report);
+	}
+	PixelKernels::Select(active);
+}
+
+// Level 0 of the bound texture, read back tightly packed in the format it was uploaded with.
+static std::vector<unsigned char> read_back(int width, int height, int bpp)
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * bpp);
+	PULSAR_TRY(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	PULSAR_TRY(glGetTexImage(GL_TEXTURE_2D, 0, formats[bpp - 1], GL_UNSIGNED_BYTE, pixels.data()));
+	return pixels;
+}
+
+// Uploads random tiles of every BPP and odd sizes through a TextureUploader, whose small unpack buffer is orphaned and wrapped several times,
+// and compares each texture's level 0 with its source tile. Then replaces a region of an RGBA texture through SubImage with a row length, and checks it too.
+// Needs the GL context, so it runs after start-up.
+void Sandbox::check_texture_uploads()
+{
+	std::mt19937 rng(3);
+	std::vector<std::vector<unsigned char>> sources;
+	for (size_t i = 0; i < 64; ++i)
+	{
+		int width = 1 + static_cast<int>(rng() % 97), height = 1 + static_cast<int>(rng() % 97), bpp = 1 + static_cast<int>(i % 4);
+		std::vector<unsigned char> source(static_cast<size_t>(width) * height * bpp + 3);
+		for (unsigned char& c : source)
+			c = static_cast<unsigned char>(rng());
+		// the first three bytes carry the size, so the finish callback can check the texture against it
+		source[0] = static_cast<unsigned char>(width);
+		source[1] = static_cast<unsigned char>(height);
+		source[2] = static_cast<unsigned char>(bpp);
+		sources.push_back(std::move(source));
+	}
+	size_t uploads = 0, mismatches = 0, failures = 0;
+	bool region_checked = false;
+	Renderer::_GLInvoke([&]() {
+		TextureUploader uploader(1 << 14);
+		for (const auto& source : sources)
+		{
+			int width = source[0], height = source[1], bpp = source[2];
+			const unsigned char* pixels = source.data() + 3;
+			TextureUploader::Upload upload;
+			upload.tile = std::make_unique<Tile>(TileConstructArgs_buffer(const_cast<unsigned char*>(pixels), width, height, bpp, TileDeletionPolicy::FROM_EXTERNAL));
+			upload.settings = Texture::nearest_settings;
+			upload.finish = [&, width, height, bpp, pixels](Texture* texture) {
+				++uploads;
+				if (!texture || texture->GetWidth() != width || texture->GetHeight() != height)
+				{
+					++failures;
+					return;
+				}
+				PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, texture->GetRID()));
+				mismatches += memcmp(read_back(width, height, bpp).data(), pixels, static_cast<size_t>(width) * height * bpp) != 0;
+				if (bpp != 4 || region_checked || width < 8 || height < 8)
+				{
+					PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+					return;
+				}
+				// replace the inner region with the tile's own top-left corner, whose rows keep the tile's row length
+				region_checked = true;
+				int region_width = width / 2, region_height = height / 2, x = width / 4, y = height / 4;
+				uploader.SubImage(*texture, pixels, x, y, region_width, region_height, width);
+				std::vector<unsigned char> expected(pixels, pixels + static_cast<size_t>(width) * height * 4);
+				for (int row = 0; row < region_height; ++row)
+					memcpy(expected.data() + ((static_cast<size_t>(y) + row) * width + x) * 4, pixels + static_cast<size_t>(row) * width * 4, static_cast<size_t>(region_width) * 4);
+				PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, texture->GetRID()));
+				mismatches += read_back(width, height, 4) != expected;
+				PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+			};
+			uploader.Enqueue(std::move(upload));
+		}
+		while (uploader.Size() > 0)
+			uploader.Pump(1 << 13);
+	});
+	Logger::LogInfo("Texture uploads: " + std::to_string(uploads) + " tiles uploaded through the unpack buffer" + (region_checked ? ", and one region replaced." : "."));
+	if (failures || mismatches)
+		Logger::LogError("Texture uploads: " + std::to_string(failures) + " uploads failed and " + std::to_string(mismatches) + " textures differ from their source.");
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace Sandbox {
+
+	void benchmark_job_scaling();
+	void benchmark_functor();
+	void benchmark_texture_cache();
+	void benchmark_atlas_packing();
+	void benchmark_atlas_placement();
+	void benchmark_atlas_cache();
+	void benchmark_pixel_kernels();
+	void check_texture_uploads();
+	void report_frame_allocations();
+
+}
@@ -1,4 +1,5 @@
 #include "Pulsar.h"
+#include "Benchmarks.h"
 #include "CHRS.h"
 #include "Logger.inl"
 #include "Macros.h"
@@ -13,14 +14,29 @@ static void register_particle_subsystems()
 static void post_init()
 {
 	register_particle_subsystems();
+#if PULSAR_RUN_BENCHMARKS
+	Sandbox::check_texture_uploads();
+#endif
 }
 
 static void frame_start()
 {
+#if PULSAR_RUN_BENCHMARKS
+	Sandbox::report_frame_allocations();
+#endif
 }
 
 int main()
 {
+#if PULSAR_RUN_BENCHMARKS
+	Sandbox::benchmark_job_scaling();
+	Sandbox::benchmark_functor();
+	Sandbox::benchmark_texture_cache();
+	Sandbox::benchmark_atlas_packing();
+	Sandbox::benchmark_atlas_placement();
+	Sandbox::benchmark_atlas_cache();
+	Sandbox::benchmark_pixel_kernels();
+#endif
 	int startup = Pulsar::StartUp("Pulsar Renderer");
 	//window->SetPostInit(&post_init);
 	//window->SetFrameStart(&frame_start-);
@@ -13,6 +13,7 @@
 #include "registry/Tile.h"
 #include "registry/UniformLexicon.h"
 #include "registry/compound/Atlas.h"
+#include "registry/compound/AtlasCache.h"
 #include "render/Renderer.h"
 #include "render/Renderable.h"
 #include "render/actors/TileMap.h"
@@ -72,7 +73,27 @@ LOAD_STATUS Loader::loadShader(const char* filepath, ShaderHandle& handle)
 		if (!fragment_shader)
 			return LOAD_STATUS::SYNTAX_ERR;
 		handle = Renderer::Shaders().GetHandle(ShaderConstructArgs(std::move(vertex_shader.value()), std::move(fragment_shader.value())));
-		return handle > 0 ? LOAD_STATUS::OK : LOAD_STATUS::ASSET_LOAD_ERR;
+		if (handle == 0)
+			return LOAD_STATUS::ASSET_LOAD_ERR;
+		auto permutable = shader["permutable"].value<bool>();
+		if (permutable && permutable.value())
+		{
+			char modulation_attrib = -1;
+			if (auto attrib = shader["modulation_attrib"].value<int64_t>())
+			{
+				if (attrib.value() < 0 || attrib.value() > 15)
+					return LOAD_STATUS::SYNTAX_ERR;
+				modulation_attrib = static_cast<char>(attrib.value());
+			}
+			Renderer::Shaders().MarkPermutable(handle, modulation_attrib);
+		}
+		if (auto attrib = shader["texcoord_attrib"].value<int64_t>())
+		{
+			if (attrib.value() < 0 || attrib.value() > 15)
+				return LOAD_STATUS::SYNTAX_ERR;
+			Renderer::Shaders().SetTexCoordAttrib(handle, static_cast<char>(attrib.value()));
+		}
+		return LOAD_STATUS::OK;
 	}
 	catch (const toml::parse_error& err)
 	{
@@ -475,6 +496,8 @@ bool Loader::saveAtlas(const Atlas& atlas, const char* texture_filepath, const c
 		toml::table atlas_;
 		atlas_.insert_or_assign("path", texture_filepath);
 		atlas_.insert_or_assign("border", atlas.GetBorder());
+		// atlases built from tiles loaded by the premultiplied alpha pipeline are saved premultiplied, and must not be premultiplied again on load
+		atlas_.insert_or_assign("premultiplied", PulsarSettings::premultiplied_alpha());
 
 		toml::array placements;
 		for (size_t i = 0; i < atlas.GetPlacements().size(); i++)
@@ -485,7 +508,7 @@ bool Loader::saveAtlas(const Atlas& atlas, const char* texture_filepath, const c
 			placement_table.insert_or_assign("y", static_cast<int64_t>(p.y));
 			placement_table.insert_or_assign("w", static_cast<int64_t>(p.w));
 			placement_table.insert_or_assign("h", static_cast<int64_t>(p.h));
-			placement_table.insert_or_assign("r", static_cast<int64_t>(p.r));
+			placement_table.insert_or_assign("r", p.r);
 			placements.push_back(placement_table);
 		}
 		atlas_.insert_or_assign("placement", placements);
@@ -499,21 +522,69 @@ bool Loader::saveAtlas(const Atlas& atlas, const char* texture_filepath, const c
 		return false;
 	}
 	stbi_flip_vertically_on_write(flip_vertically);
-	if (strcmp(image_format, "png"))
+	if (strcmp(image_format, "png") == 0)
 		stbi_write_png(texture_filepath, atlas.GetWidth(), atlas.GetHeight(), Atlas::BPP, atlas.GetBuffer(), atlas.GetWidth() * Atlas::STRIDE_BYTES);
-	else if (strcmp(image_format, "bmp"))
+	else if (strcmp(image_format, "bmp") == 0)
 		stbi_write_bmp(texture_filepath, atlas.GetWidth(), atlas.GetHeight(), Atlas::BPP, atlas.GetBuffer());
-	else if (strcmp(image_format, "jpg"))
+	else if (strcmp(image_format, "jpg") == 0)
 		stbi_write_jpg(texture_filepath, atlas.GetWidth(), atlas.GetHeight(), Atlas::BPP, atlas.GetBuffer(), jpg_quality);
-	else if (strcmp(image_format, "tga"))
+	else if (strcmp(image_format, "tga") == 0)
 		stbi_write_tga(texture_filepath, atlas.GetWidth(), atlas.GetHeight(), Atlas::BPP, atlas.GetBuffer());
 	else
 		return false;
 	return true;
 }
 
+static bool load_cached_atlas(const std::string& cache_filepath, const char* asset_filepath, Atlas*& atlas_initializer)
+{
+	AtlasCacheEntry entry;
+	const unsigned char* pixels;
+	std::unique_ptr<MappedFile> mapping;
+	if (!AtlasCache::Read(cache_filepath, asset_filepath, entry, pixels, mapping))
+		return false;
+	// uncompressed cache files are sampled straight from their mapping, which the tile keeps open
+	Tile tile = mapping ? Tile(std::move(mapping), pixels, entry.width, entry.height, entry.bpp)
+		: Tile(TileConstructArgs_buffer(const_cast<unsigned char*>(pixels), entry.width, entry.height, entry.bpp, TileDeletionPolicy::FROM_NEW));
+	try
+	{
+		atlas_initializer = new Atlas(Renderer::Tiles().Register(std::move(tile)), std::move(entry.placements), entry.border);
+		return true;
+	}
+	catch (const null_handle_error&)
+	{
+		return false;
+	}
+}
+
+// Caches the atlas as decoded from its image, so that the next load maps it instead.
+static void cache_atlas(const std::string& cache_filepath, const char* asset_filepath, const std::string& texture_filepath, const Atlas& atlas)
+{
+	TileHandle tile = atlas.GetTileHandle();
+	unsigned char const* pixels = Renderer::Tiles().GetImageBuffer(tile);
+	AtlasCacheEntry entry;
+	if (!pixels || !AtlasCache::SourceHash(asset_filepath, texture_filepath.c_str(), entry.source_hash))
+		return;
+	entry.texture_filepath = texture_filepath;
+	entry.width = Renderer::Tiles().GetWidth(tile);
+	entry.height = Renderer::Tiles().GetHeight(tile);
+	entry.bpp = Renderer::Tiles().GetBPP(tile);
+	entry.border = atlas.GetBorder();
+	entry.premultiplied = PulsarSettings::premultiplied_alpha();
+	entry.placements = atlas.GetPlacements();
+	if (!AtlasCache::Write(cache_filepath, entry, pixels, PulsarSettings::atlas_cache_compression()))
+		Logger::LogWarning("Cannot write atlas cache file \"" + cache_filepath + "\" for \"" + std::string(asset_filepath) + "\".");
+}
+
+// Loads the cached binary atlas if it is still valid for the asset file and its image. Otherwise parses the asset file, decodes its image, and rewrites the cache.
 LOAD_STATUS Loader::loadAtlas(const char* asset_filepath, Atlas*& atlas_initializer)
 {
+	std::string cache_filepath;
+	if (PulsarSettings::atlas_cache())
+	{
+		cache_filepath = AtlasCache::PathOf(asset_filepath);
+		if (load_cached_atlas(cache_filepath, asset_filepath, atlas_initializer))
+			return LOAD_STATUS::OK;
+	}
 	try
 	{
 		auto file = toml::parse_file(asset_filepath);
@@ -529,6 +600,13 @@ LOAD_STATUS Loader::loadAtlas(const char* asset_filepath, Atlas*& atlas_initiali
 			return LOAD_STATUS::SYNTAX_ERR;
 		auto _border = atlas["border"].value<int64_t>();
 		int border = _border ? static_cast<int>(_border.value()) : 0;
+		bool premultiplied = atlas["premultiplied"].value_or(false);
+		// premultiplied pixels cannot be blended as straight ones, and un-premultiplying them loses the color of translucent texels
+		if (premultiplied && !PulsarSettings::premultiplied_alpha())
+		{
+			Logger::LogError("Cannot load atlas \"" + std::string(asset_filepath) + "\": it was saved premultiplied, but premultiplied_alpha is off.");
+			return LOAD_STATUS::ASSET_LOAD_ERR;
+		}
 
 		auto p_arr = atlas["placement"].as_array();
 		std::vector<Placement> placements;
@@ -554,7 +632,11 @@ LOAD_STATUS Loader::loadAtlas(const char* asset_filepath, Atlas*& atlas_initiali
 
 		try
 		{
-			atlas_initializer = new Atlas(path.value(), std::move(placements), border);
+			TileHandle tile = Renderer::Tiles().GetHandle(TileConstructArgs_filepath(path.value(), 1.0f, true,
+				PulsarSettings::premultiplied_alpha() && !premultiplied));
+			atlas_initializer = new Atlas(tile, std::move(placements), border);
+			if (!cache_filepath.empty())
+				cache_atlas(cache_filepath, asset_filepath, path.value(), *atlas_initializer);
 			return LOAD_STATUS::OK;
 		}
 		catch (const null_handle_error&)
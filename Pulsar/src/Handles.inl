@@ -3,6 +3,7 @@
 typedef unsigned short ShaderHandle;
 typedef unsigned short TextureHandle;
 typedef unsigned short TextureVersion;
+typedef unsigned short SamplerHandle;
 typedef unsigned short TileHandle;
 typedef unsigned short UniformLexiconHandle;
 typedef unsigned short FontHandle;
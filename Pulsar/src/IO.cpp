@@ -2,6 +2,17 @@
 
 #include <sstream>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool IO::_read_file(const char* filepath, std::string& content, std::ios_base::openmode mode)
 {
 	std::ifstream file(filepath, mode);
@@ -49,3 +60,59 @@ bool IO::_read_file_uc(const char* filepath, unsigned char*& content, size_t& co
     }
     return false;
 }
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* filepath)
+{
+	HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_File = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return;
+	m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_Mapping)
+		return;
+	m_Data = static_cast<const unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_Data)
+		m_Size = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File)
+		CloseHandle(m_File);
+}
+
+#else
+
+MappedFile::MappedFile(const char* filepath)
+{
+	m_File = open(filepath, O_RDONLY);
+	if (m_File < 0)
+		return;
+	struct stat info;
+	if (fstat(m_File, &info) != 0 || info.st_size == 0)
+		return;
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_File, 0);
+	if (data == MAP_FAILED)
+		return;
+	m_Data = static_cast<const unsigned char*>(data);
+	m_Size = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_Data)
+		munmap(const_cast<unsigned char*>(m_Data), m_Size);
+	if (m_File >= 0)
+		close(m_File);
+}
+
+#endif
@@ -29,3 +29,27 @@ public:
 };
 
 inline IO IO::io;
+
+// Read only view of a whole file, mapped into memory. Fails on empty files.
+class MappedFile
+{
+	const unsigned char* m_Data = nullptr;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+
+public:
+	MappedFile(const char* filepath);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	~MappedFile();
+
+	operator bool() const { return m_Data != nullptr; }
+
+	const unsigned char* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+};
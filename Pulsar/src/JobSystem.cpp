@@ -0,0 +1,262 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Macros.h"
+
+std::vector<std::unique_ptr<JobSystem::WorkerQueue>> JobSystem::queues;
+std::vector<std::thread> JobSystem::workers;
+std::mutex JobSystem::sleep_mutex;
+std::condition_variable JobSystem::wake;
+std::atomic<size_t> JobSystem::queued = 0;
+bool JobSystem::stopping = false;
+bool JobSystem::serial = false;
+
+// Deque owned by the current thread. Threads outside the pool use deque 0.
+static thread_local size_t local_queue = 0;
+
+void JobSystem::WorkerQueue::PushBack(Job&& job)
+{
+	if (count == ring.size())
+	{
+		std::vector<Job> grown(std::max<size_t>(16, 2 * ring.size()));
+		for (size_t i = 0; i < count; ++i)
+			grown[i] = std::move(ring[(head + i) % ring.size()]);
+		ring.swap(grown);
+		head = 0;
+	}
+	ring[(head + count) % ring.size()] = std::move(job);
+	++count;
+}
+
+Job JobSystem::WorkerQueue::PopBack()
+{
+	--count;
+	return std::move(ring[(head + count) % ring.size()]);
+}
+
+Job JobSystem::WorkerQueue::PopFront()
+{
+	Job job = std::move(ring[head]);
+	head = (head + 1) % ring.size();
+	--count;
+	return job;
+}
+
+void JobSystem::Init(unsigned int num_workers, bool serial_mode)
+{
+	Terminate();
+	serial = serial_mode;
+	if (serial)
+		return;
+	stopping = false;
+	queues.reserve(num_workers + 1);
+	for (unsigned int i = 0; i <= num_workers; ++i)
+		queues.push_back(std::make_unique<WorkerQueue>());
+	workers.reserve(num_workers);
+	for (unsigned int i = 0; i < num_workers; ++i)
+		workers.emplace_back(&JobSystem::WorkerLoop, i + 1);
+}
+
+void JobSystem::Terminate()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+	// Jobs still queued run here, so their counters reach zero and nobody waiting on them hangs.
+	// A job may submit more jobs, which land in deque 0 and are picked up by the same loop.
+	while (!queues.empty() && TryRunOne());
+	queues.clear();
+	queued = 0;
+}
+
+void JobSystem::Submit(std::function<void()>&& work, JobCounter* counter)
+{
+	if (Serial())
+	{
+		work();
+		return;
+	}
+	if (counter)
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		WorkerQueue& queue = *queues[local_queue];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.PushBack({ std::move(work), counter });
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		++queued;
+	}
+	wake.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.Done())
+	{
+		if (!TryRunOne())
+			std::this_thread::yield();
+	}
+}
+
+// Splits [0, count) into ranges of grain elements. A grain of 0 picks roughly four ranges per thread.
+// The first range runs on the calling thread, which then helps with the rest until all ranges are done.
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = std::max<size_t>(1, count / (4 * Concurrency()));
+	if (Serial() || count <= grain)
+	{
+		for (size_t begin = 0; begin < count; begin += grain)
+			body(begin, std::min(begin + grain, count));
+		return;
+	}
+	JobCounter counter;
+	for (size_t begin = grain; begin < count; begin += grain)
+	{
+		size_t end = std::min(begin + grain, count);
+		Submit([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	body(0, grain);
+	Wait(counter);
+}
+
+void JobSystem::WorkerLoop(size_t queue)
+{
+	local_queue = queue;
+	while (true)
+	{
+		if (TryRunOne())
+			continue;
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, []() { return stopping || queued > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+bool JobSystem::TryRunOne()
+{
+	Job job;
+	bool found = false;
+	{
+		WorkerQueue& own = *queues[local_queue];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.Empty())
+		{
+			job = own.PopBack();
+			found = true;
+		}
+	}
+	for (size_t i = 1; !found && i < queues.size(); ++i)
+	{
+		WorkerQueue& victim = *queues[(local_queue + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.Empty())
+		{
+			job = victim.PopFront();
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+	--queued;
+	job.work();
+	if (job.counter)
+		job.counter->m_Pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+JobGraph::NodeIndex JobGraph::Add(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies)
+{
+	return AddNode(std::move(work), dependencies, false);
+}
+
+JobGraph::NodeIndex JobGraph::AddPinned(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies)
+{
+	return AddNode(std::move(work), dependencies, true);
+}
+
+JobGraph::NodeIndex JobGraph::AddNode(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies, bool pinned)
+{
+	NodeIndex index = m_Nodes.size();
+	auto node = std::make_unique<Node>();
+	node->work = std::move(work);
+	node->dependencies = dependencies.size();
+	node->pinned = pinned;
+	for (NodeIndex dependency : dependencies)
+	{
+		PULSAR_ASSERT(dependency < index);
+		m_Nodes[dependency]->dependents.push_back(index);
+	}
+	m_Nodes.push_back(std::move(node));
+	return index;
+}
+
+// Runs every node once, after all of its dependencies. Returns once the whole graph is done.
+// While waiting, the calling thread runs ready pinned nodes, and otherwise helps with pending jobs.
+void JobGraph::Run()
+{
+	for (auto& node : m_Nodes)
+		node->remaining = node->dependencies;
+	JobCounter counter;
+	for (NodeIndex i = 0; i < m_Nodes.size(); ++i)
+	{
+		if (m_Nodes[i]->dependencies == 0)
+			Launch(i, counter);
+	}
+	while (!counter.Done())
+	{
+		if (!RunPinned(counter) && (JobSystem::Serial() || !JobSystem::TryRunOne()))
+			std::this_thread::yield();
+	}
+}
+
+// Dependents are launched before the finishing node decrements the counter, so the counter cannot reach zero early.
+void JobGraph::Launch(NodeIndex node, JobCounter& counter)
+{
+	if (m_Nodes[node]->pinned)
+	{
+		counter.m_Pending.fetch_add(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(m_PinnedMutex);
+		m_PinnedReady.push_back(node);
+		return;
+	}
+	JobSystem::Submit([this, node, &counter]() {
+		m_Nodes[node]->work();
+		Finish(node, counter);
+	}, &counter);
+}
+
+void JobGraph::Finish(NodeIndex node, JobCounter& counter)
+{
+	for (NodeIndex dependent : m_Nodes[node]->dependents)
+	{
+		if (m_Nodes[dependent]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Launch(dependent, counter);
+	}
+}
+
+bool JobGraph::RunPinned(JobCounter& counter)
+{
+	NodeIndex node;
+	{
+		std::lock_guard<std::mutex> lock(m_PinnedMutex);
+		if (m_PinnedReady.empty())
+			return false;
+		node = m_PinnedReady.front();
+		m_PinnedReady.erase(m_PinnedReady.begin());
+	}
+	m_Nodes[node]->work();
+	Finish(node, counter);
+	counter.m_Pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
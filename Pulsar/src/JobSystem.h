@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of outstanding jobs. Jobs submitted with a counter decrement it once they finish.
+class JobCounter
+{
+	friend class JobSystem;
+	friend class JobGraph;
+	std::atomic<size_t> m_Pending = 0;
+
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter(JobCounter&&) = delete;
+
+	bool Done() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	std::function<void()> work;
+	JobCounter* counter = nullptr;
+};
+
+// Fixed pool of workers, each owning a deque of jobs. Owners pop their newest job, and idle workers steal the oldest job of another deque.
+// Threads outside the pool share one extra deque. Waiting on a counter runs other jobs instead of blocking, so jobs may wait on nested jobs.
+// In serial mode, or before Init(), jobs run inline on the submitting thread in submission order, which makes frames deterministic for debugging.
+class JobSystem
+{
+	friend class JobGraph;
+	// Ring buffer of jobs. Slots are reused once the ring has grown to the frame's peak, so submitting does not allocate.
+	struct WorkerQueue
+	{
+		std::vector<Job> ring;
+		size_t head = 0, count = 0;
+		std::mutex mutex;
+
+		bool Empty() const { return count == 0; }
+		void PushBack(Job&& job);
+		Job PopBack();
+		Job PopFront();
+	};
+	static std::vector<std::unique_ptr<WorkerQueue>> queues;
+	static std::vector<std::thread> workers;
+	static std::mutex sleep_mutex;
+	static std::condition_variable wake;
+	static std::atomic<size_t> queued;
+	static bool stopping;
+	static bool serial;
+
+public:
+	static void Init(unsigned int num_workers, bool serial_mode = false);
+	static void Terminate();
+
+	static bool Serial() { return serial || workers.empty(); }
+	static unsigned int Concurrency() { return static_cast<unsigned int>(workers.size()) + 1; }
+
+	static void Submit(std::function<void()>&& work, JobCounter* counter = nullptr);
+	static void Wait(JobCounter& counter);
+	static void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+	static void WorkerLoop(size_t queue);
+	static bool TryRunOne();
+};
+
+// Jobs with dependencies, built once and run any number of times, e.g. once per frame.
+// Nodes may only depend on nodes added before them, so the graph is always acyclic.
+// Pinned nodes always run on the thread calling Run(), e.g. because they need the GL context or must call GLFW from the main thread.
+class JobGraph
+{
+	struct Node
+	{
+		std::function<void()> work;
+		std::vector<size_t> dependents;
+		size_t dependencies = 0;
+		std::atomic<size_t> remaining = 0;
+		bool pinned = false;
+	};
+	std::vector<std::unique_ptr<Node>> m_Nodes;
+	std::vector<size_t> m_PinnedReady;
+	std::mutex m_PinnedMutex;
+
+public:
+	typedef size_t NodeIndex;
+
+	NodeIndex Add(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies = {});
+	NodeIndex AddPinned(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies = {});
+	void Run();
+	void Clear() { m_Nodes.clear(); }
+	size_t Size() const { return m_Nodes.size(); }
+
+private:
+	NodeIndex AddNode(std::function<void()>&& work, std::initializer_list<NodeIndex> dependencies, bool pinned);
+	void Launch(NodeIndex node, JobCounter& counter);
+	void Finish(NodeIndex node, JobCounter& counter);
+	bool RunPinned(JobCounter& counter);
+};
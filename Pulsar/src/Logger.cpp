@@ -0,0 +1,330 @@
+#include "Logger.inl"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "Macros.h"
+
+// Bounded multi-producer ring (after Vyukov). Each cell's sequence tells producers and the consumer whose turn it is, so pushing never locks.
+class LogRing
+{
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Logger::Record record;
+	};
+	static constexpr size_t CAPACITY = 1024;
+	Cell* m_Cells;
+	alignas(64) std::atomic<size_t> m_Enqueue = 0;
+	alignas(64) size_t m_Dequeue = 0;
+
+public:
+	LogRing() : m_Cells(new Cell[CAPACITY])
+	{
+		for (size_t i = 0; i < CAPACITY; ++i)
+			m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	LogRing(const LogRing&) = delete;
+	LogRing(LogRing&&) = delete;
+	~LogRing() { delete[] m_Cells; }
+
+	bool TryPush(const Logger::Record& record)
+	{
+		size_t pos = m_Enqueue.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = m_Cells[pos & (CAPACITY - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			if (sequence == pos)
+			{
+				if (m_Enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.record = record;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (sequence < pos)
+				return false; // full
+			else
+				pos = m_Enqueue.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Single consumer.
+	bool TryPop(Logger::Record& record)
+	{
+		Cell& cell = m_Cells[m_Dequeue & (CAPACITY - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != m_Dequeue + 1)
+			return false;
+		record = cell.record;
+		cell.sequence.store(m_Dequeue + CAPACITY, std::memory_order_release);
+		++m_Dequeue;
+		return true;
+	}
+};
+
+// Owns the ring and the writer thread. Created on first use, and drained and joined at exit.
+class LogBackend
+{
+	struct RateWindow
+	{
+		unsigned long long start = 0;
+		unsigned int count = 0;
+		unsigned long long suppressed = 0;
+		std::string sample;
+	};
+	static constexpr unsigned long long RATE_WINDOW_NS = 1'000'000'000;
+	static constexpr unsigned int RATE_LIMIT = 5;
+
+	LogRing m_Ring;
+	std::chrono::steady_clock::time_point m_Start = std::chrono::steady_clock::now();
+	std::atomic<unsigned int> m_Signal = 0;
+	std::atomic<unsigned long long> m_Pushed = 0;
+	std::atomic<unsigned long long> m_Written = 0;
+	std::atomic<unsigned long long> m_Dropped = 0;
+	unsigned long long m_ReportedDropped = 0;
+	std::atomic<bool> m_Stopping = false;
+	std::unordered_map<size_t, RateWindow> m_RateWindows;
+	std::mutex m_SyncMutex;
+	std::thread m_Thread;
+
+public:
+	LogBackend()
+	{
+#if !PULSAR_LOG_SYNCHRONOUS
+		m_Thread = std::thread(&LogBackend::Loop, this);
+#endif
+	}
+
+	~LogBackend()
+	{
+		if (m_Thread.joinable())
+		{
+			m_Stopping = true;
+			m_Signal.fetch_add(1, std::memory_order_release);
+			m_Signal.notify_one();
+			m_Thread.join();
+		}
+		ReportSuppressed(true);
+		fflush(stdout);
+	}
+
+	void Push(Logger::Record& record)
+	{
+		record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+#if PULSAR_LOG_SYNCHRONOUS
+		std::lock_guard<std::mutex> lock(m_SyncMutex);
+		Write(record);
+		record.Release();
+		fflush(stdout);
+#else
+		// fatal records are written right away by the caller, after everything pushed before them, so a full ring cannot drop them
+		if (record.level == Logger::Level::FATAL)
+		{
+			Flush();
+			std::lock_guard<std::mutex> lock(m_SyncMutex);
+			Write(record);
+			record.Release();
+			fflush(stdout);
+			return;
+		}
+		if (!m_Ring.TryPush(record))
+		{
+			record.Release();
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_Pushed.fetch_add(1, std::memory_order_release);
+		m_Signal.fetch_add(1, std::memory_order_release);
+		m_Signal.notify_one();
+#endif
+	}
+
+	// Waits until every message pushed so far is written.
+	void Flush()
+	{
+		if (!m_Thread.joinable() || std::this_thread::get_id() == m_Thread.get_id())
+			return;
+		unsigned long long target = m_Pushed.load(std::memory_order_acquire);
+		unsigned long long written = m_Written.load(std::memory_order_acquire);
+		while (written < target)
+		{
+			m_Written.wait(written, std::memory_order_acquire);
+			written = m_Written.load(std::memory_order_acquire);
+		}
+	}
+
+	unsigned long long Dropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+private:
+	void Loop()
+	{
+		Logger::Record record;
+		while (true)
+		{
+			unsigned int signal = m_Signal.load(std::memory_order_acquire);
+			bool wrote = false;
+			while (m_Ring.TryPop(record))
+			{
+				Write(record);
+				record.Release();
+				wrote = true;
+				m_Written.fetch_add(1, std::memory_order_release);
+			}
+			ReportDropped();
+			if (wrote)
+			{
+				fflush(stdout);
+				m_Written.notify_all();
+			}
+			if (m_Stopping)
+				return;
+			m_Signal.wait(signal, std::memory_order_acquire);
+		}
+	}
+
+	void ReportDropped()
+	{
+		unsigned long long dropped = m_Dropped.load(std::memory_order_relaxed);
+		if (dropped == m_ReportedDropped)
+			return;
+		printf("[Logger] Ring full: dropped %llu message(s).\n", dropped - m_ReportedDropped);
+		m_ReportedDropped = dropped;
+	}
+
+	void ReportSuppressed(bool all, unsigned long long now = 0)
+	{
+		for (auto& [key, window] : m_RateWindows)
+		{
+			if (window.suppressed > 0 && (all || now - window.start >= RATE_WINDOW_NS))
+			{
+				printf("[Logger] Suppressed %llu repeat(s) of: %s\n", window.suppressed, window.sample.c_str());
+				window.suppressed = 0;
+			}
+		}
+	}
+
+	static void Format(const Logger::Record& record, std::string& out)
+	{
+		if (!record.format)
+		{
+			out.append(record.Text(0, record.messageLength));
+			return;
+		}
+		unsigned char arg = 0;
+		for (const char* c = record.format; *c; ++c)
+		{
+			if (c[0] == '{' && c[1] == '}' && arg < record.numArgs)
+			{
+				const Logger::Arg& a = record.args[arg++];
+				switch (a.type)
+				{
+				case Logger::Arg::Type::INT:
+					out.append(std::to_string(a.i));
+					break;
+				case Logger::Arg::Type::UINT:
+					out.append(std::to_string(a.u));
+					break;
+				case Logger::Arg::Type::FLOAT:
+					out.append(std::to_string(a.f));
+					break;
+				case Logger::Arg::Type::TEXT:
+					out.append(record.Text(a.text.offset, a.text.length));
+					break;
+				}
+				++c;
+			}
+			else
+				out.push_back(*c);
+		}
+	}
+
+	// Messages are identified by their format string if they have one, and by their text otherwise.
+	bool RateLimited(const Logger::Record& record, const std::string& message)
+	{
+		size_t key = record.format ? std::hash<const void*>{}(record.format) : std::hash<std::string>{}(message);
+		key ^= static_cast<size_t>(record.level) << 1;
+		RateWindow& window = m_RateWindows[key];
+		if (record.timestamp - window.start >= RATE_WINDOW_NS)
+		{
+			if (window.suppressed > 0)
+				printf("[Logger] Suppressed %llu repeat(s) of: %s\n", window.suppressed, window.sample.c_str());
+			window.start = record.timestamp;
+			window.count = 0;
+			window.suppressed = 0;
+		}
+		if (++window.count <= RATE_LIMIT)
+			return false;
+		if (window.suppressed++ == 0)
+			window.sample = message;
+		return true;
+	}
+
+	void Write(const Logger::Record& record)
+	{
+		if (record.level == Logger::Level::NEWLINE)
+		{
+			printf("\n");
+			return;
+		}
+		std::string message;
+		Format(record, message);
+		// fatal records are never rate limited, and may be written off the writer thread, so they leave the rate windows alone
+		bool fatal = record.level == Logger::Level::FATAL;
+		if (record.level != Logger::Level::INFO && !fatal && RateLimited(record, message))
+			return;
+		const char* prefix = "";
+		switch (record.level)
+		{
+		case Logger::Level::WARNING:
+			prefix = "[Warning] ";
+			break;
+		case Logger::Level::ERROR:
+			prefix = "[Error] ";
+			break;
+		case Logger::Level::FATAL:
+			prefix = "[Fatal] ";
+			break;
+		default:
+			break;
+		}
+		printf("[%10.3f] %s%s", record.timestamp * 1e-9, prefix, message.c_str());
+		if (record.sourceLength > 0)
+		{
+			std::string_view source = record.Text(record.sourceOffset, record.sourceLength);
+			std::string_view file = record.Text(record.fileOffset, record.fileLength);
+			std::string_view line = record.Text(record.lineOffset, record.lineLength);
+			printf("\tSource (%.*s %.*s:%.*s)", static_cast<int>(source.size()), source.data(), static_cast<int>(file.size()), file.data(),
+				static_cast<int>(line.size()), line.data());
+		}
+		printf("\n");
+		if (!fatal)
+			ReportSuppressed(false, record.timestamp);
+	}
+};
+
+static LogBackend& backend()
+{
+	static LogBackend instance;
+	return instance;
+}
+
+void Logger::_Push(Record& record)
+{
+	backend().Push(record);
+}
+
+void Logger::Flush()
+{
+	backend().Flush();
+}
+
+unsigned long long Logger::DroppedCount()
+{
+	return backend().Dropped();
+}
@@ -1,49 +1,215 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 // eventually, Pulsar namespace will be used for everything. maybe then, an additional Logger namespace won't be necessary.
 
+// Messages are copied into compact records, spilling to the heap only when they are long, and pushed onto a lock-free ring. A background thread formats and writes them, so logging never blocks on terminal I/O.
+// Repeated warnings and errors are rate-limited, and messages dropped because the ring was full are counted and reported.
+// LogFormat defers formatting entirely: only the format string, which also identifies the message for rate limiting, and the arguments are recorded.
 namespace Logger {
-	
+
+	enum class Level : unsigned char
+	{
+		INFO,
+		WARNING,
+		ERROR,
+		FATAL,
+		NEWLINE
+	};
+
+	constexpr size_t RECORD_TEXT_SIZE = 256;
+	constexpr size_t RECORD_MAX_ARGS = 4;
+
+	struct Arg
+	{
+		enum class Type : unsigned char { INT, UINT, FLOAT, TEXT } type;
+		union
+		{
+			long long i;
+			unsigned long long u;
+			double f;
+			struct { unsigned int offset, length; } text;
+		};
+	};
+
+	// Producers fill a record on their own stack, and only the push onto the ring is shared.
+	struct Record
+	{
+		Level level = Level::INFO;
+		unsigned long long timestamp = 0;
+		const char* format = nullptr;
+		unsigned char numArgs = 0;
+		Arg args[RECORD_MAX_ARGS];
+		unsigned int messageLength = 0;
+		unsigned int sourceOffset = 0, sourceLength = 0;
+		unsigned int fileOffset = 0, fileLength = 0;
+		unsigned int lineOffset = 0, lineLength = 0;
+		unsigned int textLength = 0;
+		char text[RECORD_TEXT_SIZE];
+		// Text that outgrows the inline buffer moves here. Records are copied through the ring as they are, so the backend owns it once pushed,
+		// and releases it after the record is written or dropped.
+		char* spill = nullptr;
+		size_t spillCapacity = 0;
+
+		// Appends to the text buffer, moving it to the heap once the inline buffer is full. Returns the offset of the appended text.
+		unsigned int Append(std::string_view str)
+		{
+			unsigned int offset = textLength;
+			size_t length = textLength + str.size();
+			if (length > RECORD_TEXT_SIZE && length > spillCapacity)
+			{
+				size_t capacity = std::max(length, 2 * std::max(spillCapacity, RECORD_TEXT_SIZE));
+				char* grown = new char[capacity];
+				memcpy(grown, Buffer(), textLength);
+				delete[] spill;
+				spill = grown;
+				spillCapacity = capacity;
+			}
+			memcpy(Buffer() + textLength, str.data(), str.size());
+			textLength = static_cast<unsigned int>(length);
+			return offset;
+		}
+
+		char* Buffer() { return spill ? spill : text; }
+		const char* Buffer() const { return spill ? spill : text; }
+		std::string_view Text(unsigned int offset, unsigned int length) const { return { Buffer() + offset, length }; }
+
+		void Release()
+		{
+			delete[] spill;
+			spill = nullptr;
+			spillCapacity = 0;
+		}
+	};
+
+	void _Push(Record& record);
+	void Flush();
+	unsigned long long DroppedCount();
+
+	template<typename T>
+	inline void _AppendMessage(Record& record, const T& message)
+	{
+		unsigned int offset = record.textLength;
+		if constexpr (std::is_convertible_v<const T&, std::string_view>)
+			record.Append(std::string_view(message));
+		else if constexpr (std::is_arithmetic_v<T>)
+			record.Append(std::to_string(message));
+		else
+		{
+			std::ostringstream ss;
+			ss << message;
+			record.Append(ss.str());
+		}
+		record.messageLength = record.textLength - offset;
+	}
+
+	inline void _AppendSource(Record& record, const char* source, const char* file, const char* line)
+	{
+		if (source[0] == '\0')
+			return;
+		record.sourceLength = static_cast<unsigned int>(record.textLength - (record.sourceOffset = record.Append(source)));
+		record.fileLength = static_cast<unsigned int>(record.textLength - (record.fileOffset = record.Append(file)));
+		record.lineLength = static_cast<unsigned int>(record.textLength - (record.lineOffset = record.Append(line)));
+	}
+
+	template<typename T>
+	inline void _AppendArg(Record& record, const T& arg)
+	{
+		if (record.numArgs == RECORD_MAX_ARGS)
+			return;
+		Arg& a = record.args[record.numArgs++];
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			a.type = Arg::Type::FLOAT;
+			a.f = arg;
+		}
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+		{
+			a.type = Arg::Type::INT;
+			a.i = arg;
+		}
+		else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+		{
+			a.type = Arg::Type::UINT;
+			a.u = static_cast<unsigned long long>(arg);
+		}
+		else
+		{
+			a.type = Arg::Type::TEXT;
+			unsigned int offset = record.textLength;
+			record.Append(std::string_view(arg));
+			a.text = { offset, record.textLength - offset };
+		}
+	}
+
 	inline void Wait()
 	{
+		Flush();
 		std::cin.get();
 	}
 
 	inline void NewLine()
 	{
-		std::cout << std::endl;
+		Record record;
+		record.level = Level::NEWLINE;
+		_Push(record);
 	}
 
 	inline void LogInfo(const auto& message)
 	{
-		std::cout << message << std::endl;
+		Record record;
+		record.level = Level::INFO;
+		_AppendMessage(record, message);
+		_Push(record);
 	}
 
 	inline void LogWarning(const auto& message, const char* source = "", const char* file = "", const char* line = "")
 	{
-		if (source[0] != '\0')
-			std::cout << "[Warning] " << message << "\tSource (" << source << " " << file << ":" << line << ")" << std::endl;
-		else
-			std::cout << "[Warning] " << message << std::endl;
+		Record record;
+		record.level = Level::WARNING;
+		_AppendMessage(record, message);
+		_AppendSource(record, source, file, line);
+		_Push(record);
 	}
 
 	inline void LogError(const auto& message, const char* source = "", const char* file = "", const char* line = "")
 	{
-		if (source[0] != '\0')
-			std::cout << "[Error] " << message << "\tSource (" << source << " " << file << ":" << line << ")" << std::endl;
-		else
-			std::cout << "[Error] " << message << std::endl;
+		Record record;
+		record.level = Level::ERROR;
+		_AppendMessage(record, message);
+		_AppendSource(record, source, file, line);
+		_Push(record);
 	}
 
+	// Written synchronously after all pending messages, and never dropped or rate limited, before breaking.
 	inline void LogErrorFatal(const auto& message, const char* source = "", const char* file = "", const char* line = "")
 	{
-		if (source[0] != '\0')
-			std::cout << "[Fatal] " << message << "\tSource (" << source << " " << file << ":" << line << ")" << std::endl;
-		else
-			std::cout << "[Fatal] " << message << std::endl;
+		Record record;
+		record.level = Level::FATAL;
+		_AppendMessage(record, message);
+		_AppendSource(record, source, file, line);
+		_Push(record);
+		Flush();
 		__debugbreak();
 	}
 
+	// format must be a string literal. Each "{}" is replaced by the next argument when the record is written.
+	// Arguments may be arithmetic, enums or strings, of which at most RECORD_MAX_ARGS are recorded.
+	template<typename... Args>
+	inline void LogFormat(Level level, const char* format, const Args&... args)
+	{
+		Record record;
+		record.level = level;
+		record.format = format;
+		(_AppendArg(record, args), ...);
+		_Push(record);
+	}
+
 }
@@ -8,6 +8,14 @@
 #define PULSAR_DEBUGGING_MODE 0
 #endif // PULSAR_DEBUGGING_MODE
 #endif
+// GL errors are reported through a KHR_debug message callback, which costs nothing per call.
+#ifndef PULSAR_GL_DEBUG_OUTPUT
+#define PULSAR_GL_DEBUG_OUTPUT PULSAR_DEBUGGING_MODE
+#endif
+// Drains glGetError around every PULSAR_TRY call. Serializes the driver, so it is only meant for contexts without KHR_debug.
+#ifndef PULSAR_GL_CHECK_ERRORS
+#define PULSAR_GL_CHECK_ERRORS 0
+#endif
 #ifndef PULSAR_ASSUME_INITIALIZED
 #define PULSAR_ASSUME_INITIALIZED 1
 #endif
@@ -26,6 +34,12 @@
 #ifndef PULSAR_DELTA_USE_DOUBLE_PRECISION
 #define PULSAR_DELTA_USE_DOUBLE_PRECISION 0
 #endif
+#ifndef PULSAR_LOG_SYNCHRONOUS
+#define PULSAR_LOG_SYNCHRONOUS 0
+#endif
+#ifndef PULSAR_RUN_BENCHMARKS
+#define PULSAR_RUN_BENCHMARKS 0
+#endif
 /******************************/
 
 #ifndef PULSAR_ASSERT
@@ -36,7 +50,7 @@
 #endif
 #endif // PULSAR_ASSERT
 #ifndef PULSAR_TRY
-#if PULSAR_DEBUGGING_MODE == 1
+#if PULSAR_GL_CHECK_ERRORS == 1
 #	define PULSAR_TRY(x) PULSAR_ASSERT(glNoError(#x, __FILE__, __LINE__)) x; PULSAR_ASSERT(glNoError(#x, __FILE__, __LINE__))
 #else
 #	define PULSAR_TRY(x) x;
@@ -1,11 +1,14 @@
 ﻿#include "VendorInclude.h"
 #include "Pulsar.h"
 
+#include <chrono>
 #include <functional>
+#include <mutex>
 #include <glm/ext/scalar_constants.hpp>
 #include <stb/stb_truetype.h>
 #include <stb/stb_image_write.h>
 
+#include "JobSystem.h"
 #include "PulsarSettings.h"
 #include "Logger.inl"
 #include "Macros.h"
@@ -27,6 +30,7 @@
 #include "render/actors/NonantRender.h"
 #include "platform/WindowManager.h"
 #include "platform/InputManager.h"
+#include "utils/FrameArena.h"
 #include "utils/Strings.h"
 #include "IO.h"
 #include "render/Font.h"
@@ -35,6 +39,12 @@ real Pulsar::drawTime;
 real Pulsar::deltaDrawTime;
 real Pulsar::prevDrawTime;
 real Pulsar::totalDrawTime;
+real Pulsar::deltaUpdateTime;
+real Pulsar::totalUpdateTime;
+real Pulsar::updateAlpha = 1.0f;
+unsigned long long Pulsar::updateCount = 0;
+
+static real update_accumulator = 0.0f;
 
 static bool glfw_initialized = false;;
 
@@ -54,6 +64,27 @@ static void glfw_error_callback(int error, const char* description)
 	Logger::LogErrorFatal(std::string("GLFW err(") + std::to_string(error) + "): " + description);
 }
 
+#if PULSAR_DEBUGGING_MODE
+static std::mutex startup_timings_mutex;
+static std::vector<std::pair<const char*, double>> startup_timings;
+#endif
+
+// Wraps a startup task so that its duration is recorded in debug builds.
+static std::function<void()> startup_task(const char* name, std::function<void()>&& work)
+{
+#if PULSAR_DEBUGGING_MODE
+	return [name, work = std::move(work)]() {
+		auto start = std::chrono::steady_clock::now();
+		work();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::lock_guard<std::mutex> lock(startup_timings_mutex);
+		startup_timings.push_back({ name, ms });
+	};
+#else
+	return std::move(work);
+#endif
+}
+
 int Pulsar::StartUp(const char* title)
 {
 	if (!PulsarSettings::_loaded())
@@ -66,13 +97,37 @@ int Pulsar::StartUp(const char* title)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+#if PULSAR_GL_DEBUG_OUTPUT
+	if (PulsarSettings::gl_debug_output())
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
 	std::srand(static_cast<unsigned int>(time(0)));
-
-	CreateWindow(0, title);
-	Logger::LogInfo("Welcome to Pulsar Renderer! GL_VERSION:");
-	PULSAR_TRY(Logger::LogInfo(reinterpret_cast<const char*>(glGetString(GL_VERSION))));
-	Renderer::Init();
-	Renderer::FocusWindow(0);
+#if PULSAR_DEBUGGING_MODE
+	auto startup_start = std::chrono::steady_clock::now();
+#endif
+	JobSystem::Init(PulsarSettings::job_threads(), PulsarSettings::serial_jobs());
+	FrameArena::Init(PulsarSettings::frame_arena_block_size());
+
+	// Window creation and everything touching the GL context runs on the main thread, while file-bound work runs on workers.
+	// Non-critical resources (gamepad mappings, the rect renderable, fonts) are only finalized on first use.
+	JobGraph startup;
+	JobGraph::NodeIndex window = startup.AddPinned(startup_task("window", [title]() {
+		CreateWindow(0, title);
+		Logger::LogInfo("Welcome to Pulsar Renderer! GL_VERSION:");
+		PULSAR_TRY(Logger::LogInfo(reinterpret_cast<const char*>(glGetString(GL_VERSION))));
+	}));
+	startup.Add(startup_task("gamepad mappings", &InputManager::ReadGamepadMappings));
+	JobGraph::NodeIndex renderer = startup.AddPinned(startup_task("renderer", &Renderer::Init), { window });
+	startup.AddPinned(startup_task("focus window", []() { Renderer::FocusWindow(0); }), { renderer });
+	startup.Run();
+
+#if PULSAR_DEBUGGING_MODE
+	double startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_start).count();
+	Logger::LogInfo("Startup took " + std::to_string(startup_ms) + " ms:");
+	for (const auto& [name, ms] : startup_timings)
+		Logger::LogInfo(std::string("  ") + name + ": " + std::to_string(ms) + " ms");
+	startup_timings.clear();
+#endif
 	
 	// TODO also use:
 	// glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextureSlots);
@@ -83,6 +138,8 @@ int Pulsar::StartUp(const char* title)
 void Pulsar::Terminate()
 {
 	Renderer::Terminate();
+	JobSystem::Terminate();
+	FrameArena::Terminate();
 	glfwTerminate();
 	glfw_initialized = false;
 }
@@ -102,12 +159,13 @@ void Pulsar::FrameStart(void(*frame_start)())
 		_frame_start = frame_start;
 }
 
-static std::function<void(void)> _frame_exec;
+static JobGraph frame_graph;
 
 void Pulsar::Run()
 {
 	prevDrawTime = drawTime = static_cast<real>(glfwGetTime());
 	deltaDrawTime = totalDrawTime = 0;
+	deltaUpdateTime = totalUpdateTime = update_accumulator = 0;
 	_post_init();
 
 	// Load textures
@@ -399,31 +457,27 @@ void Pulsar::Run()
 	text_render.pivot = {0.5f, 0.5f};
 	text_background.SetPivot({0.5f, 0.5f});
 	
-	_frame_exec = [&]() {
-		drawTime = static_cast<real>(glfwGetTime());
-		deltaDrawTime = drawTime - prevDrawTime;
-		prevDrawTime = drawTime;
-		totalDrawTime += deltaDrawTime;
-
-		_frame_start();
-
-		nonant.SetNonantWidth(nonant.GetUVWidth() + 10 * glm::sin(totalDrawTime));
-		nonant.SetNonantHeight(nonant.GetUVHeight() + 10 * glm::cos(totalDrawTime));
-
-		*child.Fickler().Rotation() = -Pulsar::totalDrawTime;
-		*child2.Fickler().Rotation() = -Pulsar::totalDrawTime;
-		*grandchild.Fickler().Rotation() = Pulsar::totalDrawTime;
-		*grandchild2.Fickler().Rotation() = -Pulsar::totalDrawTime;
-		*root.Fickler().Rotation() = Pulsar::totalDrawTime;
-		*child.Fickler().Position() += 5 * Pulsar::deltaDrawTime;
-		*child2.Fickler().Scale() *= 1.0f / (1.0f + 0.1f * Pulsar::deltaDrawTime);
+	// per-frame job graph: updates of independent actors run in parallel between frame start and drawing
+	frame_graph.Add([&]() {
+		nonant.SetNonantWidth(nonant.GetUVWidth() + 10 * glm::sin(totalUpdateTime));
+		nonant.SetNonantHeight(nonant.GetUVHeight() + 10 * glm::cos(totalUpdateTime));
+	});
+	frame_graph.Add([&]() {
+		*child.Fickler().Rotation() = -Pulsar::totalUpdateTime;
+		*child2.Fickler().Rotation() = -Pulsar::totalUpdateTime;
+		*grandchild.Fickler().Rotation() = Pulsar::totalUpdateTime;
+		*grandchild2.Fickler().Rotation() = -Pulsar::totalUpdateTime;
+		*root.Fickler().Rotation() = Pulsar::totalUpdateTime;
+		*child.Fickler().Position() += 5 * Pulsar::deltaUpdateTime;
+		*child2.Fickler().Scale() *= 1.0f / (1.0f + 0.1f * Pulsar::deltaUpdateTime);
 		root.Fickler().SyncT();
-
+	});
+	frame_graph.Add([&]() {
 		serotonin.OnUpdate();
 		animPlayer1.OnUpdate();
 		//animPlayerEvents.OnUpdate();
 
-		ap1frames += deltaDrawTime;
+		ap1frames += deltaUpdateTime;
 		if (animPlayer1.isInReverse)
 		{
 			if (ap1frames > 3.0f)
@@ -440,9 +494,7 @@ void Pulsar::Run()
 				animPlayer1.isInReverse = !animPlayer1.isInReverse;
 			}
 		}
-
-		Renderer::OnDraw();
-	};
+	});
 
 	// TODO put run() in Window?
 	drawTime = static_cast<real>(glfwGetTime());
@@ -450,13 +502,61 @@ void Pulsar::Run()
 	prevDrawTime = drawTime;
 	totalDrawTime += deltaDrawTime;
 	Window& window = *WindowManager::GetWindow(0);
-	window._ForceRefresh();
+	Renderer::_GLInvoke([&window]() { window._ForceRefresh(); });
 
 	for (glfwPollEvents(); window.ShouldNotClose(); glfwPollEvents())
 		_ExecFrame();
+	// the tasks refer to locals of this call, so none may outlive it, and another Run() starts from an empty graph
+	frame_graph.Clear();
 }
 
+// Frame start and drawing stay on the calling thread, which owns the GL context when there is no render thread.
+// With a fixed timestep, the frame graph runs once per elapsed step rather than once per frame, up to max_updates_per_frame times.
+// Time beyond that is dropped, so the simulation slows down instead of falling further behind with every frame.
 void Pulsar::_ExecFrame()
 {
-	_frame_exec();
+	drawTime = static_cast<real>(glfwGetTime());
+	deltaDrawTime = drawTime - prevDrawTime;
+	prevDrawTime = drawTime;
+	totalDrawTime += deltaDrawTime;
+
+	_frame_start();
+	real step = PulsarSettings::fixed_timestep();
+	if (step > 0.0f)
+	{
+		update_accumulator += deltaDrawTime;
+		unsigned int updates = 0;
+		while (update_accumulator >= step && updates < PulsarSettings::max_updates_per_frame())
+		{
+			deltaUpdateTime = step;
+			frame_graph.Run();
+			totalUpdateTime += step;
+			update_accumulator -= step;
+			++updateCount;
+			++updates;
+		}
+		if (update_accumulator >= step)
+			update_accumulator = unsigned_fmod(update_accumulator, step);
+		updateAlpha = update_accumulator / step;
+	}
+	else
+	{
+		deltaUpdateTime = deltaDrawTime;
+		frame_graph.Run();
+		totalUpdateTime += deltaDrawTime;
+		++updateCount;
+		updateAlpha = 1.0f;
+	}
+	Renderer::OnDraw();
+	FrameArena::Reset();
+}
+
+bool Pulsar::InterpolatingUpdates()
+{
+	return PulsarSettings::fixed_timestep() > 0.0f && PulsarSettings::interpolate_transforms();
+}
+
+JobGraph& Pulsar::FrameGraph()
+{
+	return frame_graph;
 }
@@ -10,6 +10,8 @@ typedef float real;
 #include "VendorInclude.h"
 #include "Handles.inl"
 
+class JobGraph;
+
 // TODO recreate typedefs file?
 typedef GLint TextureSlot;
 
@@ -25,10 +27,18 @@ namespace Pulsar
 	extern real deltaDrawTime;
 	extern real prevDrawTime;
 	extern real totalDrawTime;
+	// Time of simulation updates. With a fixed timestep, deltaUpdateTime is the step length, and updateAlpha is how far drawing lies between the last two updates.
+	extern real deltaUpdateTime;
+	extern real totalUpdateTime;
+	extern real updateAlpha;
+	extern unsigned long long updateCount;
+	bool InterpolatingUpdates();
 
 	void Run();
 	void PostInit(void(*post_init)());
 	void FrameStart(void(*frame_start)());
+	// Tasks added to the frame graph run every update until Run() returns, which clears the graph.
+	JobGraph& FrameGraph();
 
 	void _ExecFrame();
 }
@@ -38,6 +38,56 @@ PulsarSettings::PulsarSettings()
 			_standard_vertex_pool_size = static_cast<VertexSize>(svps.value());
 		if (auto sips = rendering["standard_index_pool_size"].value<int64_t>())
 			_standard_index_pool_size = static_cast<VertexSize>(sips.value());
+		if (auto svas = rendering["streaming_vertex_arena_size"].value<int64_t>())
+			_streaming_vertex_arena_size = static_cast<VertexSize>(svas.value());
+		if (auto sias = rendering["streaming_index_arena_size"].value<int64_t>())
+			_streaming_index_arena_size = static_cast<VertexSize>(sias.value());
+		if (auto mcl = rendering["merge_canvas_layers"].value<bool>())
+			_merge_canvas_layers = mcl.value();
+		if (auto jt = rendering["job_threads"].value<int64_t>())
+			_job_threads = jt.value() > 0 ? static_cast<unsigned int>(jt.value()) : 0;
+		if (auto sj = rendering["serial_jobs"].value<bool>())
+			_serial_jobs = sj.value();
+		if (auto fabs = rendering["frame_arena_block_size"].value<int64_t>())
+			_frame_arena_block_size = fabs.value() > 0 ? static_cast<size_t>(fabs.value()) : 0;
+		if (auto rt = rendering["render_thread"].value<bool>())
+			_render_thread = rt.value();
+		if (auto gqb = rendering["gl_queue_budget_ms"].value<double>())
+			_gl_queue_budget_ms = static_cast<float>(gqb.value());
+		if (auto tub = rendering["texture_upload_budget"].value<int64_t>())
+			_texture_upload_budget = tub.value() > 0 ? static_cast<size_t>(tub.value()) : 0;
+		if (auto tubs = rendering["texture_upload_buffer_size"].value<int64_t>())
+			_texture_upload_buffer_size = tubs.value() > 0 ? static_cast<size_t>(tubs.value()) : 1;
+		if (auto tvb = rendering["texture_vram_budget"].value<int64_t>())
+			_texture_vram_budget = tvb.value() > 0 ? static_cast<size_t>(tvb.value()) : 0;
+		if (auto tc = rendering["texture_cache"].value<bool>())
+			_texture_cache = tc.value();
+		if (auto tcd = rendering["texture_cache_directory"].value<std::string>())
+			_texture_cache_directory = tcd.value();
+		if (auto tcmp = rendering["texture_cache_min_psnr"].value<double>())
+			_texture_cache_min_psnr = static_cast<float>(tcmp.value());
+		if (auto dams = rendering["dynamic_atlas_max_size"].value<int64_t>())
+			_dynamic_atlas_max_size = dams.value() > 0 ? static_cast<int>(dams.value()) : 0;
+		if (auto daps = rendering["dynamic_atlas_page_size"].value<int64_t>())
+			_dynamic_atlas_page_size = daps.value() > 0 ? static_cast<int>(daps.value()) : 1;
+		if (auto dap = rendering["dynamic_atlas_padding"].value<int64_t>())
+			_dynamic_atlas_padding = dap.value() > 0 ? static_cast<int>(dap.value()) : 0;
+		if (auto dadt = rendering["dynamic_atlas_defrag_threshold"].value<double>())
+			_dynamic_atlas_defrag_threshold = static_cast<float>(dadt.value());
+		if (auto ac = rendering["atlas_cache"].value<bool>())
+			_atlas_cache = ac.value();
+		if (auto acd = rendering["atlas_cache_directory"].value<std::string>())
+			_atlas_cache_directory = acd.value();
+		if (auto acc = rendering["atlas_cache_compression"].value<bool>())
+			_atlas_cache_compression = acc.value();
+		if (auto pa = rendering["premultiplied_alpha"].value<bool>())
+			_premultiplied_alpha = pa.value();
+		if (auto tcm = rendering["texture_cpu_mipmaps"].value<bool>())
+			_texture_cpu_mipmaps = tcm.value();
+		if (auto gdo = rendering["gl_debug_output"].value<bool>())
+			_gl_debug_output = gdo.value();
+		if (auto gds = rendering["gl_debug_synchronous"].value<bool>())
+			_gl_debug_synchronous = gds.value();
 		if (auto ssf = rendering["standard_shader"].value<std::string>())
 			_standard_shader_assetfile = ssf.value();
 		if (auto sps = rendering["solid_polygon_shader"].value<std::string>())
@@ -54,5 +104,11 @@ PulsarSettings::PulsarSettings()
 			_solid_circle_filepath = sc.value();
 		if (auto pfl = rendering["particle_frame_length"].value<double>())
 			_particle_frame_length = static_cast<real>(pfl.value());
+		if (auto fts = rendering["fixed_timestep"].value<double>())
+			_fixed_timestep = fts.value() > 0.0 ? static_cast<real>(fts.value()) : 0.0f;
+		if (auto mupf = rendering["max_updates_per_frame"].value<int64_t>())
+			_max_updates_per_frame = mupf.value() > 1 ? static_cast<unsigned int>(mupf.value()) : 1;
+		if (auto it = rendering["interpolate_transforms"].value<bool>())
+			_interpolate_transforms = it.value();
 	}
 }
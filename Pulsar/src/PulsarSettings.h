@@ -33,6 +33,31 @@ public:
 	static TextureSlot max_texture_slots() { return ps()._max_texture_slots; }
 	static VertexSize standard_vertex_pool_size() { return ps()._standard_vertex_pool_size; }
 	static VertexSize standard_index_pool_size() { return ps()._standard_index_pool_size; }
+	static VertexSize streaming_vertex_arena_size() { return ps()._streaming_vertex_arena_size; }
+	static VertexSize streaming_index_arena_size() { return ps()._streaming_index_arena_size; }
+	static bool merge_canvas_layers() { return ps()._merge_canvas_layers; }
+	static unsigned int job_threads() { return ps()._job_threads; }
+	static bool serial_jobs() { return ps()._serial_jobs; }
+	static size_t frame_arena_block_size() { return ps()._frame_arena_block_size; }
+	static bool render_thread() { return ps()._render_thread; }
+	static float gl_queue_budget_ms() { return ps()._gl_queue_budget_ms; }
+	static size_t texture_upload_budget() { return ps()._texture_upload_budget; }
+	static size_t texture_upload_buffer_size() { return ps()._texture_upload_buffer_size; }
+	static size_t texture_vram_budget() { return ps()._texture_vram_budget; }
+	static bool texture_cache() { return ps()._texture_cache; }
+	static const char* texture_cache_directory() { return ps()._texture_cache_directory.c_str(); }
+	static float texture_cache_min_psnr() { return ps()._texture_cache_min_psnr; }
+	static int dynamic_atlas_max_size() { return ps()._dynamic_atlas_max_size; }
+	static int dynamic_atlas_page_size() { return ps()._dynamic_atlas_page_size; }
+	static int dynamic_atlas_padding() { return ps()._dynamic_atlas_padding; }
+	static float dynamic_atlas_defrag_threshold() { return ps()._dynamic_atlas_defrag_threshold; }
+	static bool atlas_cache() { return ps()._atlas_cache; }
+	static const char* atlas_cache_directory() { return ps()._atlas_cache_directory.c_str(); }
+	static bool atlas_cache_compression() { return ps()._atlas_cache_compression; }
+	static bool premultiplied_alpha() { return ps()._premultiplied_alpha; }
+	static bool texture_cpu_mipmaps() { return ps()._texture_cpu_mipmaps; }
+	static bool gl_debug_output() { return ps()._gl_debug_output; }
+	static bool gl_debug_synchronous() { return ps()._gl_debug_synchronous; }
 
 	static const char* standard_shader_assetfile() { return ps()._standard_shader_assetfile.c_str(); }
 	static const char* text_standard_filepath() { return ps()._text_standard_filepath.c_str(); }
@@ -43,6 +68,9 @@ public:
 	static const char* solid_circle_filepath() { return ps()._solid_circle_filepath.c_str(); }
 
 	static real particle_frame_length() { return ps()._particle_frame_length;}
+	static real fixed_timestep() { return ps()._fixed_timestep; }
+	static unsigned int max_updates_per_frame() { return ps()._max_updates_per_frame; }
+	static bool interpolate_transforms() { return ps()._interpolate_transforms; }
 
 	static const char* sdl_gamecontrollerdb() { return ps()._sdl_gamecontrollerdb.c_str(); }
 
@@ -61,6 +89,31 @@ private:
 	TextureSlot _max_texture_slots = 32;
 	VertexSize _standard_vertex_pool_size = 2048;
 	VertexSize _standard_index_pool_size = 1024;
+	VertexSize _streaming_vertex_arena_size = 262144;
+	VertexSize _streaming_index_arena_size = 131072;
+	bool _merge_canvas_layers = true;
+	unsigned int _job_threads = 3;
+	bool _serial_jobs = false;
+	size_t _frame_arena_block_size = 65536;
+	bool _render_thread = false;
+	float _gl_queue_budget_ms = 2.0f;
+	size_t _texture_upload_budget = 16777216;
+	size_t _texture_upload_buffer_size = 16777216;
+	size_t _texture_vram_budget = 0;
+	bool _texture_cache = false;
+	std::string _texture_cache_directory = "cache/textures";
+	float _texture_cache_min_psnr = 35.0f;
+	int _dynamic_atlas_max_size = 128;
+	int _dynamic_atlas_page_size = 2048;
+	int _dynamic_atlas_padding = 2;
+	float _dynamic_atlas_defrag_threshold = 0.5f;
+	bool _atlas_cache = true;
+	std::string _atlas_cache_directory = "cache/atlases";
+	bool _atlas_cache_compression = false;
+	bool _premultiplied_alpha = false;
+	bool _texture_cpu_mipmaps = false;
+	bool _gl_debug_output = true;
+	bool _gl_debug_synchronous = true;
 
 	std::string _standard_shader_assetfile = "config/shaders/StandardShader32.toml";
 	std::string _solid_polygon_shader = "config/shaders/SolidPolygonShader.toml";
@@ -71,6 +124,9 @@ private:
 	std::string _solid_circle_filepath = "config/renderables/SolidCircle.toml";
 
 	real _particle_frame_length = 0.0167f;
+	real _fixed_timestep = 1.0f / 60.0f;
+	unsigned int _max_updates_per_frame = 5;
+	bool _interpolate_transforms = true;
 
 	std::string _sdl_gamecontrollerdb = "config/sdl-gamecontrollerdb/gamecontrollerdb.txt";
 
@@ -5,6 +5,11 @@
 #include "Logger.inl"
 #include "IO.h"
 
+// The SDL_GameControllerDB mapping file is large, so it is read during startup off the main thread, and only handed to GLFW once a gamepad is first used.
+static std::string gamepad_mapping;
+static bool gamepad_mapping_read = false;
+static bool gamepad_mapping_applied = false;
+
 static void window_close_callback(GLFWwindow* window)
 {
 	WindowHandle handle;
@@ -89,6 +94,8 @@ static void path_drop_callback(GLFWwindow* window, int path_count, const char**
 
 static void joystick_callback(int jid, int event)
 {
+	if (event == GLFW_CONNECTED)
+		InputManager::Instance().ApplyGamepadMappings();
 	InputManager::Instance().DispatchControllerConnect().Emit({ static_cast<Input::ControllerID>(jid), static_cast<bool>(event) });
 }
 
@@ -139,11 +146,28 @@ InputManager::InputManager()
 {
 	glfwSetJoystickCallback(joystick_callback);
 	glfwSetMonitorCallback(monitor_callback);
-	std::string mapping;
-	if (IO::read_file(PulsarSettings::sdl_gamecontrollerdb(), mapping))
-		LoadGamepadMapping(mapping.c_str());
-	else
-		Logger::LogErrorFatal("Cannot load SDL_GameControllerDB.");
+}
+
+// May be called from any thread, as long as it does not overlap ApplyGamepadMappings().
+void InputManager::ReadGamepadMappings()
+{
+	if (gamepad_mapping_read)
+		return;
+	if (!IO::read_file(PulsarSettings::sdl_gamecontrollerdb(), gamepad_mapping))
+		gamepad_mapping.clear();
+	gamepad_mapping_read = true;
+}
+
+// Must be called on the main thread. Reads the mapping file first if startup did not.
+void InputManager::ApplyGamepadMappings()
+{
+	if (gamepad_mapping_applied)
+		return;
+	gamepad_mapping_applied = true;
+	ReadGamepadMappings();
+	if (gamepad_mapping.empty() || !LoadGamepadMapping(gamepad_mapping.c_str()))
+		Logger::LogError(std::string("Cannot load SDL_GameControllerDB: ") + PulsarSettings::sdl_gamecontrollerdb());
+	gamepad_mapping = std::string();
 }
 
 void InputManager::AssignWindowCallbacks(Window& window)
@@ -238,6 +262,7 @@ bool InputManager::IsControllerConnected(Input::ControllerID jid)
 
 bool InputManager::IsControllerGamepad(Input::ControllerID jid)
 {
+	ApplyGamepadMappings();
 	return static_cast<bool>(glfwJoystickIsGamepad(static_cast<int>(jid))) == GLFW_TRUE;
 }
 
@@ -260,6 +285,7 @@ Input::Gamepad::HatDirection InputManager::GetDPadSafe(Input::ControllerID jid,
 
 Input::Gamepad::State InputManager::GetFullGamepadState(Input::ControllerID jid)
 {
+	ApplyGamepadMappings();
 	GLFWgamepadstate state;
 	glfwGetGamepadState(static_cast<int>(jid), &state);
 	return Input::Gamepad::State(state);
@@ -267,6 +293,7 @@ Input::Gamepad::State InputManager::GetFullGamepadState(Input::ControllerID jid)
 
 Input::Gamepad::State InputManager::GetFullGamepadStateSafe(Input::ControllerID jid)
 {
+	ApplyGamepadMappings();
 	GLFWgamepadstate state;
 	if (glfwGetGamepadState(static_cast<int>(jid), &state))
 		return Input::Gamepad::State(state);
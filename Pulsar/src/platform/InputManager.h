@@ -33,6 +33,8 @@ public:
 	Input::Gamepad::State GetFullGamepadState(Input::ControllerID jid = Input::ControllerID::J1);
 	Input::Gamepad::State GetFullGamepadStateSafe(Input::ControllerID jid = Input::ControllerID::J1);
 	bool LoadGamepadMapping(const char* mapping);
+	static void ReadGamepadMappings();
+	void ApplyGamepadMappings();
 
 private:
 	EventBucketDispatcher<InputSource::WindowClose, InputEvent::WindowClose, InputBucket::Window> h_WindowClose;
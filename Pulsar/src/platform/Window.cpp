@@ -7,7 +7,7 @@
 static void default_window_refresh()
 {
 	Pulsar::_ExecFrame();
-	PULSAR_TRY(glFinish());
+	Renderer::_GLInvoke([]() { PULSAR_TRY(glFinish()); });
 }
 
 static void default_window_resize(int width, int height)
@@ -16,7 +16,7 @@ static void default_window_resize(int width, int height)
 	// If PulsarSettings::resize_mode() is set to SCALE_IGNORE_ASPECT_RATIO, don't add anything.
 	// If it is set to SCALE_KEEP_ASPECT_RATIO, call new Renderer function that will scale objects as usual without stretching their aspect ratios.
 	// If it is set to NO_SCALE_KEEP_SIZE, call new Renderer function that will not scale objects - only display more of the scene.
-	PULSAR_TRY(glViewport(0, 0, width, height));
+	Renderer::_GLInvoke([width, height]() { PULSAR_TRY(glViewport(0, 0, width, height)); });
 	Pulsar::_ExecFrame();
 }
 
@@ -0,0 +1,109 @@
+#include "Sampler.h"
+
+#include "Logger.inl"
+#include "Macros.h"
+#include "render/Renderer.h"
+
+Sampler::Sampler(const TextureSettings& settings)
+	: m_RID(0), m_Settings(settings)
+{
+	PULSAR_TRY(glGenSamplers(1, &m_RID));
+	PULSAR_TRY(glSamplerParameteri(m_RID, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(settings.minFilter)));
+	PULSAR_TRY(glSamplerParameteri(m_RID, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(settings.magFilter)));
+	PULSAR_TRY(glSamplerParameteri(m_RID, GL_TEXTURE_WRAP_S, static_cast<GLint>(settings.wrapS)));
+	PULSAR_TRY(glSamplerParameteri(m_RID, GL_TEXTURE_WRAP_T, static_cast<GLint>(settings.wrapT)));
+}
+
+Sampler::Sampler(Sampler&& sampler) noexcept
+	: m_RID(sampler.m_RID), m_Settings(sampler.m_Settings)
+{
+	sampler.m_RID = 0;
+}
+
+Sampler& Sampler::operator=(Sampler&& sampler) noexcept
+{
+	if (this == &sampler)
+		return *this;
+	if (m_RID != sampler.m_RID)
+	{
+		PULSAR_TRY(glDeleteSamplers(1, &m_RID));
+	}
+	m_RID = sampler.m_RID;
+	m_Settings = sampler.m_Settings;
+	sampler.m_RID = 0;
+	return *this;
+}
+
+Sampler::~Sampler()
+{
+	if (m_RID)
+	{
+		PULSAR_TRY(glDeleteSamplers(1, &m_RID));
+		m_RID = 0;
+	}
+}
+
+void Sampler::Bind(TextureSlot slot) const
+{
+	PULSAR_TRY(glBindSampler(slot, m_RID));
+}
+
+void Sampler::Unbind(TextureSlot slot)
+{
+	PULSAR_TRY(glBindSampler(slot, 0));
+}
+
+// Element lookups are locked, since samplers may be created on the GL thread while other threads look them up.
+Sampler const* SamplerRegistry::Get(SamplerHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(handle);
+}
+
+SamplerHandle SamplerRegistry::GetHandle(const TextureSettings& settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = lookup_1.find(settings);
+		if (iter != lookup_1.end())
+			return iter->second;
+	}
+	SamplerHandle handle = 0;
+	Renderer::_GLInvoke([this, &settings, &handle]() { std::lock_guard<std::mutex> lock(mutex); handle = Base::GetHandle(settings); });
+	return handle;
+}
+
+TextureSettings SamplerRegistry::GetSettings(SamplerHandle handle) const
+{
+	Sampler const* sampler = Get(handle);
+	return sampler ? sampler->GetSettings() : TextureSettings{};
+}
+
+void SamplerRegistry::Bind(SamplerHandle handle, TextureSlot slot)
+{
+	if (slot < 0)
+		return;
+	if (bound.size() <= static_cast<size_t>(slot))
+		bound.resize(slot + 1, 0);
+	if (bound[slot] == handle)
+		return;
+	Sampler const* sampler = Get(handle);
+	if (sampler)
+	{
+		sampler->Bind(slot);
+		bound[slot] = handle;
+	}
+#if !PULSAR_IGNORE_WARNINGS_NULL_TEXTURE
+	else
+		Logger::LogFormat(Logger::Level::WARNING, "Failed to bind sampler at handle ({}) to slot ({}).", handle, slot);
+#endif
+}
+
+void SamplerRegistry::Unbind(TextureSlot slot)
+{
+	if (slot < 0)
+		return;
+	Sampler::Unbind(slot);
+	if (static_cast<size_t>(slot) < bound.size())
+		bound[slot] = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <mutex>
+#include <vector>
+
+#include "Pulsar.h"
+#include "Texture.h"
+#include "Registry.inl"
+
+typedef GLuint Sampler_RID;
+
+// Sampling state as a GL sampler object. A sampler bound to a slot overrides the parameters of whichever texture is bound there,
+// so one texture can be sampled with any number of settings without uploading it again.
+class Sampler
+{
+	Sampler_RID m_RID;
+	TextureSettings m_Settings;
+
+public:
+	Sampler(const TextureSettings& settings);
+	Sampler(const Sampler&) = delete;
+	Sampler(Sampler&& sampler) noexcept;
+	Sampler& operator=(Sampler&& sampler) noexcept;
+	~Sampler();
+
+	operator bool() const { return m_RID > 0; }
+
+	void Bind(TextureSlot slot) const;
+	static void Unbind(TextureSlot slot);
+
+	Sampler_RID GetRID() const { return m_RID; }
+	const TextureSettings& GetSettings() const { return m_Settings; }
+};
+
+// Samplers are shared by settings, and live until the registry is deleted, since any number of textures and renderables may refer to them.
+// GetHandle may be called from any thread, and creates missing samplers on the GL thread. Binding must happen on the GL thread.
+class SamplerRegistry : public Registry<Sampler, SamplerHandle, TextureSettings>
+{
+	typedef Registry<Sampler, SamplerHandle, TextureSettings> Base;
+
+	mutable std::mutex mutex;
+	// by slot, so that draws that keep sampling a slot the same way skip glBindSampler
+	std::vector<SamplerHandle> bound;
+
+public:
+	SamplerRegistry() = default;
+
+	Sampler const* Get(SamplerHandle handle) const;
+	SamplerHandle GetHandle(const TextureSettings& settings);
+	TextureSettings GetSettings(SamplerHandle handle) const;
+
+	void Bind(SamplerHandle handle, TextureSlot slot);
+	void Unbind(TextureSlot slot);
+};
@@ -10,6 +10,8 @@
 #include "IO.h"
 #include "PulsarSettings.h"
 #include "AssetLoader.h"
+#include "render/GLDebug.h"
+#include "render/Renderer.h"
 
 static GLuint compile_shader(GLenum type, const char* shader, const char*filepath)
 {
@@ -33,6 +35,37 @@ static GLuint compile_shader(GLenum type, const char* shader, const char*filepat
 	return id;
 }
 
+// Inserts the variant's #defines directly after the #version directive, which must remain the first line.
+// PULSAR_PREMULTIPLIED_ALPHA is defined for every variant while the premultiplied alpha pipeline is on.
+// Converts straight vertex colors to the blend mode's color. A negative alpha encodes additive blending (see additive_modulate).
+static const char* premultiply_snippet_premultiplied = "vec4 premultiply(vec4 color) { return vec4(color.rgb * abs(color.a), max(color.a, 0.0)); }\n";
+static const char* premultiply_snippet_straight = "vec4 premultiply(vec4 color) { return vec4(color.rgb, abs(color.a)); }\n";
+
+static void inject_variant_defines(std::string& source, ShaderVariant variant, GLenum type)
+{
+	std::string defines;
+	if (PulsarSettings::premultiplied_alpha())
+		defines += "#define PULSAR_PREMULTIPLIED_ALPHA\n";
+	// vertex shaders get the premultiply() helper matching the define
+	if (type == GL_VERTEX_SHADER)
+		defines += PulsarSettings::premultiplied_alpha() ? premultiply_snippet_premultiplied : premultiply_snippet_straight;
+	if (variant & SHADER_VARIANT_UNTEXTURED)
+		defines += "#define PULSAR_UNTEXTURED\n";
+	if (variant & SHADER_VARIANT_SINGLE_TEXTURE)
+		defines += "#define PULSAR_SINGLE_TEXTURE\n";
+	if (variant & SHADER_VARIANT_UNMODULATED)
+		defines += "#define PULSAR_UNMODULATED\n";
+	if (defines.empty())
+		return;
+	size_t insert_at = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		insert_at = source.find('\n');
+		insert_at = insert_at == std::string::npos ? source.size() : insert_at + 1;
+	}
+	source.insert(insert_at, defines);
+}
+
 Shader::Shader(const ShaderConstructArgs& args)
 	: m_RID(0)
 {
@@ -45,6 +78,8 @@ Shader::Shader(const ShaderConstructArgs& args)
 	
 	if (!vertex_shader.empty() && !fragment_shader.empty())
 	{
+		inject_variant_defines(vertex_shader, args.variant, GL_VERTEX_SHADER);
+		inject_variant_defines(fragment_shader, args.variant, GL_FRAGMENT_SHADER);
 		PULSAR_TRY(m_RID = glCreateProgram());
 		GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_shader.c_str(), args.vertexFilepath.c_str());
 		if (vs == 0)
@@ -70,6 +105,8 @@ Shader::Shader(const ShaderConstructArgs& args)
 
 				PULSAR_TRY(glDeleteShader(vs));
 				PULSAR_TRY(glDeleteShader(fs));
+				if (GLDebug::Enabled())
+					GLDebug::Label(GL_PROGRAM, m_RID, args.vertexFilepath + " | " + args.fragmentFilepath + " (variant " + std::to_string(args.variant) + ")");
 			}
 		}
 	}
@@ -117,7 +154,7 @@ GLint Shader::GetUniformLocation(const char* uniform_name) const
 	PULSAR_TRY(GLint location = glGetUniformLocation(m_RID, uniform_name));
 #if !PULSAR_IGNORE_WARNINGS_NULL_SHADER
 	if (location == -1)
-		Logger::LogWarning(std::string("No uniform exists or is in use under the name: ") + uniform_name);
+		Logger::LogFormat(Logger::Level::WARNING, "No uniform exists or is in use under the name: {}", uniform_name);
 #endif
 	m_UniformLocationCache[uniform_name] = location;
 	return location;
@@ -128,10 +165,30 @@ GLint Shader::GetUniformLocation(const char* uniform_name) const
 #define PULSAR_ELSE_CHECK_BAD_UNIFORM(handle)
 #else
 #define PULSAR_ELSE_CHECK_BAD_UNIFORM(handle) else\
-	Logger::LogWarning("Failed to set uniform for shader at handle (" + std::to_string(handle) + ").");
+	Logger::LogFormat(Logger::Level::WARNING, "Failed to set uniform for shader at handle ({}).", handle);
 #endif
 #endif // PULSAR_ELSE_CHECK_BAD_UNIFORM
 
+Shader const* ShaderRegistry::Get(ShaderHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(handle);
+}
+
+ShaderHandle ShaderRegistry::GetHandle(const ShaderConstructArgs& args)
+{
+	ShaderHandle handle = 0;
+	Renderer::_GLInvoke([this, &args, &handle]() { std::lock_guard<std::mutex> lock(mutex); handle = Base::GetHandle(args); });
+	return handle;
+}
+
+bool ShaderRegistry::Destroy(ShaderHandle handle)
+{
+	bool destroyed = false;
+	Renderer::_GLInvoke([this, handle, &destroyed]() { std::lock_guard<std::mutex> lock(mutex); destroyed = Base::Destroy(handle); });
+	return destroyed;
+}
+
 void ShaderRegistry::DefineStandardShader()
 {
 	auto status = Loader::loadShader(PulsarSettings::standard_shader_assetfile(), standard_shader);
@@ -139,6 +196,78 @@ void ShaderRegistry::DefineStandardShader()
 		Logger::LogErrorFatal("Standard shader could not be loaded (error code " + std::to_string(static_cast<int>(status)) + "): " + PulsarSettings::standard_shader_assetfile());
 }
 
+// Runs on the render thread, if one is running, since that is where variants are looked up.
+void ShaderRegistry::MarkPermutable(ShaderHandle handle, char modulation_attrib)
+{
+	Renderer::_GLInvoke([this, handle, modulation_attrib]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& [args, registered] : lookup_1)
+		{
+			if (registered == handle)
+			{
+				permutables.insert({ handle, { args, modulation_attrib } });
+				return;
+			}
+		}
+	});
+}
+
+// Variants are compiled the first time they are requested, and cached by base handle and feature bitmask.
+// Compilation runs outside the lock, and the base registry dedupes a variant that is requested twice meanwhile.
+ShaderHandle ShaderRegistry::Variant(ShaderHandle handle, ShaderVariant variant)
+{
+	if (variant == 0)
+		return handle;
+	unsigned int key = (static_cast<unsigned int>(handle) << 8) | variant;
+	std::string vertex_filepath, fragment_filepath;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto permutable = permutables.find(handle);
+		if (permutable == permutables.end())
+			return handle;
+		auto cached = variants.find(key);
+		if (cached != variants.end())
+			return cached->second;
+		vertex_filepath = permutable->second.args.vertexFilepath;
+		fragment_filepath = permutable->second.args.fragmentFilepath;
+	}
+	ShaderHandle variant_handle = GetHandle(ShaderConstructArgs(std::move(vertex_filepath), std::move(fragment_filepath), variant));
+	if (variant_handle == 0)
+	{
+		Logger::LogWarning("Failed to compile variant (" + std::to_string(variant) + ") of shader at handle (" + std::to_string(handle) + "). Falling back to base shader.");
+		variant_handle = handle;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	variants[key] = variant_handle;
+	return variant_handle;
+}
+
+bool ShaderRegistry::IsPermutable(ShaderHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return permutables.find(handle) != permutables.end();
+}
+
+char ShaderRegistry::ModulationAttrib(ShaderHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto permutable = permutables.find(handle);
+	return permutable != permutables.end() ? permutable->second.modulationAttrib : -1;
+}
+
+// Runs on the render thread, if one is running, like MarkPermutable.
+void ShaderRegistry::SetTexCoordAttrib(ShaderHandle handle, char texcoord_attrib)
+{
+	Renderer::_GLInvoke([this, handle, texcoord_attrib]() { std::lock_guard<std::mutex> lock(mutex); texcoord_attribs[handle] = texcoord_attrib; });
+}
+
+char ShaderRegistry::TexCoordAttrib(ShaderHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto attrib = texcoord_attribs.find(handle);
+	return attrib != texcoord_attribs.end() ? attrib->second : -1;
+}
+
 void ShaderRegistry::Bind(ShaderHandle handle)
 {
 	Shader const* shader = Get(handle);
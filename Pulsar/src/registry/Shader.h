@@ -3,22 +3,33 @@
 #include <GL/glew.h>
 
 #include <unordered_map>
+#include <mutex>
 #include <string>
 
 #include "Registry.inl"
 #include "Handles.inl"
 
 typedef GLuint Shader_RID;
+typedef unsigned char ShaderVariant;
+
+// Feature bits of a shader permutation. Each set bit is injected into both stages as the matching #define.
+enum : ShaderVariant
+{
+	SHADER_VARIANT_UNTEXTURED = 0b1,		// PULSAR_UNTEXTURED
+	SHADER_VARIANT_SINGLE_TEXTURE = 0b10,	// PULSAR_SINGLE_TEXTURE
+	SHADER_VARIANT_UNMODULATED = 0b100		// PULSAR_UNMODULATED
+};
 
 struct ShaderConstructArgs
 {
 	std::string vertexFilepath;
 	std::string fragmentFilepath;
+	ShaderVariant variant;
 
-	ShaderConstructArgs(const std::string& vertex_filepath, const std::string& fragment_filepath)
-		: vertexFilepath(vertex_filepath), fragmentFilepath(fragment_filepath) {}
-	ShaderConstructArgs(std::string&& vertex_filepath, std::string&& fragment_filepath)
-		: vertexFilepath(std::move(vertex_filepath)), fragmentFilepath(std::move(fragment_filepath)) {}
+	ShaderConstructArgs(const std::string& vertex_filepath, const std::string& fragment_filepath, ShaderVariant variant = 0)
+		: vertexFilepath(vertex_filepath), fragmentFilepath(fragment_filepath), variant(variant) {}
+	ShaderConstructArgs(std::string&& vertex_filepath, std::string&& fragment_filepath, ShaderVariant variant = 0)
+		: vertexFilepath(std::move(vertex_filepath)), fragmentFilepath(std::move(fragment_filepath)), variant(variant) {}
 
 	bool operator==(const ShaderConstructArgs&) const = default;
 };
@@ -30,7 +41,7 @@ struct std::hash<ShaderConstructArgs>
 	{
 		auto hash1 = hash<std::string>{}(args.vertexFilepath);
 		auto hash2 = hash<std::string>{}(args.fragmentFilepath);
-		return hash1 ^ (hash2 << 1);
+		return hash1 ^ (hash2 << 1) ^ (static_cast<size_t>(args.variant) << 2);
 	}
 };
 
@@ -54,12 +65,36 @@ public:
 	operator bool() const { return m_RID > 0; }
 };
 
+// Creation and destruction are handed off to the render thread, if one is running. Uniform setters must be called on the thread owning the GL context.
+// Lookups are locked, since variants are compiled on demand on the render thread while recorders on other threads read shader attributes.
 class ShaderRegistry : public Registry<Shader, ShaderHandle, ShaderConstructArgs>
 {
+	typedef Registry<Shader, ShaderHandle, ShaderConstructArgs> Base;
+
 	ShaderHandle standard_shader = 0;
 
+	struct Permutable
+	{
+		ShaderConstructArgs args;
+		char modulationAttrib;
+	};
+	std::unordered_map<ShaderHandle, Permutable> permutables;
+	std::unordered_map<unsigned int, ShaderHandle> variants;
+	// vertex attribute holding the texture coordinates, for shaders that declare one
+	std::unordered_map<ShaderHandle, char> texcoord_attribs;
+	mutable std::mutex mutex;
+
 public:
+	Shader const* Get(ShaderHandle handle) const;
+	ShaderHandle GetHandle(const ShaderConstructArgs& args);
+	bool Destroy(ShaderHandle handle);
 	void DefineStandardShader();
+	void MarkPermutable(ShaderHandle handle, char modulation_attrib = -1);
+	ShaderHandle Variant(ShaderHandle handle, ShaderVariant variant);
+	bool IsPermutable(ShaderHandle handle) const;
+	char ModulationAttrib(ShaderHandle handle) const;
+	void SetTexCoordAttrib(ShaderHandle handle, char texcoord_attrib);
+	char TexCoordAttrib(ShaderHandle handle) const;
 
 	void Bind(ShaderHandle handle);
 	void Unbind();
@@ -1,17 +1,36 @@
 #include "Texture.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <GL/glew.h>
 
 #include <stb/stb_image.h>
 
 #include "Logger.inl"
+#include "JobSystem.h"
 #include "Macros.h"
+#include "TextureCache.h"
+#include "render/GLDebug.h"
 #include "render/Renderer.h"
+#include "utils/PixelKernels.h"
 
+// Settings are set before the image is specified, since they decide whether it gets a mip chain.
 Texture::Texture(const TextureConstructArgs_filepath& args)
 	: m_RID(0), m_Width(0), m_Height(0), m_Tile(0)
 {
+	SetSettings(args.settings);
+	// textures that keep no tile may come from the texture cache
+	if (args.temporary_buffer && TextureCache::Enabled())
+	{
+		CompressedImage image;
+		if (TextureCache::Load(TileConstructArgs_filepath(args.filepath, args.svg_scale), args.settings, image))
+		{
+			TexImage(image, image.data.data());
+			GLDebug::Label(GL_TEXTURE, m_RID, args.filepath);
+			return;
+		}
+	}
 	Tile const* tile_ref = nullptr;
 	if (args.temporary_buffer)
 	{
@@ -31,7 +50,7 @@ Texture::Texture(const TextureConstructArgs_filepath& args)
 	m_Width = tile_ref->GetWidth();
 	m_Height = tile_ref->GetHeight();
 	TexImage(tile_ref, std::string("Cannot create texture \"") + args.filepath + "\": BPP is not 4, 3, 2, or 1.");
-	SetSettings(args.settings);
+	GLDebug::Label(GL_TEXTURE, m_RID, args.filepath);
 	if (args.temporary_buffer)
 		delete tile_ref;
 }
@@ -39,6 +58,7 @@ Texture::Texture(const TextureConstructArgs_filepath& args)
 Texture::Texture(const TextureConstructArgs_tile& args)
 	: m_RID(0), m_Width(0), m_Height(0), m_Tile(args.tile)
 {
+	SetSettings(args.settings);
 	Tile const* tile_ref = Renderer::Tiles().Get(m_Tile);
 	if (!tile_ref)
 	{
@@ -49,7 +69,8 @@ Texture::Texture(const TextureConstructArgs_tile& args)
 	m_Width = tile_ref->GetWidth();
 	m_Height = tile_ref->GetHeight();
 	TexImage(tile_ref, std::string("Cannot create texture from tile  \"") + std::to_string(args.tile) + "\": BPP is not 4, 3, 2, or 1.");
-	SetSettings(args.settings);
+	if (GLDebug::Enabled())
+		GLDebug::Label(GL_TEXTURE, m_RID, "tile " + std::to_string(args.tile));
 }
 
 Texture::Texture(Tile&& tile, TextureSettings settings)
@@ -57,12 +78,28 @@ Texture::Texture(Tile&& tile, TextureSettings settings)
 {
 	m_Width = tile.GetWidth();
 	m_Height = tile.GetHeight();
+	SetSettings(settings);
 	TexImage(&tile, "Cannot create texture from tile r-value ref: BPP is not 4, 3, 2, or 1.");
+}
+
+Texture::Texture(const void* pixels, int width, int height, int bpp, TileHandle tile, const TextureSettings& settings, const unsigned char* mip_source)
+	: m_RID(0), m_Width(width), m_Height(height), m_Tile(tile)
+{
+	SetSettings(settings);
+	TexImage(pixels, width, height, bpp, "Cannot create texture from pixels: BPP is not 4, 3, 2, or 1.", 0, mip_source);
+}
+
+// The image's own levels are uploaded, whatever the settings.
+Texture::Texture(const CompressedImage& image, const void* data, const TextureSettings& settings)
+	: m_RID(0), m_Width(0), m_Height(0), m_Tile(0)
+{
 	SetSettings(settings);
+	TexImage(image, data);
 }
 
 Texture::Texture(Texture&& texture) noexcept
-	: m_RID(texture.m_RID), m_Width(texture.m_Width), m_Height(texture.m_Height), m_Tile(texture.m_Tile)
+	: m_RID(texture.m_RID), m_Width(texture.m_Width), m_Height(texture.m_Height), m_Levels(texture.m_Levels), m_Bytes(texture.m_Bytes), m_Tile(texture.m_Tile),
+	m_Settings(texture.m_Settings), m_Sampler(texture.m_Sampler)
 {
 	texture.m_RID = 0;
 }
@@ -78,7 +115,11 @@ Texture& Texture::operator=(Texture&& texture) noexcept
 	m_RID = texture.m_RID;
 	m_Width = texture.m_Width;
 	m_Height = texture.m_Height;
+	m_Levels = texture.m_Levels;
+	m_Bytes = texture.m_Bytes;
 	m_Tile = texture.m_Tile;
+	m_Settings = texture.m_Settings;
+	m_Sampler = texture.m_Sampler;
 	texture.m_RID = 0;
 	return *this;
 }
@@ -92,83 +133,197 @@ Texture::~Texture()
 	}
 }
 
-void Texture::TexImage(Tile const* tile, const std::string& err_msg, GLint lod_level)
+// Levels of a full mip chain, down to 1x1.
+static GLsizei mip_levels(int width, int height)
 {
-	if (m_RID)
-	{
-		PULSAR_TRY(glDeleteTextures(1, &m_RID));
-	}
-	PULSAR_TRY(glGenTextures(1, &m_RID));
-	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
-	
-	switch (tile->m_BPP)
+	GLsizei levels = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2)
+		++levels;
+	return levels;
+}
+
+static bool pixel_format(int bpp, GLenum& internal_format, GLenum& format, GLint& alignment)
+{
+	switch (bpp)
 	{
 	case 4:
-		PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
-		PULSAR_TRY(glTexImage2D(GL_TEXTURE_2D, lod_level, GL_RGBA8, tile->m_Width, tile->m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tile->m_ImageBuffer));
-		break;
+		internal_format = GL_RGBA8;
+		format = GL_RGBA;
+		alignment = 4;
+		return true;
 	case 3:
-		PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
-		PULSAR_TRY(glTexImage2D(GL_TEXTURE_2D, lod_level, GL_RGB8, tile->m_Width, tile->m_Height, 0, GL_RGB, GL_UNSIGNED_BYTE, tile->m_ImageBuffer));
-		break;
+		internal_format = GL_RGB8;
+		format = GL_RGB;
+		alignment = 1;
+		return true;
 	case 2:
-		PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 2));
-		PULSAR_TRY(glTexImage2D(GL_TEXTURE_2D, lod_level, GL_RG8, tile->m_Width, tile->m_Height, 0, GL_RG, GL_UNSIGNED_BYTE, tile->m_ImageBuffer));
-		break;
+		internal_format = GL_RG8;
+		format = GL_RG;
+		alignment = 2;
+		return true;
 	case 1:
-		PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
-		PULSAR_TRY(glTexImage2D(GL_TEXTURE_2D, lod_level, GL_R8, tile->m_Width, tile->m_Height, 0, GL_RED, GL_UNSIGNED_BYTE, tile->m_ImageBuffer));
-		break;
+		internal_format = GL_R8;
+		format = GL_RED;
+		alignment = 1;
+		return true;
 	default:
-		Logger::LogError(err_msg);
+		return false;
 	}
+}
 
-	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+// Box filters every level from the one above it with PixelKernels::Downsample, and uploads it to the bound texture.
+// The levels are uploaded from client memory, so the unpack buffer is unbound.
+static void upload_cpu_mip_chain(const unsigned char* rgba, int width, int height, GLsizei levels)
+{
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	std::vector<unsigned char> above, level;
+	const unsigned char* src = rgba;
+	for (GLsizei i = 1; i < levels; ++i)
+	{
+		int level_width = std::max(width / 2, 1), level_height = std::max(height / 2, 1);
+		level.resize(static_cast<size_t>(level_width) * level_height * 4);
+		PixelKernels::Downsample(src, width, height, level.data());
+		PULSAR_TRY(glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level_width, level_height, GL_RGBA, GL_UNSIGNED_BYTE, level.data()));
+		above.swap(level);
+		src = above.data();
+		width = level_width;
+		height = level_height;
+	}
 }
 
-void Texture::Bind(TextureSlot slot) const
+void Texture::TexImage(Tile const* tile, const std::string& err_msg, GLint lod_level)
 {
-	PULSAR_TRY(glActiveTexture(GL_TEXTURE0 + slot));
-	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
+	TexImage(tile->m_ImageBuffer, tile->m_Width, tile->m_Height, tile->m_BPP, err_msg, lod_level, tile->m_ImageBuffer);
 }
 
-void Texture::Unbind(TextureSlot slot) const
+// Level 0 recreates the texture with immutable storage, with a full mip chain if its settings use a mipmap filter.
+// Other levels are replaced within the existing storage.
+void Texture::TexImage(const void* pixels, int width, int height, int bpp, const std::string& err_msg, GLint lod_level, const unsigned char* mip_source)
 {
-	PULSAR_TRY(glActiveTexture(GL_TEXTURE0 + slot));
+	GLenum internal_format, format;
+	GLint alignment;
+	if (!pixel_format(bpp, internal_format, format, alignment))
+	{
+		Logger::LogError(err_msg);
+		return;
+	}
+	if (lod_level > 0)
+	{
+		if (!m_RID || lod_level >= m_Levels)
+		{
+			Logger::LogError("Cannot replace texture level " + std::to_string(lod_level) + " of " + std::to_string(m_Levels) + ".");
+			return;
+		}
+		// immutable storage fixed the size of every level, which a replacement must match
+		int level_width = std::max(1, m_Width >> lod_level), level_height = std::max(1, m_Height >> lod_level);
+		if (width != level_width || height != level_height)
+		{
+			Logger::LogError("Cannot replace texture level " + std::to_string(lod_level) + " of size " + std::to_string(level_width) + "x"
+				+ std::to_string(level_height) + " with an image of size " + std::to_string(width) + "x" + std::to_string(height) + ".");
+			return;
+		}
+		PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
+		PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, alignment));
+		PULSAR_TRY(glTexSubImage2D(GL_TEXTURE_2D, lod_level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels));
+		PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+		return;
+	}
+
+	if (m_RID)
+	{
+		PULSAR_TRY(glDeleteTextures(1, &m_RID));
+	}
+	PULSAR_TRY(glGenTextures(1, &m_RID));
+	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
+	m_Width = width;
+	m_Height = height;
+	m_Levels = m_Settings.UsesMipmaps() ? mip_levels(width, height) : 1;
+	PULSAR_TRY(glTexStorage2D(GL_TEXTURE_2D, m_Levels, internal_format, width, height));
+	PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, alignment));
+	PULSAR_TRY(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels));
+	if (m_Levels > 1)
+	{
+		if (PulsarSettings::texture_cpu_mipmaps() && bpp == 4 && mip_source)
+			upload_cpu_mip_chain(mip_source, width, height, m_Levels);
+		else
+		{
+			PULSAR_TRY(glGenerateMipmap(GL_TEXTURE_2D));
+		}
+	}
+	m_Bytes = 0;
+	for (GLsizei i = 0; i < m_Levels; ++i)
+		m_Bytes += static_cast<size_t>(std::max(width >> i, 1)) * std::max(height >> i, 1) * (bpp == 3 ? 4 : bpp);
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
 }
 
-void Texture::SetSettings(const TextureSettings& settings) const
+void Texture::TexImage(const CompressedImage& image, const void* data)
 {
+	if (!image)
+	{
+		Logger::LogError("Cannot create texture from compressed image: image has no levels.");
+		return;
+	}
+	if (m_RID)
+	{
+		PULSAR_TRY(glDeleteTextures(1, &m_RID));
+	}
+	PULSAR_TRY(glGenTextures(1, &m_RID));
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
-	PULSAR_TRY(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(settings.minFilter)));
-	PULSAR_TRY(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(settings.magFilter)));
-	PULSAR_TRY(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(settings.wrapS)));
-	PULSAR_TRY(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(settings.wrapT)));
+	m_Width = image.width;
+	m_Height = image.height;
+	m_Levels = static_cast<GLsizei>(image.levels.size());
+	m_Bytes = image.data.size();
+	GLenum internal_format = image.format == CompressedFormat::RGBA8 ? GL_RGBA8 : TextureCache::GLFormat(image.format);
+	PULSAR_TRY(glTexStorage2D(GL_TEXTURE_2D, m_Levels, internal_format, image.width, image.height));
+	PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+	for (size_t i = 0; i < image.levels.size(); ++i)
+	{
+		const CompressedImage::Level& level = image.levels[i];
+		const void* pixels = reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(data) + level.offset);
+		GLint lod_level = static_cast<GLint>(i);
+		if (image.format == CompressedFormat::RGBA8)
+		{
+			PULSAR_TRY(glTexSubImage2D(GL_TEXTURE_2D, lod_level, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+		}
+		else
+		{
+			PULSAR_TRY(glCompressedTexSubImage2D(GL_TEXTURE_2D, lod_level, 0, 0, level.width, level.height, internal_format,
+				static_cast<GLsizei>(level.size), pixels));
+		}
+	}
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
 }
 
-TextureSettings Texture::GetSettings() const
+void Texture::Bind(TextureSlot slot, SamplerHandle sampler) const
 {
+	PULSAR_TRY(glActiveTexture(GL_TEXTURE0 + slot));
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
-	GLint min_filter, mag_filter, wrap_s, wrap_t;
-	
-	PULSAR_TRY(glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &min_filter));
-	PULSAR_TRY(glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &mag_filter));
-	PULSAR_TRY(glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrap_s));
-	PULSAR_TRY(glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrap_t));
+	Renderer::Samplers().Bind(sampler ? sampler : m_Sampler, slot);
+}
 
+void Texture::Unbind(TextureSlot slot) const
+{
+	PULSAR_TRY(glActiveTexture(GL_TEXTURE0 + slot));
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
-	return TextureSettings(static_cast<MinFilter>(min_filter), static_cast<MagFilter>(mag_filter), static_cast<TextureWrap>(wrap_s), static_cast<TextureWrap>(wrap_t));
 }
 
+// Textures with the same settings share a sampler, so this makes no GL calls unless the settings are new.
+// The mip chain is decided when the image is specified. Mipmap filters on a texture without one sample its base level only.
+void Texture::SetSettings(const TextureSettings& settings)
+{
+	m_Settings = settings;
+	m_Sampler = Renderer::Samplers().GetHandle(settings);
+}
+
+// The settings are kept, since they live in the sampler rather than the texture object.
 void Texture::ReTexImage(Tile const* tile, GLint lod_level)
 {
-	m_Width = tile->GetWidth();
-	m_Height = tile->GetHeight();
-	TextureSettings settings = GetSettings();
+	if (lod_level == 0)
+	{
+		m_Width = tile->GetWidth();
+		m_Height = tile->GetHeight();
+	}
 	TexImage(tile, "Cannot renew texture from tile pointer: BPP is not 4, 3, 2, or 1.", lod_level);
-	SetSettings(settings);
 }
 
 void Texture::ReTexImage(GLint lod_level)
@@ -180,17 +335,335 @@ void Texture::ReTexImage(GLint lod_level)
 	}
 }
 
+void Texture::SubImage(const void* pixels, int x, int y, int width, int height, int row_length) const
+{
+	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, m_RID));
+	PULSAR_TRY(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+	PULSAR_TRY(glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length));
+	PULSAR_TRY(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+	PULSAR_TRY(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+	if (m_Levels > 1)
+	{
+		PULSAR_TRY(glGenerateMipmap(GL_TEXTURE_2D));
+	}
+	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
 const TextureSettings Texture::linear_settings = { MinFilter::Linear, MagFilter::Linear, TextureWrap::ClampToEdge, TextureWrap::ClampToEdge };
 const TextureSettings Texture::nearest_settings = { MinFilter::Nearest, MagFilter::Nearest, TextureWrap::ClampToEdge, TextureWrap::ClampToEdge };
 
-void TextureRegistry::Bind(TextureHandle handle, TextureSlot slot)
+// Decode jobs refer to the registry and the renderer's uploader, so they must finish first.
+TextureRegistry::~TextureRegistry()
+{
+	JobSystem::Wait(decode_jobs);
+}
+
+// Element lookups are locked, since async creation may insert into the registry while other threads look up textures.
+// Returned pointers stay valid until the handle is destroyed, or the main thread next draws. Eviction, atlas maintenance and DestroyAsync
+// only free textures at the start of a draw, while the main thread waits on the GL thread. Other threads must not keep them across draws.
+// Aliases return the texture they sample.
+Texture const* TextureRegistry::Get(TextureHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(Target(handle));
+}
+
+Texture* TextureRegistry::Get(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(Target(handle));
+}
+
+TextureHandle TextureRegistry::GetHandle(const TextureConstructArgs_filepath& args)
+{
+	if (Renderer::Atlases().Accepts(args))
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto iter = regions.find(args);
+			if (iter != regions.end())
+			{
+				auto region = iter->second.find(args.settings);
+				if (region != iter->second.end())
+					return region->second;
+			}
+		}
+		// packing runs outside the lock, so another thread may have packed the same image meanwhile. Its region is kept, and this one released.
+		if (TextureHandle region = Renderer::Atlases().Pack(args))
+		{
+			TextureHandle existing = 0;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto [iter, inserted] = regions[args].try_emplace(args.settings, region);
+				if (!inserted)
+					existing = iter->second;
+			}
+			if (!existing)
+				return region;
+			Renderer::Atlases().Release(region);
+			return existing;
+		}
+	}
+	TextureHandle handle = 0;
+	Renderer::_GLInvoke([this, &args, &handle]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		handle = Base::GetHandle(args);
+		Track(handle);
+		handle = AliasOf(handle, args.settings);
+	});
+	return handle;
+}
+
+TextureHandle TextureRegistry::GetHandle(const TextureConstructArgs_tile& args)
+{
+	TextureHandle handle = 0;
+	Renderer::_GLInvoke([this, &args, &handle]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		handle = Base::GetHandle(args);
+		Track(handle);
+		handle = AliasOf(handle, args.settings);
+	});
+	return handle;
+}
+
+TextureHandle TextureRegistry::Register(Texture&& texture)
+{
+	TextureHandle handle = 0;
+	Renderer::_GLInvoke([this, &texture, &handle]() { std::lock_guard<std::mutex> lock(mutex); handle = Base::Register(std::move(texture)); Track(handle); });
+	return handle;
+}
+
+bool TextureRegistry::Destroy(TextureHandle handle)
+{
+	if (Renderer::Atlases().Release(handle))
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Forget(handle);
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (aliases.erase(handle))
+			return true;
+	}
+	bool destroyed = false;
+	Renderer::_GLInvoke([this, handle, &destroyed]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto pend = pending.find(handle);
+		if (pend != pending.end())
+		{
+			// evicted handles have no upload in flight that would clean them up
+			if (pend->second.evicted)
+			{
+				pending.erase(pend);
+				Forget(handle);
+			}
+			else
+				pend->second.cancelled = true;
+			destroyed = true;
+		}
+		else
+		{
+			Untrack(handle);
+			std::erase_if(aliases, [handle](const auto& alias) { return alias.second.texture == handle; });
+			destroyed = Base::Destroy(handle);
+		}
+	});
+	return destroyed;
+}
+
+// Reserves a handle for args, and records it as pending. Args that are already registered or pending return their existing handle, or an alias of it.
+template<typename ConstructArgs>
+TextureHandle TextureRegistry::Reserve(const ConstructArgs& args, std::unordered_map<ConstructArgs, TextureHandle>& lookup, int width, int height, bool& reserved)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = lookup.find(args);
+	if (iter != lookup.end())
+		return AliasOf(iter->second, args.settings);
+	if (current_handle == HANDLE_CAP)
+		throw RegistryFullException();
+	TextureHandle handle = current_handle++;
+	lookup[args] = handle;
+	pending[handle] = { width, height, args.settings };
+	reserved = true;
+	return handle;
+}
+
+// Decodes on a job worker, and uploads once the uploader gets to it.
+void TextureRegistry::Load(TextureHandle handle, const TextureConstructArgs_filepath& args)
+{
+	JobSystem::Submit([this, args, handle]() {
+		TextureUploader::Upload upload;
+		if (TextureCache::Enabled())
+		{
+			auto image = std::make_unique<CompressedImage>();
+			if (TextureCache::Load(TileConstructArgs_filepath(args.filepath, args.svg_scale), args.settings, *image))
+				upload.image = std::move(image);
+		}
+		if (!upload.image)
+			upload.tile = std::make_unique<Tile>(TileConstructArgs_filepath(args.filepath, args.svg_scale));
+		upload.settings = args.settings;
+		upload.finish = [this, handle, settings = args.settings, label = args.filepath](Texture* texture) { Resolve(handle, texture, settings, label); };
+		Renderer::Uploader().Enqueue(std::move(upload));
+	}, &decode_jobs);
+}
+
+void TextureRegistry::Load(TextureHandle handle, TileHandle tile, const TextureSettings& settings)
+{
+	TextureUploader::Upload upload;
+	upload.tileHandle = tile;
+	upload.settings = settings;
+	upload.finish = [this, handle, settings, label = "tile " + std::to_string(tile)](Texture* texture) { Resolve(handle, texture, settings, label); };
+	Renderer::Uploader().Enqueue(std::move(upload));
+}
+
+// Called on the GL thread once the upload of a pending handle ran. Settings changed while pending are applied here.
+void TextureRegistry::Resolve(TextureHandle handle, Texture* texture, const TextureSettings& uploaded_settings, const std::string& label)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Pending pend = pending[handle];
+	pending.erase(handle);
+	if (texture && !pend.cancelled)
+	{
+		if (pend.settings != uploaded_settings)
+			texture->SetSettings(pend.settings);
+		GLDebug::Label(GL_TEXTURE, texture->GetRID(), label);
+		registry.emplace(handle, std::move(*texture));
+		Track(handle);
+	}
+	else
+	{
+		Forget(handle);
+		if (!pend.cancelled)
+			Logger::LogError("Failed to create pending texture (" + std::to_string(handle) + ") from " + label + ".");
+	}
+}
+
+TextureHandle TextureRegistry::GetHandleAsync(const TextureConstructArgs_filepath& args)
+{
+	// only the image header is read up front, so that actors can be sized before the texture exists
+	int width = 0, height = 0, bpp;
+	stbi_info(args.filepath.c_str(), &width, &height, &bpp);
+	bool reserved = false;
+	TextureHandle handle = Reserve(args, lookup_1, width, height, reserved);
+	if (reserved)
+		Load(handle, args);
+	return handle;
+}
+
+TextureHandle TextureRegistry::GetHandleAsync(const TextureConstructArgs_tile& args)
+{
+	Tile const* tile = Renderer::Tiles().Get(args.tile);
+	bool reserved = false;
+	TextureHandle handle = Reserve(args, lookup_2, tile ? tile->GetWidth() : 0, tile ? tile->GetHeight() : 0, reserved);
+	if (reserved)
+		Load(handle, args.tile, args.settings);
+	return handle;
+}
+
+// Pending handles take the settings with them when they are created, and aliases when they are next bound. Otherwise, the settings are queued.
+void TextureRegistry::SetSettingsAsync(TextureHandle handle, const TextureSettings& settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto alias = aliases.find(handle);
+		if (alias != aliases.end())
+		{
+			alias->second.settings = settings;
+			alias->second.sampler = 0;
+			return;
+		}
+		auto pend = pending.find(handle);
+		if (pend != pending.end())
+		{
+			pend->second.settings = settings;
+			return;
+		}
+	}
+	Renderer::GLQueue().Enqueue([this, handle, settings]() { SetSettings(handle, settings); });
+}
+
+void TextureRegistry::DestroyAsync(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	deferred_destroys.push_back(handle);
+}
+
+bool TextureRegistry::_HasDeferredDestroys() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !deferred_destroys.empty();
+}
+
+// Must be called on the GL thread, while the main thread waits for it (see Renderer::_Maintain).
+void TextureRegistry::_DestroyDeferred()
+{
+	std::vector<TextureHandle> handles;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handles.swap(deferred_destroys);
+	}
+	for (TextureHandle handle : handles)
+		Destroy(handle);
+}
+
+bool TextureRegistry::IsPending(TextureHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending.find(Target(handle)) != pending.end();
+}
+
+void TextureRegistry::DefineFallbackTexture()
+{
+	unsigned char* image = new unsigned char[4] { 0x80, 0x80, 0x80, 0xFF };
+	fallback_texture = Register(Texture(Tile(TileConstructArgs_buffer(image, 1, 1, 4, TileDeletionPolicy::FROM_NEW)), Texture::nearest_settings));
+}
+
+int TextureRegistry::GetWidth(TextureHandle handle)
+{
+	AtlasRegion region;
+	if (Renderer::Atlases().GetRegion(handle, region))
+		return region.width;
+	Texture const* texture = Get(handle);
+	if (texture)
+		return texture->GetWidth();
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pend = pending.find(Target(handle));
+	return pend != pending.end() ? pend->second.width : 0;
+}
+
+int TextureRegistry::GetHeight(TextureHandle handle)
 {
+	AtlasRegion region;
+	if (Renderer::Atlases().GetRegion(handle, region))
+		return region.height;
 	Texture const* texture = Get(handle);
 	if (texture)
-		texture->Bind(slot);
+		return texture->GetHeight();
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pend = pending.find(Target(handle));
+	return pend != pending.end() ? pend->second.height : 0;
+}
+
+void TextureRegistry::Bind(TextureHandle handle, TextureSlot slot, SamplerHandle sampler)
+{
+	AtlasRegion region;
+	if (Renderer::Atlases().GetRegion(handle, region))
+		handle = region.page;
+	if (!sampler)
+		sampler = AliasSampler(handle);
+	Texture const* texture = Get(handle);
+	if (texture)
+		texture->Bind(slot, sampler);
+	else if (IsPending(handle))
+	{
+		Texture const* fallback = Get(fallback_texture);
+		if (fallback)
+			fallback->Bind(slot, sampler);
+	}
 #if !PULSAR_IGNORE_WARNINGS_NULL_TEXTURE
 	else
-		Logger::LogWarning("Failed to bind texture at handle (" + std::to_string(handle) + ") to slot (" + std::to_string(slot) + ").");
+		Logger::LogFormat(Logger::Level::WARNING, "Failed to bind texture at handle ({}) to slot ({}).", handle, slot);
 #endif
 }
 
@@ -198,15 +671,295 @@ void TextureRegistry::Unbind(TextureSlot slot)
 {
 	PULSAR_TRY(glActiveTexture(GL_TEXTURE0 + slot));
 	PULSAR_TRY(glBindTexture(GL_TEXTURE_2D, 0));
+	Renderer::Samplers().Unbind(slot);
 }
 
 void TextureRegistry::SetSettings(TextureHandle handle, const TextureSettings& settings)
 {
-	Texture const* texture = Get(handle);
+	if (Renderer::Atlases().IsRegion(handle))
+	{
+		Renderer::Atlases().SetSettings(handle, settings);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto alias = aliases.find(handle);
+		if (alias != aliases.end())
+		{
+			alias->second.settings = settings;
+			alias->second.sampler = 0;
+			return;
+		}
+	}
+	Texture* texture = Get(handle);
 	if (texture)
-		texture->SetSettings(settings);
+		Renderer::_GLInvoke([texture, &settings]() { texture->SetSettings(settings); });
 #if !PULSAR_IGNORE_WARNINGS_NULL_TEXTURE
 	else
 		Logger::LogWarning("Failed to set settings at texture handle (" + std::to_string(handle) + ").");
 #endif
 }
+
+void TextureRegistry::ReTexImage(TextureHandle handle, GLint lod_level)
+{
+	Renderer::_GLInvoke([this, handle, lod_level]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		TextureHandle target = Target(handle);
+		Texture* texture = Base::Get(target);
+		if (!texture)
+		{
+#if !PULSAR_IGNORE_WARNINGS_NULL_TEXTURE
+			Logger::LogWarning("Failed to re-upload texture at handle (" + std::to_string(handle) + ").");
+#endif
+			return;
+		}
+		texture->ReTexImage(lod_level);
+		Track(target);
+	});
+}
+
+void TextureRegistry::SubImage(TextureHandle handle, const unsigned char* pixels, int x, int y, int width, int height, int row_length)
+{
+	if (Renderer::Atlases().IsRegion(handle))
+	{
+		Logger::LogWarning("Cannot update dynamic atlas region (" + std::to_string(handle) + ").");
+		return;
+	}
+	Texture const* texture = Get(handle);
+	if (texture)
+		Renderer::_GLInvoke([texture, pixels, x, y, width, height, row_length]() { Renderer::Uploader().SubImage(*texture, pixels, x, y, width, height, row_length); });
+#if !PULSAR_IGNORE_WARNINGS_NULL_TEXTURE
+	else
+		Logger::LogWarning("Failed to update texture at handle (" + std::to_string(handle) + ").");
+#endif
+}
+
+// Textures used this recently may still be bound by snapshots that are not submitted yet.
+static constexpr unsigned long long RESIDENCY_FRAMES_IN_FLIGHT = 2;
+
+// Called when a texture is batched. An evicted texture starts reloading, and is drawn as the fallback texture until it is resident again.
+void TextureRegistry::Touch(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	handle = Target(handle);
+	auto iter = residency.find(handle);
+	if (iter != residency.end())
+	{
+		iter->second.lastUsedFrame = frame.load(std::memory_order_relaxed);
+		return;
+	}
+	auto pend = pending.find(handle);
+	if (pend == pending.end() || !pend->second.evicted)
+		return;
+	pend->second.evicted = false;
+	if (pend->second.tile)
+	{
+		Load(handle, pend->second.tile, pend->second.settings);
+		return;
+	}
+	for (const auto& [args, h] : lookup_1)
+	{
+		if (h == handle)
+		{
+			Load(handle, args);
+			return;
+		}
+	}
+}
+
+// Aliases sample their texture through a sampler of their settings, which is created here on first bind, on the GL thread. Other handles return 0.
+SamplerHandle TextureRegistry::AliasSampler(TextureHandle handle)
+{
+	TextureSettings settings;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto alias = aliases.find(handle);
+		if (alias == aliases.end())
+			return 0;
+		if (alias->second.sampler)
+			return alias->second.sampler;
+		settings = alias->second.settings;
+	}
+	// sampler creation takes the sampler registry's lock, so it runs outside this one
+	SamplerHandle sampler = Renderer::Samplers().GetHandle(settings);
+	std::lock_guard<std::mutex> lock(mutex);
+	auto alias = aliases.find(handle);
+	if (alias != aliases.end() && alias->second.settings == settings)
+		alias->second.sampler = sampler;
+	return sampler;
+}
+
+// Records the budget, and whether the resident bytes exceed it. A budget of 0 disables eviction.
+bool TextureRegistry::_OverBudget(size_t budget_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = budget_bytes;
+	return budget_bytes != 0 && resident_bytes > budget_bytes;
+}
+
+// Evicts least recently used textures until the resident bytes fit the budget. A budget of 0 disables eviction.
+// Must be called on the GL thread, while the main thread waits for it (see Renderer::_Maintain), as it frees textures that may be pointed to.
+void TextureRegistry::_EnforceBudget(size_t budget_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = budget_bytes;
+	if (budget_bytes == 0 || resident_bytes <= budget_bytes)
+		return;
+	unsigned long long current = frame.load(std::memory_order_relaxed);
+	std::vector<std::pair<unsigned long long, TextureHandle>> candidates;
+	for (const auto& [handle, res] : residency)
+	{
+		if (res.lastUsedFrame + RESIDENCY_FRAMES_IN_FLIGHT < current)
+			candidates.push_back({ res.lastUsedFrame, handle });
+	}
+	std::sort(candidates.begin(), candidates.end());
+	for (const auto& [last_used, handle] : candidates)
+	{
+		if (resident_bytes <= budget_bytes)
+			break;
+		Evict(handle);
+	}
+}
+
+// Lists every resident and evicted texture, largest first.
+TextureResidencyReport TextureRegistry::ResidencyReport() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	TextureResidencyReport report;
+	report.residentBytes = resident_bytes;
+	report.budgetBytes = budget;
+	report.evictions = evictions;
+	for (const auto& [handle, texture] : registry)
+	{
+		auto res = residency.find(handle);
+		report.entries.push_back({ handle, SourceOf(handle), texture.GetWidth(), texture.GetHeight(), texture.GetBytes(),
+			res != residency.end() ? res->second.lastUsedFrame : 0, true });
+	}
+	for (const auto& [handle, pend] : pending)
+	{
+		if (pend.evicted)
+			report.entries.push_back({ handle, SourceOf(handle), pend.width, pend.height, 0, 0, false });
+	}
+	std::sort(report.entries.begin(), report.entries.end(), [](const auto& a, const auto& b) { return a.bytes > b.bytes; });
+	return report;
+}
+
+void TextureRegistry::LogResidencyReport() const
+{
+	TextureResidencyReport report = ResidencyReport();
+	Logger::LogInfo("Texture residency: " + std::to_string(report.residentBytes) + " bytes resident, budget " + std::to_string(report.budgetBytes)
+		+ " bytes, " + std::to_string(report.evictions) + " evictions.");
+	for (const auto& entry : report.entries)
+	{
+		Logger::LogInfo("  (" + std::to_string(entry.handle) + ") " + entry.source + " " + std::to_string(entry.width) + "x" + std::to_string(entry.height) + ": "
+			+ (entry.resident ? std::to_string(entry.bytes) + " bytes, last used in frame " + std::to_string(entry.lastUsedFrame) : std::string("evicted")));
+	}
+}
+
+TextureHandle TextureRegistry::_ReserveHandle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (current_handle == HANDLE_CAP)
+		throw RegistryFullException();
+	return current_handle++;
+}
+
+// The residency helpers below are called with the mutex held.
+// Tracking a tracked texture again updates its bytes, after it was re-uploaded at another size or level count.
+void TextureRegistry::Track(TextureHandle handle)
+{
+	Texture const* texture = Base::Get(handle);
+	if (!texture)
+		return;
+	auto iter = residency.find(handle);
+	if (iter != residency.end())
+	{
+		resident_bytes = resident_bytes - iter->second.bytes + texture->GetBytes();
+		iter->second.bytes = texture->GetBytes();
+		return;
+	}
+	residency[handle] = { texture->GetBytes(), frame.load(std::memory_order_relaxed) };
+	resident_bytes += texture->GetBytes();
+}
+
+void TextureRegistry::Untrack(TextureHandle handle)
+{
+	auto iter = residency.find(handle);
+	if (iter == residency.end())
+		return;
+	resident_bytes -= iter->second.bytes;
+	residency.erase(iter);
+}
+
+// Drops the lookup entries and aliases of a handle, so that its args create a new texture next time.
+void TextureRegistry::Forget(TextureHandle handle)
+{
+	std::erase_if(lookup_1, [handle](const auto& entry) { return entry.second == handle; });
+	std::erase_if(lookup_2, [handle](const auto& entry) { return entry.second == handle; });
+	std::erase_if(aliases, [handle](const auto& alias) { return alias.second.texture == handle; });
+	for (auto iter = regions.begin(); iter != regions.end();)
+	{
+		std::erase_if(iter->second, [handle](const auto& entry) { return entry.second == handle; });
+		iter = iter->second.empty() ? regions.erase(iter) : std::next(iter);
+	}
+}
+
+// Returns handle if settings are those of its texture, and an alias sampling it with settings otherwise.
+TextureHandle TextureRegistry::AliasOf(TextureHandle handle, const TextureSettings& settings)
+{
+	Texture const* texture = Base::Get(handle);
+	auto pend = pending.find(handle);
+	if (texture ? texture->GetSettings() == settings : pend == pending.end() || pend->second.settings == settings)
+		return handle;
+	for (const auto& [alias, entry] : aliases)
+	{
+		if (entry.texture == handle && entry.settings == settings)
+			return alias;
+	}
+	if (current_handle == HANDLE_CAP)
+		throw RegistryFullException();
+	TextureHandle alias = current_handle++;
+	aliases[alias] = { handle, settings };
+	return alias;
+}
+
+TextureHandle TextureRegistry::Target(TextureHandle handle) const
+{
+	auto iter = aliases.find(handle);
+	return iter != aliases.end() ? iter->second.texture : handle;
+}
+
+// Only textures that can be recreated are evicted: those with a tile, and those created from a file.
+bool TextureRegistry::Evict(TextureHandle handle)
+{
+	if (handle == fallback_texture)
+		return false;
+	Texture const* texture = Base::Get(handle);
+	if (!texture)
+		return false;
+	TileHandle tile = texture->GetTileHandle();
+	if (tile ? !Renderer::Tiles().Get(tile) : std::none_of(lookup_1.begin(), lookup_1.end(), [handle](const auto& entry) { return entry.second == handle; }))
+		return false;
+	pending[handle] = { texture->GetWidth(), texture->GetHeight(), texture->GetSettings(), false, true, tile };
+	Untrack(handle);
+	Base::Destroy(handle);
+	++evictions;
+	return true;
+}
+
+std::string TextureRegistry::SourceOf(TextureHandle handle) const
+{
+	if (handle == fallback_texture)
+		return "fallback";
+	for (const auto& [args, h] : lookup_1)
+	{
+		if (h == handle)
+			return args.filepath;
+	}
+	for (const auto& [args, h] : lookup_2)
+	{
+		if (h == handle)
+			return "tile " + std::to_string(args.tile);
+	}
+	return "registered";
+}
@@ -2,8 +2,13 @@
 
 #include <GL/glew.h>
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "JobSystem.h"
 #include "Pulsar.h"
 #include "Tile.h"
 #include "Registry.inl"
@@ -68,6 +73,8 @@ struct TextureSettings
 	TextureWrap wrapS = TextureWrap::ClampToEdge;
 	TextureWrap wrapT = TextureWrap::ClampToEdge;
 
+	bool UsesMipmaps() const { return minFilter != MinFilter::Nearest && minFilter != MinFilter::Linear; }
+
 	bool operator==(const TextureSettings&) const = default;
 };
 
@@ -84,6 +91,8 @@ struct std::hash<TextureSettings>
 	}
 };
 
+// Textures are keyed on their source and version, and on whether they have a mip chain, which their storage fixes.
+// Other settings only pick a sampler, so args that differ in them share one texture (see TextureRegistry).
 struct TextureConstructArgs_filepath
 {
 	std::string filepath;
@@ -99,7 +108,11 @@ struct TextureConstructArgs_filepath
 		bool temporary_buffer = false, TextureVersion version = 0, float svg_scale = 1.0f)
 		: filepath(std::move(filepath)), settings(settings), temporary_buffer(temporary_buffer), version(version), svg_scale(svg_scale) {}
 
-	bool operator==(const TextureConstructArgs_filepath&) const = default;
+	bool operator==(const TextureConstructArgs_filepath& other) const
+	{
+		return filepath == other.filepath && temporary_buffer == other.temporary_buffer && version == other.version && svg_scale == other.svg_scale
+			&& settings.UsesMipmaps() == other.settings.UsesMipmaps();
+	}
 };
 
 template<>
@@ -108,8 +121,9 @@ struct std::hash<TextureConstructArgs_filepath>
 	size_t operator()(const TextureConstructArgs_filepath& args) const
 	{
 		auto hash1 = hash<std::string>{}(args.filepath);
-		auto hash2 = hash<TextureSettings>{}(args.settings);
-		return hash1 ^ (hash2 << 1);
+		auto hash2 = hash<TextureVersion>{}(args.version);
+		auto hash3 = hash<bool>{}(args.settings.UsesMipmaps());
+		return hash1 ^ (hash2 << 1) ^ (hash3 << 2);
 	}
 };
 
@@ -122,7 +136,10 @@ struct TextureConstructArgs_tile
 	TextureConstructArgs_tile(TileHandle tile, TextureVersion version = 0, const TextureSettings& settings = {})
 		: tile(tile), version(version), settings(settings) {}
 
-	bool operator==(const TextureConstructArgs_tile&) const = default;
+	bool operator==(const TextureConstructArgs_tile& other) const
+	{
+		return tile == other.tile && version == other.version && settings.UsesMipmaps() == other.settings.UsesMipmaps();
+	}
 };
 
 template<>
@@ -132,19 +149,26 @@ struct std::hash<TextureConstructArgs_tile>
 	{
 		auto hash1 = hash<TileHandle>{}(args.tile);
 		auto hash2 = hash<TextureVersion>{}(args.version);
-		auto hash3 = hash<TextureSettings>{}(args.settings);
-		return hash1 ^ (hash2 << 1) ^ (hash3 < 2);
+		auto hash3 = hash<bool>{}(args.settings.UsesMipmaps());
+		return hash1 ^ (hash2 << 1) ^ (hash3 << 2);
 	}
 };
 
 typedef GLuint Texture_RID;
 
+struct CompressedImage;
+
 class Texture
 {
 	Texture_RID m_RID;
 	int m_Width;
 	int m_Height;
+	GLsizei m_Levels = 0;
+	size_t m_Bytes = 0;
 	TileHandle m_Tile;
+	// sampling state lives in a shared sampler object, and is only cached here
+	TextureSettings m_Settings;
+	SamplerHandle m_Sampler = 0;
 
 public:
 	//Texture(const char* filepath, TextureSettings settings = {}, bool temporary_buffer = true, float svg_scale = 1.0f);
@@ -152,6 +176,11 @@ public:
 	//Texture(TileHandle tile, TextureSettings settings = {});
 	Texture(const TextureConstructArgs_tile& args);
 	Texture(Tile&& tile, TextureSettings settings = {});
+	// pixels may be an offset into the bound GL_PIXEL_UNPACK_BUFFER. tile is only recorded, for ReTexImage().
+	// mip_source is a client copy of pixels, from which texture_cpu_mipmaps builds the mip chain. Without it, the chain is generated on the GPU.
+	Texture(const void* pixels, int width, int height, int bpp, TileHandle tile = 0, const TextureSettings& settings = {}, const unsigned char* mip_source = nullptr);
+	// data may be an offset into the bound GL_PIXEL_UNPACK_BUFFER, at which the image's data was staged.
+	Texture(const CompressedImage& image, const void* data, const TextureSettings& settings = {});
 	Texture(const Texture& texture) = delete;
 	Texture(Texture&& texture) noexcept;
 	Texture& operator=(Texture&& texture) noexcept;
@@ -159,16 +188,26 @@ public:
 	
 	operator bool() const { return m_RID > 0; }
 
-	void Bind(TextureSlot slot = 0) const;
+	// Binds the texture with sampler, or with the sampler of its own settings if 0.
+	void Bind(TextureSlot slot = 0, SamplerHandle sampler = 0) const;
 	void Unbind(TextureSlot slot = 0) const;
 
-	void SetSettings(const TextureSettings& settings) const;
-	TextureSettings GetSettings() const;
+	void SetSettings(const TextureSettings& settings);
+	const TextureSettings& GetSettings() const { return m_Settings; }
+	SamplerHandle GetSampler() const { return m_Sampler; }
+	// Registered textures are re-uploaded through TextureRegistry::ReTexImage, so that their residency follows the new size.
 	void ReTexImage(Tile const* tile, GLint lod_level = 0);
 	void ReTexImage(GLint lod_level = 0);
+	// Replaces a region of the base level with RGBA8 pixels, whose rows are row_length texels apart (width if 0).
+	// pixels may be an offset into the bound GL_PIXEL_UNPACK_BUFFER. The other levels of mipmapped textures are regenerated on the GPU.
+	void SubImage(const void* pixels, int x, int y, int width, int height, int row_length = 0) const;
 
+	Texture_RID GetRID() const { return m_RID; }
 	int GetWidth() const { return m_Width; }
 	int GetHeight() const { return m_Height; }
+	GLsizei GetLevels() const { return m_Levels; }
+	// estimated VRAM of every level, with RGB8 counted as padded to 4 bytes per texel
+	size_t GetBytes() const { return m_Bytes; }
 	TileHandle GetTileHandle() const { return m_Tile; }
 
 	static const TextureSettings linear_settings;
@@ -176,16 +215,137 @@ public:
 
 private:
 	void TexImage(Tile const* tile, const std::string& err_msg, GLint lod_level = 0);
+	void TexImage(const void* pixels, int width, int height, int bpp, const std::string& err_msg, GLint lod_level = 0, const unsigned char* mip_source = nullptr);
+	void TexImage(const CompressedImage& image, const void* data);
+};
+
+// Creation and destruction are handed off to the render thread, if one is running.
+// The *Async functions may be called from any thread. They return immediately, and the work runs when the GL command queue is drained,
+// except for DestroyAsync, which waits for the start of the next draw (see Get).
+// An async handle stays pending until its texture is created, during which it is bound as the fallback texture.
+// Async images are decoded on job workers and uploaded through the renderer's TextureUploader, within its per-frame byte budget.
+// Their decoded pixels are dropped after the upload, regardless of temporary_buffer. Like temporary_buffer textures, they load through the TextureCache if enabled.
+// Small images loaded from file with shareable settings are packed into the renderer's DynamicAtlas instead, and get a region handle.
+// Region handles report the image's size, bind their page, and are released by Destroy.
+// Getting a handle with settings other than those of the existing texture for the same args returns an alias handle, which samples that texture
+// through a sampler of its own settings instead of uploading it again. Aliases share the texture's size, residency and updates, and are dropped with it.
+// Residency: textures record the frame they were last batched in. Over the VRAM budget, least recently used textures that can be reloaded,
+// i.e. that have a tile or were created from a file, are evicted back to pending. Their handles stay valid, and the next use reloads them.
+struct TextureResidencyReport
+{
+	struct Entry
+	{
+		TextureHandle handle;
+		std::string source;
+		int width, height;
+		size_t bytes;
+		unsigned long long lastUsedFrame;
+		bool resident;
+	};
+	std::vector<Entry> entries;
+	size_t residentBytes = 0;
+	size_t budgetBytes = 0;
+	unsigned long long evictions = 0;
 };
 
 class TextureRegistry : public Registry<Texture, TextureHandle, TextureConstructArgs_filepath, TextureConstructArgs_tile>
 {
+	typedef Registry<Texture, TextureHandle, TextureConstructArgs_filepath, TextureConstructArgs_tile> Base;
+
+	struct Pending
+	{
+		int width, height;
+		TextureSettings settings;
+		bool cancelled = false;
+		// evicted handles wait for their next use before reloading, from tile if set and from their filepath otherwise
+		bool evicted = false;
+		TileHandle tile = 0;
+	};
+	struct Residency
+	{
+		size_t bytes;
+		unsigned long long lastUsedFrame;
+	};
+	struct Alias
+	{
+		TextureHandle texture;
+		TextureSettings settings;
+		// resolved on the GL thread when first bound
+		SamplerHandle sampler = 0;
+	};
+	std::unordered_map<TextureHandle, Pending> pending;
+	std::unordered_map<TextureHandle, Alias> aliases;
+	// destroyed by DestroyAsync once the main thread waits on the GL thread, since other threads may still point to them
+	std::vector<TextureHandle> deferred_destroys;
+	// packed regions are not aliased, since each page has its own settings
+	std::unordered_map<TextureConstructArgs_filepath, std::unordered_map<TextureSettings, TextureHandle>> regions;
+	std::unordered_map<TextureHandle, Residency> residency;
+	size_t resident_bytes = 0;
+	size_t budget = 0;
+	unsigned long long evictions = 0;
+	std::atomic<unsigned long long> frame = 0;
+	mutable std::mutex mutex;
+	TextureHandle fallback_texture = 0;
+	JobCounter decode_jobs;
+
 public:
-	void Bind(TextureHandle handle, TextureSlot slot);
+	TextureRegistry() = default;
+	~TextureRegistry();
+
+	Texture const* Get(TextureHandle handle) const;
+	Texture* Get(TextureHandle handle);
+	TextureHandle GetHandle(const TextureConstructArgs_filepath& args);
+	TextureHandle GetHandle(const TextureConstructArgs_tile& args);
+	TextureHandle Register(Texture&& texture);
+	bool Destroy(TextureHandle handle);
+
+	TextureHandle GetHandleAsync(const TextureConstructArgs_filepath& args);
+	TextureHandle GetHandleAsync(const TextureConstructArgs_tile& args);
+	void SetSettingsAsync(TextureHandle handle, const TextureSettings& settings);
+	void DestroyAsync(TextureHandle handle);
+	bool _HasDeferredDestroys() const;
+	void _DestroyDeferred();
+	bool IsPending(TextureHandle handle) const;
+
+	void DefineFallbackTexture();
+	TextureHandle Fallback() const { return fallback_texture; }
+
+	// A sampler of 0 samples the texture with the settings of handle.
+	void Bind(TextureHandle handle, TextureSlot slot, SamplerHandle sampler = 0);
 	void Unbind(TextureSlot slot);
 
-	int GetWidth(TextureHandle handle) { Texture const* texture = Get(handle); return texture ? texture->GetWidth() : 0; }
-	int GetHeight(TextureHandle handle) { Texture const* texture = Get(handle); return texture ? texture->GetHeight() : 0; }
+	int GetWidth(TextureHandle handle);
+	int GetHeight(TextureHandle handle);
 	TileHandle GetTileHandle(TextureHandle handle) { Texture const* texture = Get(handle); return texture ? texture->GetTileHandle() : 0; }
 	void SetSettings(TextureHandle handle, const TextureSettings& settings);
+	// Re-uploads a texture from its tile, and updates its residency to the new size and level count.
+	void ReTexImage(TextureHandle handle, GLint lod_level = 0);
+	// Replaces a region of a texture with RGBA8 pixels, staged through the renderer's TextureUploader. Rows are row_length texels apart (width if 0).
+	// Updates are lost if the texture is evicted, since it reloads from its tile or file.
+	void SubImage(TextureHandle handle, const unsigned char* pixels, int x, int y, int width, int height, int row_length = 0);
+
+	void Touch(TextureHandle handle);
+	void _NextFrame() { frame.fetch_add(1, std::memory_order_relaxed); }
+	bool _OverBudget(size_t budget_bytes);
+	void _EnforceBudget(size_t budget_bytes);
+	TextureResidencyReport ResidencyReport() const;
+	void LogResidencyReport() const;
+
+	// Reserves a handle that no texture is registered at, for regions of the dynamic atlas.
+	TextureHandle _ReserveHandle();
+
+private:
+	template<typename ConstructArgs>
+	TextureHandle Reserve(const ConstructArgs& args, std::unordered_map<ConstructArgs, TextureHandle>& lookup, int width, int height, bool& reserved);
+	void Load(TextureHandle handle, const TextureConstructArgs_filepath& args);
+	void Load(TextureHandle handle, TileHandle tile, const TextureSettings& settings);
+	void Resolve(TextureHandle handle, Texture* texture, const TextureSettings& uploaded_settings, const std::string& label);
+	TextureHandle AliasOf(TextureHandle handle, const TextureSettings& settings);
+	TextureHandle Target(TextureHandle handle) const;
+	SamplerHandle AliasSampler(TextureHandle handle);
+	void Track(TextureHandle handle);
+	void Untrack(TextureHandle handle);
+	void Forget(TextureHandle handle);
+	bool Evict(TextureHandle handle);
+	std::string SourceOf(TextureHandle handle) const;
 };
@@ -0,0 +1,708 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "IO.h"
+#include "JobSystem.h"
+#include "Logger.inl"
+#include "PulsarSettings.h"
+#include "utils/PixelKernels.h"
+
+static std::atomic<bool> bc_supported = false;
+
+// Bumped whenever the cooker's output changes, so that stale cache files are not loaded.
+static constexpr unsigned long long COOKER_VERSION = 1;
+
+void TextureCache::Init()
+{
+	bc_supported = GLEW_EXT_texture_compression_s3tc != 0;
+}
+
+bool TextureCache::Enabled()
+{
+	return PulsarSettings::texture_cache();
+}
+
+bool TextureCache::SupportsBC()
+{
+	return bc_supported;
+}
+
+GLenum TextureCache::GLFormat(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case CompressedFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_RGBA8;
+	}
+}
+
+static size_t block_bytes(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return 8;
+	case CompressedFormat::BC3: return 16;
+	default: return 0;
+	}
+}
+
+static size_t level_size(CompressedFormat format, int width, int height)
+{
+	if (format == CompressedFormat::RGBA8)
+		return static_cast<size_t>(width) * height * 4;
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+// ---------- block encoding ----------
+
+static uint16_t pack_565(const float color[3])
+{
+	auto quantize = [](float c, int max) { return static_cast<uint16_t>(std::clamp(static_cast<int>(std::lround(c * max / 255.0f)), 0, max)); };
+	return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+}
+
+static void unpack_565(uint16_t packed, int color[3])
+{
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Palette of a color block. Three-color mode, with a transparent fourth entry, is only used by BC1 blocks with c0 <= c1.
+static void color_palette(uint16_t c0, uint16_t c1, bool three_color, int palette[4][4])
+{
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+	for (int c = 0; c < 3; ++c)
+	{
+		if (three_color)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		else
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = three_color ? 0 : 255;
+}
+
+// Picks the nearest palette entry for each texel. Returns the summed squared error.
+static unsigned int fit_indices(const unsigned char* block, uint16_t c0, uint16_t c1, uint32_t& indices)
+{
+	indices = 0;
+	if (c0 == c1)
+	{
+		int color[3];
+		unpack_565(c0, color);
+		unsigned int error = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				error += (block[i * 4 + c] - color[c]) * (block[i * 4 + c] - color[c]);
+		}
+		return error;
+	}
+	int palette[4][4];
+	color_palette(c0, c1, false, palette);
+	unsigned int error = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		unsigned int best = UINT32_MAX, best_index = 0;
+		for (unsigned int p = 0; p < 4; ++p)
+		{
+			unsigned int d = 0;
+			for (int c = 0; c < 3; ++c)
+				d += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+			if (d < best)
+			{
+				best = d;
+				best_index = p;
+			}
+		}
+		indices |= best_index << (2 * i);
+		error += best;
+	}
+	return error;
+}
+
+// Endpoints are the extremes of the block along its principal axis, refined once by least squares over the chosen indices.
+static void encode_color_block(const unsigned char* block, unsigned char* out)
+{
+	float mean[3] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			mean[c] += block[i * 4 + c];
+	}
+	for (int c = 0; c < 3; ++c)
+		mean[c] /= 16.0f;
+	float cov[3][3] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+		for (int a = 0; a < 3; ++a)
+		{
+			for (int b = 0; b < 3; ++b)
+				cov[a][b] += d[a] * d[b];
+		}
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[3];
+		for (int a = 0; a < 3; ++a)
+			next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+		float norm = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+		if (norm == 0.0f)
+			break;
+		for (int a = 0; a < 3; ++a)
+			axis[a] = next[a] / norm;
+	}
+	float axis_sq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float lo = 0.0f, hi = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float t = ((block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2]) / axis_sq;
+		lo = std::min(lo, t);
+		hi = std::max(hi, t);
+	}
+	float e0[3], e1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		e0[c] = mean[c] + axis[c] * hi;
+		e1[c] = mean[c] + axis[c] * lo;
+	}
+	uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+	if (c0 < c1)
+		std::swap(c0, c1);
+	uint32_t indices;
+	unsigned int error = fit_indices(block, c0, c1, indices);
+
+	if (c0 != c1)
+	{
+		static constexpr float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = {}, bx[3] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int c = 0; c < 3; ++c)
+			{
+				ax[c] += a * block[i * 4 + c];
+				bx[c] += b * block[i * 4 + c];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::abs(det) > 1e-6f)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+				e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+			}
+			uint16_t r0 = pack_565(e0), r1 = pack_565(e1);
+			if (r0 < r1)
+				std::swap(r0, r1);
+			uint32_t refined_indices;
+			unsigned int refined_error = fit_indices(block, r0, r1, refined_indices);
+			if (refined_error < error)
+			{
+				c0 = r0;
+				c1 = r1;
+				indices = refined_indices;
+			}
+		}
+	}
+	memcpy(out, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+static void alpha_palette(int a0, int a1, int palette[8])
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static void encode_alpha_block(const unsigned char* block, unsigned char* out)
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; ++i)
+	{
+		a0 = std::max<int>(a0, block[i * 4 + 3]);
+		a1 = std::min<int>(a1, block[i * 4 + 3]);
+	}
+	int palette[8];
+	alpha_palette(a0, a1, palette);
+	uint64_t indices = 0;
+	if (a0 != a1)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 256;
+			uint64_t best_index = 0;
+			for (int p = 0; p < 8; ++p)
+			{
+				int d = std::abs(block[i * 4 + 3] - palette[p]);
+				if (d < best)
+				{
+					best = d;
+					best_index = p;
+				}
+			}
+			indices |= best_index << (3 * i);
+		}
+	}
+	out[0] = static_cast<unsigned char>(a0);
+	out[1] = static_cast<unsigned char>(a1);
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+static void decode_color_block(const unsigned char* in, bool bc1, unsigned char* texels)
+{
+	uint16_t c0, c1;
+	uint32_t indices;
+	memcpy(&c0, in, 2);
+	memcpy(&c1, in + 2, 2);
+	memcpy(&indices, in + 4, 4);
+	int palette[4][4];
+	color_palette(c0, c1, bc1 && c0 <= c1, palette);
+	for (int i = 0; i < 16; ++i)
+	{
+		const int* color = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 4; ++c)
+			texels[i * 4 + c] = static_cast<unsigned char>(color[c]);
+	}
+}
+
+static void decode_alpha_block(const unsigned char* in, unsigned char* texels)
+{
+	int palette[8];
+	alpha_palette(in[0], in[1], palette);
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i)
+		indices |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+	for (int i = 0; i < 16; ++i)
+		texels[i * 4 + 3] = static_cast<unsigned char>(palette[(indices >> (3 * i)) & 7]);
+}
+
+// Edge texels are repeated into blocks that overhang the image.
+static void gather_block(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char* block)
+{
+	for (int y = 0; y < 4; ++y)
+	{
+		int sy = std::min(by * 4 + y, height - 1);
+		for (int x = 0; x < 4; ++x)
+		{
+			int sx = std::min(bx * 4 + x, width - 1);
+			memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+		}
+	}
+}
+
+static void encode_level(const unsigned char* rgba, int width, int height, CompressedFormat format, unsigned char* out)
+{
+	size_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4, bytes = block_bytes(format);
+	JobSystem::ParallelFor(blocks_y, 0, [&](size_t begin, size_t end) {
+		unsigned char block[64];
+		for (size_t by = begin; by < end; ++by)
+		{
+			for (size_t bx = 0; bx < blocks_x; ++bx)
+			{
+				gather_block(rgba, width, height, static_cast<int>(bx), static_cast<int>(by), block);
+				unsigned char* dst = out + (by * blocks_x + bx) * bytes;
+				if (format == CompressedFormat::BC3)
+				{
+					encode_alpha_block(block, dst);
+					dst += 8;
+				}
+				encode_color_block(block, dst);
+			}
+		}
+	});
+}
+
+// ---------- cooking ----------
+
+// Expands to RGBA8 the way GL samples the tile's format, i.e. missing color channels are 0 and missing alpha is 255.
+static std::vector<unsigned char> to_rgba8(const Tile& tile)
+{
+	size_t count = static_cast<size_t>(tile.GetWidth()) * tile.GetHeight();
+	int bpp = tile.GetBPP();
+	const unsigned char* src = tile.GetImageBuffer();
+	std::vector<unsigned char> rgba(count * 4);
+	if (bpp == 4)
+		memcpy(rgba.data(), src, count * 4);
+	else if (bpp == 3)
+		PixelKernels::RGBToRGBA(src, rgba.data(), count);
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = c < bpp ? src[i * bpp + c] : (c == 3 ? 255 : 0);
+		}
+	}
+	return rgba;
+}
+
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& src, int width, int height, int dst_width, int dst_height)
+{
+	std::vector<unsigned char> dst(static_cast<size_t>(dst_width) * dst_height * 4);
+	PixelKernels::Downsample(src.data(), width, height, dst.data());
+	return dst;
+}
+
+static void append_level(CompressedImage& image, int width, int height, const unsigned char* data)
+{
+	size_t size = level_size(image.format, width, height);
+	image.levels.push_back({ image.data.size(), size, width, height });
+	image.data.insert(image.data.end(), data, data + size);
+}
+
+bool TextureCache::Cook(const Tile& tile, const TextureSettings& settings, CompressedImage& image, float min_psnr)
+{
+	if (!tile || tile.GetBPP() < 1 || tile.GetBPP() > 4 || tile.GetWidth() <= 0 || tile.GetHeight() <= 0)
+		return false;
+	std::vector<std::vector<unsigned char>> chain;
+	chain.push_back(to_rgba8(tile));
+	std::vector<std::pair<int, int>> sizes = { { tile.GetWidth(), tile.GetHeight() } };
+	while (settings.UsesMipmaps() && (sizes.back().first > 1 || sizes.back().second > 1))
+	{
+		auto [width, height] = sizes.back();
+		sizes.push_back({ std::max(width / 2, 1), std::max(height / 2, 1) });
+		chain.push_back(downsample(chain.back(), width, height, sizes.back().first, sizes.back().second));
+	}
+
+	bool opaque = true;
+	for (size_t i = 3; opaque && i < chain[0].size(); i += 4)
+		opaque = chain[0][i] == 255;
+	image = {};
+	image.format = opaque ? CompressedFormat::BC1 : CompressedFormat::BC3;
+	image.width = tile.GetWidth();
+	image.height = tile.GetHeight();
+	std::vector<unsigned char> encoded;
+	for (size_t level = 0; level < chain.size(); ++level)
+	{
+		encoded.resize(level_size(image.format, sizes[level].first, sizes[level].second));
+		encode_level(chain[level].data(), sizes[level].first, sizes[level].second, image.format, encoded.data());
+		append_level(image, sizes[level].first, sizes[level].second, encoded.data());
+	}
+
+	std::vector<unsigned char> decoded;
+	Decompress(image, 0, decoded);
+	double psnr = PSNR(decoded.data(), chain[0].data(), decoded.size() / 4, !opaque);
+	if (psnr < min_psnr)
+	{
+		image.format = CompressedFormat::RGBA8;
+		image.data.clear();
+		image.levels.clear();
+		for (size_t level = 0; level < chain.size(); ++level)
+			append_level(image, sizes[level].first, sizes[level].second, chain[level].data());
+	}
+	return true;
+}
+
+void TextureCache::Decompress(const CompressedImage& image, size_t level, std::vector<unsigned char>& rgba)
+{
+	const CompressedImage::Level& l = image.levels[level];
+	rgba.resize(static_cast<size_t>(l.width) * l.height * 4);
+	const unsigned char* src = image.data.data() + l.offset;
+	if (image.format == CompressedFormat::RGBA8)
+	{
+		memcpy(rgba.data(), src, rgba.size());
+		return;
+	}
+	size_t blocks_x = (l.width + 3) / 4, blocks_y = (l.height + 3) / 4, bytes = block_bytes(image.format);
+	unsigned char texels[64];
+	for (size_t by = 0; by < blocks_y; ++by)
+	{
+		for (size_t bx = 0; bx < blocks_x; ++bx)
+		{
+			const unsigned char* block = src + (by * blocks_x + bx) * bytes;
+			if (image.format == CompressedFormat::BC3)
+			{
+				decode_color_block(block + 8, false, texels);
+				decode_alpha_block(block, texels);
+			}
+			else
+				decode_color_block(block, true, texels);
+			for (size_t y = 0; y < 4 && by * 4 + y < static_cast<size_t>(l.height); ++y)
+			{
+				size_t columns = std::min<size_t>(4, l.width - bx * 4);
+				memcpy(rgba.data() + ((by * 4 + y) * l.width + bx * 4) * 4, texels + y * 16, columns * 4);
+			}
+		}
+	}
+}
+
+void TextureCache::ExpandToRGBA8(CompressedImage& image)
+{
+	if (image.format == CompressedFormat::RGBA8)
+		return;
+	CompressedImage expanded;
+	expanded.width = image.width;
+	expanded.height = image.height;
+	std::vector<unsigned char> rgba;
+	for (size_t level = 0; level < image.levels.size(); ++level)
+	{
+		Decompress(image, level, rgba);
+		append_level(expanded, image.levels[level].width, image.levels[level].height, rgba.data());
+	}
+	image = std::move(expanded);
+}
+
+// Over RGBA8 pixels. Alpha is only compared if requested, so that opaque images are not flattered by their exact alpha.
+double TextureCache::PSNR(const unsigned char* a, const unsigned char* b, size_t pixels, bool alpha)
+{
+	int channels = alpha ? 4 : 3;
+	double squared_error = 0.0;
+	for (size_t i = 0; i < pixels; ++i)
+	{
+		for (int c = 0; c < channels; ++c)
+		{
+			double d = static_cast<double>(a[i * 4 + c]) - b[i * 4 + c];
+			squared_error += d * d;
+		}
+	}
+	if (squared_error == 0.0)
+		return INFINITY;
+	double mse = squared_error / (static_cast<double>(pixels) * channels);
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// ---------- KTX2 ----------
+
+static constexpr unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static constexpr size_t KTX2_HEADER_SIZE = 80;
+static constexpr size_t KTX2_LEVEL_ALIGNMENT = 16;
+
+static uint32_t vk_format(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return 131; // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+	case CompressedFormat::BC3: return 137; // VK_FORMAT_BC3_UNORM_BLOCK
+	default: return 37; // VK_FORMAT_R8G8B8A8_UNORM
+	}
+}
+
+static bool format_of(uint32_t vk, CompressedFormat& format)
+{
+	switch (vk)
+	{
+	case 131: format = CompressedFormat::BC1; return true;
+	case 137: format = CompressedFormat::BC3; return true;
+	case 37: format = CompressedFormat::RGBA8; return true;
+	default: return false;
+	}
+}
+
+// Basic data format descriptor, with linear transfer and straight alpha.
+static std::vector<uint32_t> data_format_descriptor(CompressedFormat format)
+{
+	struct Sample { uint32_t offset, length, channel, upper; };
+	std::vector<Sample> samples;
+	uint32_t color_model, block_dimensions, plane_bytes;
+	switch (format)
+	{
+	case CompressedFormat::BC1:
+		color_model = 128; // KHR_DF_MODEL_BC1A
+		block_dimensions = 0x0303;
+		plane_bytes = 8;
+		samples = { { 0, 64, 0, UINT32_MAX } };
+		break;
+	case CompressedFormat::BC3:
+		color_model = 130; // KHR_DF_MODEL_BC3
+		block_dimensions = 0x0303;
+		plane_bytes = 16;
+		samples = { { 0, 64, 15, UINT32_MAX }, { 64, 64, 0, UINT32_MAX } };
+		break;
+	default:
+		color_model = 1; // KHR_DF_MODEL_RGBSDA
+		block_dimensions = 0;
+		plane_bytes = 4;
+		samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15, 255 } };
+		break;
+	}
+	uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+	std::vector<uint32_t> words = { 4 + block_size, 0, 2 | (block_size << 16), color_model | (1 << 8) | (1 << 16), block_dimensions, plane_bytes, 0 };
+	for (const Sample& sample : samples)
+	{
+		words.push_back(sample.offset | ((sample.length - 1) << 16) | (sample.channel << 24));
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(sample.upper);
+	}
+	return words;
+}
+
+static size_t align_up(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Levels are stored smallest first, as KTX2 requires.
+bool TextureCache::WriteKTX2(const std::string& filepath, const CompressedImage& image)
+{
+	if (!image)
+		return false;
+	std::vector<uint32_t> dfd = data_format_descriptor(image.format);
+	size_t level_count = image.levels.size();
+	size_t dfd_offset = KTX2_HEADER_SIZE + level_count * 24;
+	size_t dfd_size = dfd.size() * 4;
+	std::vector<uint64_t> level_offsets(level_count);
+	size_t offset = dfd_offset + dfd_size;
+	for (size_t level = level_count; level-- > 0;)
+	{
+		offset = align_up(offset, KTX2_LEVEL_ALIGNMENT);
+		level_offsets[level] = offset;
+		offset += image.levels[level].size;
+	}
+
+	std::vector<unsigned char> file(offset, 0);
+	auto put32 = [&file](size_t at, uint32_t value) { memcpy(file.data() + at, &value, 4); };
+	auto put64 = [&file](size_t at, uint64_t value) { memcpy(file.data() + at, &value, 8); };
+	memcpy(file.data(), KTX2_IDENTIFIER, 12);
+	put32(12, vk_format(image.format));
+	put32(16, 1);
+	put32(20, image.width);
+	put32(24, image.height);
+	put32(28, 0);
+	put32(32, 0);
+	put32(36, 1);
+	put32(40, static_cast<uint32_t>(level_count));
+	put32(44, 0);
+	put32(48, static_cast<uint32_t>(dfd_offset));
+	put32(52, static_cast<uint32_t>(dfd_size));
+	for (size_t level = 0; level < level_count; ++level)
+	{
+		const CompressedImage::Level& l = image.levels[level];
+		put64(KTX2_HEADER_SIZE + level * 24, level_offsets[level]);
+		put64(KTX2_HEADER_SIZE + level * 24 + 8, l.size);
+		put64(KTX2_HEADER_SIZE + level * 24 + 16, l.size);
+		memcpy(file.data() + level_offsets[level], image.data.data() + l.offset, l.size);
+	}
+	memcpy(file.data() + dfd_offset, dfd.data(), dfd_size);
+
+	// written to a temporary file first, so that concurrent loads never read a partial file
+	std::string temporary = filepath + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	{
+		std::ofstream out(temporary, std::ios_base::binary | std::ios_base::trunc);
+		if (!out.write(reinterpret_cast<const char*>(file.data()), file.size()))
+			return false;
+	}
+	std::error_code ec;
+	std::filesystem::rename(temporary, filepath, ec);
+	if (ec)
+		std::filesystem::remove(temporary, ec);
+	return true;
+}
+
+bool TextureCache::ReadKTX2(const std::string& filepath, CompressedImage& image)
+{
+	std::string file;
+	if (!IO::read_file(filepath.c_str(), file, std::ios_base::in | std::ios_base::binary) || file.size() < KTX2_HEADER_SIZE
+		|| memcmp(file.data(), KTX2_IDENTIFIER, 12) != 0)
+		return false;
+	auto get32 = [&file](size_t at) { uint32_t value; memcpy(&value, file.data() + at, 4); return value; };
+	auto get64 = [&file](size_t at) { uint64_t value; memcpy(&value, file.data() + at, 8); return value; };
+	CompressedImage read;
+	if (!format_of(get32(12), read.format) || get32(28) != 0 || get32(32) != 0 || get32(36) != 1 || get32(44) != 0)
+		return false;
+	read.width = static_cast<int>(get32(20));
+	read.height = static_cast<int>(get32(24));
+	if (read.width <= 0 || read.height <= 0)
+		return false;
+	// a full chain has floor(log2(max(width, height))) + 1 levels, and the level index must fit in the file
+	uint32_t level_count = std::max<uint32_t>(get32(40), 1);
+	uint32_t max_levels = static_cast<uint32_t>(std::bit_width(static_cast<uint32_t>(std::max(read.width, read.height))));
+	if (level_count > max_levels || KTX2_HEADER_SIZE + size_t(level_count) * 24 > file.size())
+		return false;
+	for (uint32_t level = 0; level < level_count; ++level)
+	{
+		int width = std::max(read.width >> level, 1), height = std::max(read.height >> level, 1);
+		uint64_t offset = get64(KTX2_HEADER_SIZE + level * 24), size = get64(KTX2_HEADER_SIZE + level * 24 + 8);
+		if (size != level_size(read.format, width, height) || offset > file.size() || size > file.size() - offset)
+			return false;
+		append_level(read, width, height, reinterpret_cast<const unsigned char*>(file.data()) + offset);
+	}
+	image = std::move(read);
+	return true;
+}
+
+// ---------- cache ----------
+
+static unsigned long long fnv1a(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+static unsigned long long cache_key(const std::string& source, const TileConstructArgs_filepath& args, const TextureSettings& settings)
+{
+	unsigned long long key = fnv1a(source.data(), source.size());
+	key = fnv1a(&args.svg_scale, sizeof(args.svg_scale), key);
+	key = fnv1a(&args.flip_vertically, sizeof(args.flip_vertically), key);
+	key = fnv1a(&args.premultiply_alpha, sizeof(args.premultiply_alpha), key);
+	// of the settings, only whether a mip chain is cooked changes the cooked data. Filtering and wrapping live in samplers.
+	bool mipmaps = settings.UsesMipmaps();
+	key = fnv1a(&mipmaps, sizeof(mipmaps), key);
+	return fnv1a(&COOKER_VERSION, sizeof(COOKER_VERSION), key);
+}
+
+bool TextureCache::Load(const TileConstructArgs_filepath& args, const TextureSettings& settings, CompressedImage& image)
+{
+	std::string source;
+	if (!IO::read_file(args.filepath.c_str(), source, std::ios_base::in | std::ios_base::binary))
+		return false;
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.ktx2", cache_key(source, args, settings));
+	std::filesystem::path path = std::filesystem::path(PulsarSettings::texture_cache_directory()) / name;
+	if (!ReadKTX2(path.string(), image))
+	{
+		Tile tile(args);
+		if (!Cook(tile, settings, image, PulsarSettings::texture_cache_min_psnr()))
+			return false;
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+		if (!WriteKTX2(path.string(), image))
+			Logger::LogWarning("Cannot write texture cache file \"" + path.string() + "\" for \"" + args.filepath + "\".");
+	}
+	if (image.format != CompressedFormat::RGBA8 && !SupportsBC())
+		ExpandToRGBA8(image);
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Texture.h"
+#include "Tile.h"
+
+enum class CompressedFormat : unsigned char
+{
+	RGBA8,
+	BC1,
+	BC3
+};
+
+// Pixels of every mip level in one buffer, level 0 first. Block-compressed levels are padded to whole 4x4 blocks.
+struct CompressedImage
+{
+	struct Level
+	{
+		size_t offset, size;
+		int width, height;
+	};
+
+	CompressedFormat format = CompressedFormat::RGBA8;
+	int width = 0, height = 0;
+	std::vector<unsigned char> data;
+	std::vector<Level> levels;
+
+	operator bool() const { return !levels.empty(); }
+};
+
+// Cache of textures cooked into block-compressed KTX2 files, keyed by the hash of their source file, the tile args and whether the settings use mipmaps.
+// Opaque images are cooked to BC1 and images with alpha to BC3, along with a box-filtered mip chain if the settings use a mipmap filter.
+// Images whose BCn round trip falls below the minimum PSNR, like most pixel art, are cached as RGBA8 instead, which still skips decoding.
+// The cooker only runs on the CPU. On contexts without S3TC, cached BCn images are expanded back to RGBA8 when loaded.
+namespace TextureCache {
+
+	// Must be called with the context current.
+	void Init();
+	bool Enabled();
+	bool SupportsBC();
+
+	// Loads the cached image of the tile's file, cooking and caching it first if needed. May be called from any thread.
+	bool Load(const TileConstructArgs_filepath& args, const TextureSettings& settings, CompressedImage& image);
+
+	bool Cook(const Tile& tile, const TextureSettings& settings, CompressedImage& image, float min_psnr);
+	void Decompress(const CompressedImage& image, size_t level, std::vector<unsigned char>& rgba);
+	void ExpandToRGBA8(CompressedImage& image);
+	double PSNR(const unsigned char* a, const unsigned char* b, size_t pixels, bool alpha);
+
+	bool WriteKTX2(const std::string& filepath, const CompressedImage& image);
+	bool ReadKTX2(const std::string& filepath, CompressedImage& image);
+
+	GLenum GLFormat(CompressedFormat format);
+
+}
@@ -5,18 +5,19 @@
 #include <nanosvg/nanosvgrast.h>
 
 #include "Logger.inl"
+#include "utils/PixelKernels.h"
 #include "utils/Strings.h"
 
-static void flip_vertically(unsigned char* buffer, int height, int stride)
+static void premultiply_alpha(unsigned char* buffer, int width, int height, int bpp)
 {
-	unsigned char* temp_row = new unsigned char[stride];
-	for (int i = 0; i < height / 2; i++)
+	size_t count = static_cast<size_t>(width) * height;
+	if (bpp == 4)
+		PixelKernels::Premultiply(buffer, count);
+	else if (bpp == 2)
 	{
-		memcpy_s(temp_row, stride, buffer + i * stride, stride);
-		memcpy_s(buffer + i * stride, stride, buffer + (height - 1 - i) * stride, stride);
-		memcpy_s(buffer + (height - 1 - i) * stride, stride, temp_row, stride);
+		for (size_t i = 0; i < count; ++i, buffer += 2)
+			buffer[0] = static_cast<unsigned char>((buffer[0] * buffer[1] + 127) / 255);
 	}
-	delete[] temp_row;
 }
 
 Tile::Tile(const TileConstructArgs_filepath& args)
@@ -40,7 +41,7 @@ Tile::Tile(const TileConstructArgs_filepath& args)
 			nsvgDelete(image);
 
 			if (args.flip_vertically)
-				flip_vertically(m_ImageBuffer, m_Height, m_Width * 4);
+				PixelKernels::FlipVertically(m_ImageBuffer, m_Height, static_cast<size_t>(m_Width) * 4);
 		}
 		else
 		{
@@ -56,7 +57,8 @@ Tile::Tile(const TileConstructArgs_filepath& args)
 	else
 	{
 		deletion_policy = TileDeletionPolicy::FROM_STBI;
-		stbi_set_flip_vertically_on_load(static_cast<int>(args.flip_vertically));
+		// thread-local, since tiles may be decoded on job workers
+		stbi_set_flip_vertically_on_load_thread(static_cast<int>(args.flip_vertically));
 		m_ImageBuffer = stbi_load(args.filepath.c_str(), &m_Width, &m_Height, &m_BPP, 0);
 		if (!m_ImageBuffer)
 		{
@@ -64,17 +66,27 @@ Tile::Tile(const TileConstructArgs_filepath& args)
 			return;
 		}
 	}
+	if (args.premultiply_alpha)
+		premultiply_alpha(m_ImageBuffer, m_Width, m_Height, m_BPP);
 }
 
 Tile::Tile(const TileConstructArgs_buffer& args)
 	: m_ImageBuffer(args.image_buffer), m_Width(args.width), m_Height(args.height), m_BPP(args.bpp), deletion_policy(args.deletion_policy)
 {
 	if (args.flip_vertically)
-		flip_vertically(m_ImageBuffer, m_Height, m_Width * m_BPP);
+		PixelKernels::FlipVertically(m_ImageBuffer, m_Height, static_cast<size_t>(m_Width) * m_BPP);
+}
+
+// Tiles never write to their buffer after construction, so the read-only mapping is safe to hold as one.
+Tile::Tile(std::unique_ptr<MappedFile>&& mapping, const unsigned char* pixels, int width, int height, int bpp)
+	: m_ImageBuffer(const_cast<unsigned char*>(pixels)), m_Width(width), m_Height(height), m_BPP(bpp), deletion_policy(TileDeletionPolicy::FROM_MAPPING),
+	m_Mapping(std::move(mapping))
+{
 }
 
 Tile::Tile(Tile&& tile) noexcept
-	: m_ImageBuffer(tile.m_ImageBuffer), m_Width(tile.m_Width), m_Height(tile.m_Height), m_BPP(tile.m_BPP), deletion_policy(tile.deletion_policy)
+	: m_ImageBuffer(tile.m_ImageBuffer), m_Width(tile.m_Width), m_Height(tile.m_Height), m_BPP(tile.m_BPP), deletion_policy(tile.deletion_policy),
+	m_Mapping(std::move(tile.m_Mapping))
 {
 	tile.m_ImageBuffer = nullptr;
 }
@@ -90,6 +102,7 @@ Tile& Tile::operator=(Tile&& tile) noexcept
 	m_Height = tile.m_Height;
 	m_BPP = tile.m_BPP;
 	deletion_policy = tile.deletion_policy;
+	m_Mapping = std::move(tile.m_Mapping);
 	tile.m_ImageBuffer = nullptr;
 	return *this;
 }
@@ -110,3 +123,58 @@ void Tile::DeleteBuffer() const
 	else if (deletion_policy == TileDeletionPolicy::FROM_NEW)
 		delete[] m_ImageBuffer;
 }
+
+Tile const* TileRegistry::Get(TileHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(handle);
+}
+
+Tile* TileRegistry::Get(TileHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Get(handle);
+}
+
+// If another thread registered the same file meanwhile, its tile is kept and this one dropped.
+TileHandle TileRegistry::GetHandle(const TileConstructArgs_filepath& args)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = lookup_1.find(args);
+		if (iter != lookup_1.end())
+			return iter->second;
+	}
+	Tile tile(args);
+	if (!tile)
+		return 0;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = lookup_1.find(args);
+	if (iter != lookup_1.end())
+		return iter->second;
+	if (current_handle == HANDLE_CAP)
+		throw RegistryFullException();
+	TileHandle handle = current_handle++;
+	registry.emplace(handle, std::move(tile));
+	lookup_1[args] = handle;
+	return handle;
+}
+
+// Buffers are adopted under the lock, so that a buffer is never owned by two tiles.
+TileHandle TileRegistry::GetHandle(const TileConstructArgs_buffer& args)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::GetHandle(args);
+}
+
+TileHandle TileRegistry::Register(Tile&& tile)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Register(std::move(tile));
+}
+
+bool TileRegistry::Destroy(TileHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return Base::Destroy(handle);
+}
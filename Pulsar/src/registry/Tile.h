@@ -1,9 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "Registry.inl"
 #include "Handles.inl"
+#include "IO.h"
+#include "PulsarSettings.h"
 
 struct TileRect
 {
@@ -14,7 +18,9 @@ enum class TileDeletionPolicy : unsigned char
 {
 	FROM_STBI,
 	FROM_NEW,
-	FROM_EXTERNAL
+	FROM_EXTERNAL,
+	// the buffer is read only and lives in a file mapping owned by the tile
+	FROM_MAPPING
 };
 
 struct TileConstructArgs_filepath
@@ -22,11 +28,15 @@ struct TileConstructArgs_filepath
 	std::string filepath;
 	float svg_scale = 1.0f;
 	bool flip_vertically = true;
+	// multiplies color by alpha once loaded, for images with alpha
+	bool premultiply_alpha = false;
 
-	TileConstructArgs_filepath(const std::string& filepath, float svg_scale = 1.0f, bool flip_vertically = true)
-		: filepath(filepath), svg_scale(svg_scale), flip_vertically(flip_vertically) {}
-	TileConstructArgs_filepath(std::string&& filepath, float svg_scale = 1.0f, bool flip_vertically = true)
-		: filepath(std::move(filepath)), svg_scale(svg_scale), flip_vertically(flip_vertically) {}
+	TileConstructArgs_filepath(const std::string& filepath, float svg_scale = 1.0f, bool flip_vertically = true,
+		bool premultiply_alpha = PulsarSettings::premultiplied_alpha())
+		: filepath(filepath), svg_scale(svg_scale), flip_vertically(flip_vertically), premultiply_alpha(premultiply_alpha) {}
+	TileConstructArgs_filepath(std::string&& filepath, float svg_scale = 1.0f, bool flip_vertically = true,
+		bool premultiply_alpha = PulsarSettings::premultiplied_alpha())
+		: filepath(std::move(filepath)), svg_scale(svg_scale), flip_vertically(flip_vertically), premultiply_alpha(premultiply_alpha) {}
 
 	bool operator==(const TileConstructArgs_filepath&) const = default;
 };
@@ -36,7 +46,8 @@ struct std::hash<TileConstructArgs_filepath>
 {
 	size_t operator()(const TileConstructArgs_filepath& args) const
 	{
-		return hash<std::string>{}(args.filepath) ^ (hash<float>{}(args.svg_scale) << 1) ^ (hash<bool>{}(args.flip_vertically) << 2);
+		return hash<std::string>{}(args.filepath) ^ (hash<float>{}(args.svg_scale) << 1) ^ (hash<bool>{}(args.flip_vertically) << 2)
+			^ (hash<bool>{}(args.premultiply_alpha) << 3);
 	}
 };
 
@@ -75,6 +86,7 @@ class Tile
 	unsigned char* m_ImageBuffer;
 	int m_Width, m_Height, m_BPP;
 	TileDeletionPolicy deletion_policy;
+	std::unique_ptr<MappedFile> m_Mapping;
 	
 	Tile() : m_Width(0), m_Height(0), m_BPP(0), deletion_policy(TileDeletionPolicy::FROM_EXTERNAL), m_ImageBuffer(nullptr) {}
 	void DeleteBuffer() const;
@@ -82,6 +94,8 @@ class Tile
 public:
 	Tile(const TileConstructArgs_filepath& args);
 	Tile(const TileConstructArgs_buffer& args);
+	// Uses pixels inside mapping in place, and keeps the mapping open until the tile is deleted.
+	Tile(std::unique_ptr<MappedFile>&& mapping, const unsigned char* pixels, int width, int height, int bpp);
 	Tile(const Tile&) = delete;
 	Tile(Tile&& tile) noexcept;
 	Tile& operator=(Tile&& tile) noexcept;
@@ -95,9 +109,22 @@ public:
 	int GetBPP() const { return m_BPP; }
 };
 
+// Locked like TextureRegistry, since the render thread reads and releases tiles while uploading and maintaining atlases,
+// while the main thread keeps registering them. Files are decoded outside the lock.
 class TileRegistry : public Registry<Tile, TileHandle, TileConstructArgs_filepath, TileConstructArgs_buffer>
 {
+	typedef Registry<Tile, TileHandle, TileConstructArgs_filepath, TileConstructArgs_buffer> Base;
+
+	mutable std::mutex mutex;
+
 public:
+	Tile const* Get(TileHandle handle) const;
+	Tile* Get(TileHandle handle);
+	TileHandle GetHandle(const TileConstructArgs_filepath& args);
+	TileHandle GetHandle(const TileConstructArgs_buffer& args);
+	TileHandle Register(Tile&& tile);
+	bool Destroy(TileHandle handle);
+
 	unsigned char const* GetImageBuffer(TileHandle tile) { Tile const* t = Get(tile); return t ? t->m_ImageBuffer : nullptr; }
 	int GetWidth(TileHandle tile) { Tile const* t = Get(tile); return t ? t->m_Width : 0; }
 	int GetHeight(TileHandle tile) { Tile const* t = Get(tile); return t ? t->m_Height : 0; }
@@ -96,55 +96,58 @@ bool UniformLexicon::Shares(UniformLexiconHandle lexicon_handle)
 void UniformLexicon::OnApply(ShaderHandle shader) const
 {
 	for (const auto& [name, uniform] : m_Uniforms)
+		ApplyUniform(shader, name.c_str(), uniform);
+}
+
+void UniformLexicon::ApplyUniform(ShaderHandle shader, const char* name, const Uniform& uniform)
+{
+	switch (uniform.index())
 	{
-		switch (uniform.index())
-		{
-		case 0:
-			Renderer::Shaders().SetUniform1i(shader, name.c_str(), std::get<GLint>(uniform));
-			break;
-		case 1:
-			Renderer::Shaders().SetUniform2iv(shader, name.c_str(), &std::get<glm::ivec2>(uniform)[0]);
-			break;
-		case 2:
-			Renderer::Shaders().SetUniform3iv(shader, name.c_str(), &std::get<glm::ivec3>(uniform)[0]);
-			break;
-		case 3:
-			Renderer::Shaders().SetUniform4iv(shader, name.c_str(), &std::get<glm::ivec4>(uniform)[0]);
-			break;
-		case 4:
-			Renderer::Shaders().SetUniform1ui(shader, name.c_str(), std::get<GLuint>(uniform));
-			break;
-		case 5:
-			Renderer::Shaders().SetUniform2uiv(shader, name.c_str(), &std::get<glm::uvec2>(uniform)[0]);
-			break;
-		case 6:
-			Renderer::Shaders().SetUniform3uiv(shader, name.c_str(), &std::get<glm::uvec3>(uniform)[0]);
-			break;
-		case 7:
-			Renderer::Shaders().SetUniform4uiv(shader, name.c_str(), &std::get<glm::uvec4>(uniform)[0]);
-			break;
-		case 8:
-			Renderer::Shaders().SetUniform1f(shader, name.c_str(), std::get<GLfloat>(uniform));
-			break;
-		case 9:
-			Renderer::Shaders().SetUniform2fv(shader, name.c_str(), &std::get<glm::vec2>(uniform)[0]);
-			break;
-		case 10:
-			Renderer::Shaders().SetUniform3fv(shader, name.c_str(), &std::get<glm::vec3>(uniform)[0]);
-			break;
-		case 11:
-			Renderer::Shaders().SetUniform4fv(shader, name.c_str(), &std::get<glm::vec4>(uniform)[0]);
-			break;
-		case 12:
-			Renderer::Shaders().SetUniformMatrix2fv(shader, name.c_str(), &std::get<glm::mat2>(uniform)[0][0]);
-			break;
-		case 13:
-			Renderer::Shaders().SetUniformMatrix3fv(shader, name.c_str(), &std::get<glm::mat3>(uniform)[0][0]);
-			break;
-		case 14:
-			Renderer::Shaders().SetUniformMatrix4fv(shader, name.c_str(), &std::get<glm::mat4>(uniform)[0][0]);
-			break;
-		}
+	case 0:
+		Renderer::Shaders().SetUniform1i(shader, name, std::get<GLint>(uniform));
+		break;
+	case 1:
+		Renderer::Shaders().SetUniform2iv(shader, name, &std::get<glm::ivec2>(uniform)[0]);
+		break;
+	case 2:
+		Renderer::Shaders().SetUniform3iv(shader, name, &std::get<glm::ivec3>(uniform)[0]);
+		break;
+	case 3:
+		Renderer::Shaders().SetUniform4iv(shader, name, &std::get<glm::ivec4>(uniform)[0]);
+		break;
+	case 4:
+		Renderer::Shaders().SetUniform1ui(shader, name, std::get<GLuint>(uniform));
+		break;
+	case 5:
+		Renderer::Shaders().SetUniform2uiv(shader, name, &std::get<glm::uvec2>(uniform)[0]);
+		break;
+	case 6:
+		Renderer::Shaders().SetUniform3uiv(shader, name, &std::get<glm::uvec3>(uniform)[0]);
+		break;
+	case 7:
+		Renderer::Shaders().SetUniform4uiv(shader, name, &std::get<glm::uvec4>(uniform)[0]);
+		break;
+	case 8:
+		Renderer::Shaders().SetUniform1f(shader, name, std::get<GLfloat>(uniform));
+		break;
+	case 9:
+		Renderer::Shaders().SetUniform2fv(shader, name, &std::get<glm::vec2>(uniform)[0]);
+		break;
+	case 10:
+		Renderer::Shaders().SetUniform3fv(shader, name, &std::get<glm::vec3>(uniform)[0]);
+		break;
+	case 11:
+		Renderer::Shaders().SetUniform4fv(shader, name, &std::get<glm::vec4>(uniform)[0]);
+		break;
+	case 12:
+		Renderer::Shaders().SetUniformMatrix2fv(shader, name, &std::get<glm::mat2>(uniform)[0][0]);
+		break;
+	case 13:
+		Renderer::Shaders().SetUniformMatrix3fv(shader, name, &std::get<glm::mat3>(uniform)[0][0]);
+		break;
+	case 14:
+		Renderer::Shaders().SetUniformMatrix4fv(shader, name, &std::get<glm::mat4>(uniform)[0][0]);
+		break;
 	}
 }
 
@@ -70,6 +70,7 @@ public:
 	bool Shares(const UniformLexicon& lexicon);
 	bool Shares(UniformLexiconHandle lexicon_handle);
 	void OnApply(ShaderHandle shader) const;
+	static void ApplyUniform(ShaderHandle shader, const char* name, const Uniform& uniform);
 
 private:
 	Uniform const* GetValue(const std::string& name) const;
@@ -1,16 +1,24 @@
 #include "Atlas.h"
 
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <queue>
 #include <vector>
 
+#include "JobSystem.h"
+#include "Logger.inl"
 #include "Macros.h"
 #include "render/actors/RectRender.h"
 #include "render/actors/ActorTesselation.h"
+#include "utils/PixelKernels.h"
 
-Atlas::Atlas(std::vector<TileHandle>& tiles, int width, int height, int border)
+Atlas::Atlas(std::vector<TileHandle>& tiles, int width, int height, int border, AtlasPacking packing, bool allow_rotation)
 	: m_Border(border)
 {
-	RectPack(tiles, width, height);
+	RectPack(tiles, width, height, packing, allow_rotation);
 	unsigned char* image_buffer = new unsigned char[Atlas::BPP * width * height](0);
 	PlaceTiles(image_buffer, width);
 	Tile tile(TileConstructArgs_buffer(image_buffer, width, height, Atlas::BPP, TileDeletionPolicy::FROM_NEW));
@@ -31,11 +39,18 @@ Atlas::Atlas(const std::string& texture_filepath, std::vector<Placement>&& place
 	m_Tile = Renderer::Tiles().GetHandle({ texture_filepath });
 }
 
-static int min_bound(const std::vector<TileHandle>& tiles, const int& border)
+Atlas::Atlas(TileHandle tile, std::vector<Placement>&& placements, int border)
+	: m_Tile(tile), m_Placements(std::move(placements)), m_Border(border)
 {
-	int bound = border;
-	for (const TileHandle& tile : tiles)
-		bound += std::max(Renderer::Tiles().GetWidth(tile), Renderer::Tiles().GetHeight(tile)) + border;
+	if (m_Tile == 0)
+		throw null_handle_error();
+}
+
+static int min_bound(const std::vector<Placement>& rects)
+{
+	int bound = 0;
+	for (const Placement& rect : rects)
+		bound += std::max(rect.w, rect.h);
 	return bound;
 }
 
@@ -43,7 +58,7 @@ struct Subsection
 {
 	int x, y, w, h, rw = 0, rh = 0;
 
-	Placement insert(TileHandle tile, int rect_w, int rect_h)
+	Placement insert(TileHandle tile, int rect_w, int rect_h, bool allow_rotation)
 	{
 		if (rect_w <= w && rect_h <= h)
 		{
@@ -51,7 +66,7 @@ struct Subsection
 			rh = rect_h;
 			return { tile, x, y, rw, rh, false };
 		}
-		else if (rect_h <= w && rect_w <= h)
+		else if (allow_rotation && rect_h <= w && rect_w <= h)
 		{
 			rw = rect_h;
 			rh = rect_w;
@@ -135,29 +150,17 @@ struct Subsection
 
 };
 
-void Atlas::RectPack(std::vector<TileHandle>& tiles, int width, int height)
+// The original packer. Splits the largest free subsection around each rect, and merges all subsections after every placement.
+static void pack_guillotine(std::vector<Placement>& rects, int width, int height, bool allow_rotation)
 {
-	int bound = min_bound(tiles, m_Border);
-	if (width <= 0)
-		width = bound;
-	if (height <= 0)
-		height = bound;
-
-	std::sort(tiles.begin(), tiles.end(), [](const TileHandle& a, const TileHandle& b)
-	{
-		return std::max(Renderer::Tiles().GetWidth(a), Renderer::Tiles().GetHeight(a))
-				> std::max(Renderer::Tiles().GetWidth(b), Renderer::Tiles().GetHeight(b));
-	});
-
-	m_Placements.reserve(tiles.size());
 	Subsection root{ 0, 0, width, height };
 	auto comparator = [](const Subsection& l, const Subsection& r) { return std::max(l.w, l.h) < std::max(r.w, r.h); };
 	std::priority_queue<Subsection, std::vector<Subsection>, decltype(comparator)> subsections(comparator);
 	subsections.push(root);
 	std::vector<Subsection> tried_subsections;
-	tried_subsections.reserve(tiles.size() + 1);
+	tried_subsections.reserve(rects.size() + 1);
 
-	for (const TileHandle& tile : tiles)
+	for (Placement& rect : rects)
 	{
 		tried_subsections.clear();
 		bool fits = false;
@@ -165,10 +168,10 @@ void Atlas::RectPack(std::vector<TileHandle>& tiles, int width, int height)
 		{
 			Subsection subsection = subsections.top();
 			subsections.pop();
-			Placement result = subsection.insert(tile, Renderer::Tiles().GetWidth(tile) + m_Border, Renderer::Tiles().GetHeight(tile) + m_Border);
-			if (result.tile > 0)
+			Placement result = subsection.insert(rect.tile, rect.w, rect.h, allow_rotation);
+			if (result.w > 0)
 			{
-				m_Placements.push_back(result);
+				rect = result;
 				auto split = subsection.split();
 				if (split.first.x >= 0)
 				{
@@ -202,45 +205,366 @@ void Atlas::RectPack(std::vector<TileHandle>& tiles, int width, int height)
 		for (const auto& subsection : tried_subsections)
 			subsections.push(subsection);
 		if (!fits)
-			m_Placements.push_back({0, -1, -1, -1, -1, false});
+			rect.x = rect.y = -1;
 	}
 }
 
-void Atlas::PlaceTiles(unsigned char* image_buffer, int atlas_width)
+static bool contains(const TileRect& outer, const TileRect& inner)
 {
-	for (const Placement& placement : m_Placements)
+	return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.w <= outer.x + outer.w && inner.y + inner.h <= outer.y + outer.h;
+}
+
+// MaxRects with the best short side fit heuristic. Free rects are maximal and may overlap. Placing a rect splits every free rect it overlaps
+// into the up to 4 maximal rects around it. Only the split rects can be contained in another free rect, so only they are pruned.
+static void pack_maxrects(std::vector<Placement>& rects, int width, int height, bool allow_rotation)
+{
+	std::vector<TileRect> free_rects{ { 0, 0, width, height } };
+	std::vector<TileRect> split_rects;
+	for (Placement& rect : rects)
 	{
-		if (placement.tile == 0)
-			continue;
-		unsigned char const* p_buffer = Renderer::Tiles().GetImageBuffer(placement.tile);
-		if (!p_buffer)
-			continue;
-		const auto p_width = placement.w - m_Border;
-		const auto p_height = placement.h - m_Border;
-		const auto p_bpp = Renderer::Tiles().GetBPP(placement.tile);
-		for (int h = 0; h < p_height; h++)
+		int best_short = INT_MAX, best_long = INT_MAX;
+		TileRect best{ -1, -1, 0, 0 };
+		bool rotated = false;
+		for (const TileRect& free : free_rects)
 		{
-			for (int w = 0; w < p_width; w++)
+			for (int orientation = 0; orientation < (allow_rotation ? 2 : 1); ++orientation)
 			{
-				for (unsigned char c = 0; c < p_bpp && c < Atlas::BPP; c++)
+				int w = orientation ? rect.h : rect.w;
+				int h = orientation ? rect.w : rect.h;
+				if (w > free.w || h > free.h)
+					continue;
+				int leftover_w = free.w - w, leftover_h = free.h - h;
+				int short_fit = std::min(leftover_w, leftover_h), long_fit = std::max(leftover_w, leftover_h);
+				if (short_fit < best_short || (short_fit == best_short && long_fit < best_long))
 				{
-					if (placement.r)
-						image_buffer[(placement.x + m_Border + h + (placement.y + m_Border + w) * atlas_width) * Atlas::BPP + c]
-							= p_buffer[(w + h * p_height) * p_bpp + c];
-					else
-						image_buffer[(placement.x + m_Border + w + (placement.y + m_Border + h) * atlas_width) * Atlas::BPP + c]
-							= p_buffer[(w + h * p_width) * p_bpp + c];
+					best_short = short_fit;
+					best_long = long_fit;
+					best = { free.x, free.y, w, h };
+					rotated = orientation == 1;
 				}
-				for (unsigned char c = p_bpp; c < Atlas::BPP; c++)
+			}
+		}
+		if (best.x < 0)
+		{
+			rect.x = rect.y = -1;
+			continue;
+		}
+		rect = { rect.tile, best.x, best.y, best.w, best.h, rotated };
+
+		split_rects.clear();
+		for (size_t i = 0; i < free_rects.size(); )
+		{
+			const TileRect free = free_rects[i];
+			if (best.x >= free.x + free.w || best.x + best.w <= free.x || best.y >= free.y + free.h || best.y + best.h <= free.y)
+			{
+				++i;
+				continue;
+			}
+			if (best.x > free.x)
+				split_rects.push_back({ free.x, free.y, best.x - free.x, free.h });
+			if (best.x + best.w < free.x + free.w)
+				split_rects.push_back({ best.x + best.w, free.y, free.x + free.w - best.x - best.w, free.h });
+			if (best.y > free.y)
+				split_rects.push_back({ free.x, free.y, free.w, best.y - free.y });
+			if (best.y + best.h < free.y + free.h)
+				split_rects.push_back({ free.x, best.y + best.h, free.w, free.y + free.h - best.y - best.h });
+			free_rects[i] = free_rects.back();
+			free_rects.pop_back();
+		}
+		for (size_t i = 0; i < split_rects.size(); ++i)
+		{
+			bool redundant = std::any_of(free_rects.begin(), free_rects.end(), [&](const TileRect& free) { return contains(free, split_rects[i]); });
+			for (size_t j = 0; j < split_rects.size() && !redundant; ++j)
+				redundant = j != i && contains(split_rects[j], split_rects[i]) && (j < i || !contains(split_rects[i], split_rects[j]));
+			if (!redundant)
+				free_rects.push_back(split_rects[i]);
+		}
+	}
+}
+
+// Skyline with the bottom left heuristic. The skyline is a list of segments left to right, and rects are placed on it where their top is lowest.
+// Space below the skyline that a placement covers over is lost.
+static void pack_skyline(std::vector<Placement>& rects, int width, int height, bool allow_rotation)
+{
+	struct Segment
+	{
+		int x, y, w;
+	};
+	std::vector<Segment> skyline{ { 0, 0, width } };
+
+	// the y at which a rect of width w rests when its left edge is at segment i, or -1 if it does not fit there
+	auto fit = [&](size_t i, int w, int h) {
+		if (skyline[i].x + w > width)
+			return -1;
+		int y = skyline[i].y;
+		for (int left = w; left > 0; ++i)
+		{
+			y = std::max(y, skyline[i].y);
+			if (y + h > height)
+				return -1;
+			left -= skyline[i].w;
+		}
+		return y;
+	};
+
+	for (Placement& rect : rects)
+	{
+		int best_top = INT_MAX, best_segment_w = INT_MAX;
+		size_t best_i = 0;
+		TileRect best{ -1, -1, 0, 0 };
+		bool rotated = false;
+		for (size_t i = 0; i < skyline.size(); ++i)
+		{
+			for (int orientation = 0; orientation < (allow_rotation ? 2 : 1); ++orientation)
+			{
+				int w = orientation ? rect.h : rect.w;
+				int h = orientation ? rect.w : rect.h;
+				int y = fit(i, w, h);
+				if (y < 0)
+					continue;
+				if (y + h < best_top || (y + h == best_top && skyline[i].w < best_segment_w))
 				{
-					if (placement.r)
-						image_buffer[(placement.x + m_Border + h + (placement.y + m_Border + w) * atlas_width) * Atlas::BPP + c] = 255;
-					else
-						image_buffer[(placement.x + m_Border + w + (placement.y + m_Border + h) * atlas_width) * Atlas::BPP + c] = 255;
+					best_top = y + h;
+					best_segment_w = skyline[i].w;
+					best_i = i;
+					best = { skyline[i].x, y, w, h };
+					rotated = orientation == 1;
 				}
 			}
 		}
+		if (best.x < 0)
+		{
+			rect.x = rect.y = -1;
+			continue;
+		}
+		rect = { rect.tile, best.x, best.y, best.w, best.h, rotated };
+
+		skyline.insert(skyline.begin() + best_i, { best.x, best.y + best.h, best.w });
+		for (size_t i = best_i + 1; i < skyline.size(); )
+		{
+			int covered = skyline[i - 1].x + skyline[i - 1].w - skyline[i].x;
+			if (covered <= 0)
+				break;
+			if (covered < skyline[i].w)
+			{
+				skyline[i].x += covered;
+				skyline[i].w -= covered;
+				break;
+			}
+			skyline.erase(skyline.begin() + i);
+		}
+		for (size_t i = 0; i + 1 < skyline.size(); )
+		{
+			if (skyline[i].y == skyline[i + 1].y)
+			{
+				skyline[i].w += skyline[i + 1].w;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+				++i;
+		}
+	}
+}
+
+// A width or height of 0 or less is sized to fit, starting from the rects' total area.
+AtlasPackStats Atlas::PackRects(std::vector<Placement>& rects, int& width, int& height, AtlasPacking packing, bool allow_rotation)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Placement> sizes = rects;
+	bool fit_width = width <= 0, fit_height = height <= 0;
+	size_t area = 0;
+	int largest = 0;
+	for (const Placement& rect : rects)
+	{
+		area += static_cast<size_t>(rect.w) * rect.h;
+		largest = std::max({ largest, rect.w, rect.h });
+	}
+	int bound = std::max(min_bound(rects), 1);
+	double estimate = fit_width && fit_height ? std::sqrt(static_cast<double>(area)) : static_cast<double>(area) / (fit_width ? height : width);
+	int side = std::min(std::max(largest, static_cast<int>(std::ceil(estimate))), bound);
+
+	int packed_side = 0;
+	auto pack = [&](int s) {
+		packed_side = s;
+		if (fit_width)
+			width = s;
+		if (fit_height)
+			height = s;
+		rects = sizes;
+		switch (packing)
+		{
+		case AtlasPacking::Guillotine:
+			pack_guillotine(rects, width, height, allow_rotation);
+			break;
+		case AtlasPacking::MaxRects:
+			pack_maxrects(rects, width, height, allow_rotation);
+			break;
+		case AtlasPacking::Skyline:
+			pack_skyline(rects, width, height, allow_rotation);
+			break;
+		}
+		return static_cast<size_t>(std::count_if(rects.begin(), rects.end(), [](const Placement& rect) { return rect.x < 0; }));
+	};
+
+	AtlasPackStats stats;
+	stats.failed = pack(side);
+	if ((fit_width || fit_height) && stats.failed > 0)
+	{
+		// grows the fitted sides until every rect fits, then bisects them down to within 1/64
+		int lo = side, hi = side;
+		while (stats.failed > 0 && hi < bound)
+		{
+			lo = hi;
+			hi = std::min(bound, hi + std::max(1, hi / 8));
+			stats.failed = pack(hi);
+		}
+		while (stats.failed == 0 && hi - lo > std::max(1, hi / 64))
+		{
+			int mid = lo + (hi - lo) / 2;
+			if (pack(mid) == 0)
+				hi = mid;
+			else
+				lo = mid;
+		}
+		if (packed_side != hi)
+			stats.failed = pack(hi);
+	}
+
+	stats.placed = rects.size() - stats.failed;
+	size_t used = 0;
+	for (const Placement& rect : rects)
+	{
+		if (rect.x >= 0)
+			used += static_cast<size_t>(rect.w) * rect.h;
+	}
+	stats.occupancy = width > 0 && height > 0 ? static_cast<float>(used) / (static_cast<float>(width) * height) : 0.0f;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+void Atlas::RectPack(std::vector<TileHandle>& tiles, int& width, int& height, AtlasPacking packing, bool allow_rotation)
+{
+	std::vector<Placement> rects;
+	rects.reserve(tiles.size());
+	for (TileHandle tile : tiles)
+		rects.push_back({ tile, 0, 0, Renderer::Tiles().GetWidth(tile) + m_Border, Renderer::Tiles().GetHeight(tile) + m_Border, false });
+	std::stable_sort(rects.begin(), rects.end(), [](const Placement& a, const Placement& b) { return std::max(a.w, a.h) > std::max(b.w, b.h); });
+	for (size_t i = 0; i < rects.size(); ++i)
+		tiles[i] = rects[i].tile;
+
+	m_PackStats = PackRects(rects, width, height, packing, allow_rotation);
+	m_Placements.clear();
+	m_Placements.reserve(rects.size());
+	for (const Placement& rect : rects)
+	{
+		if (rect.x >= 0)
+			m_Placements.push_back(rect);
+		else
+			m_Placements.push_back({ 0, -1, -1, -1, -1, false });
+	}
+#if PULSAR_RUN_BENCHMARKS
+	Logger::LogFormat(Logger::Level::INFO, "Packed atlas of {} tiles: {} failed, {} occupancy, {} ms.", tiles.size(), m_PackStats.failed,
+		m_PackStats.occupancy, m_PackStats.milliseconds);
+#endif
+}
+
+// Expands a row of texels to RGBA. Grey is replicated into RGB, and missing alpha is opaque.
+static void expand_row(const unsigned char* src, int bpp, unsigned char* dst, int count)
+{
+	switch (bpp)
+	{
+	case 4:
+		memcpy(dst, src, static_cast<size_t>(count) * Atlas::BPP);
+		break;
+	case 3:
+		PixelKernels::RGBToRGBA(src, dst, count);
+		break;
+	case 2:
+		PixelKernels::GreyAlphaToRGBA(src, dst, count);
+		break;
+	case 1:
+		PixelKernels::GreyToRGBA(src, dst, count);
+		break;
+	}
+}
+
+// Square blocks of this many texels are transposed at a time, so that the rows read and the columns written both stay in cache.
+static constexpr int TRANSPOSE_BLOCK = 32;
+
+// Rotated tiles are stored transposed: texel (x, y) of the tile lands at (y, x) of its placement.
+void Atlas::BlitTile(const unsigned char* pixels, int width, int height, int bpp, bool rotated, unsigned char* atlas, int atlas_width, int x, int y)
+{
+	if (bpp < 1 || bpp > 4)
+		return;
+	const size_t stride = static_cast<size_t>(atlas_width) * Atlas::BPP;
+	unsigned char* origin = atlas + y * stride + static_cast<size_t>(x) * Atlas::BPP;
+	if (!rotated)
+	{
+		for (int row = 0; row < height; ++row)
+			expand_row(pixels + static_cast<size_t>(row) * width * bpp, bpp, origin + row * stride, width);
+		return;
+	}
+	unsigned char block[TRANSPOSE_BLOCK * TRANSPOSE_BLOCK * Atlas::BPP];
+	for (int by = 0; by < height; by += TRANSPOSE_BLOCK)
+	{
+		int block_h = std::min(TRANSPOSE_BLOCK, height - by);
+		for (int bx = 0; bx < width; bx += TRANSPOSE_BLOCK)
+		{
+			int block_w = std::min(TRANSPOSE_BLOCK, width - bx);
+			for (int row = 0; row < block_h; ++row)
+				expand_row(pixels + (static_cast<size_t>(by + row) * width + bx) * bpp, bpp, block + row * TRANSPOSE_BLOCK * Atlas::BPP, block_w);
+			// column col of the block becomes row bx + col of the placement
+			for (int col = 0; col < block_w; ++col)
+			{
+				uint32_t* dst = reinterpret_cast<uint32_t*>(origin + (bx + col) * stride) + by;
+				const unsigned char* src = block + col * Atlas::BPP;
+				for (int row = 0; row < block_h; ++row, src += TRANSPOSE_BLOCK * Atlas::BPP)
+					memcpy(dst + row, src, Atlas::BPP);
+			}
+		}
+	}
+}
+
+// Placements never overlap, so tiles are placed in parallel. Tiles are looked up first, since the tile registry is not safe to read concurrently with writes.
+void Atlas::PlaceTiles(unsigned char* image_buffer, int atlas_width)
+{
+	struct Source
+	{
+		const unsigned char* pixels;
+		int width, height, bpp;
+	};
+	std::vector<Source> sources(m_Placements.size(), { nullptr, 0, 0, 0 });
+	for (size_t i = 0; i < m_Placements.size(); ++i)
+	{
+		const Placement& placement = m_Placements[i];
+		if (placement.tile == 0)
+			continue;
+		Tile const* tile = Renderer::Tiles().Get(placement.tile);
+		if (tile && tile->GetImageBuffer())
+			sources[i] = { tile->GetImageBuffer(), tile->GetWidth(), tile->GetHeight(), tile->GetBPP() };
 	}
+	JobSystem::ParallelFor(m_Placements.size(), 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const Placement& placement = m_Placements[i];
+			const Source& source = sources[i];
+			if (!source.pixels)
+				continue;
+			// tiles loaded with placements from file are clipped to their placement
+			int width = std::min(source.width, (placement.r ? placement.h : placement.w) - m_Border);
+			int height = std::min(source.height, (placement.r ? placement.w : placement.h) - m_Border);
+			if (width <= 0 || height <= 0)
+				continue;
+			if (width == source.width)
+				BlitTile(source.pixels, width, height, source.bpp, placement.r, image_buffer, atlas_width, placement.x + m_Border, placement.y + m_Border);
+			else
+			{
+				for (int row = 0; row < height; ++row)
+					BlitTile(source.pixels + static_cast<size_t>(row) * source.width * source.bpp, width, 1, source.bpp, placement.r, image_buffer, atlas_width,
+						placement.x + m_Border + (placement.r ? row : 0), placement.y + m_Border + (placement.r ? 0 : row));
+			}
+		}
+	});
 }
 
 RectRender Atlas::SampleSubtile(size_t index, const TextureSettings& texture_settings, TextureVersion texture_version,
@@ -253,14 +577,19 @@ RectRender Atlas::SampleSubtile(size_t index, const TextureSettings& texture_set
 	const Placement& rect = m_Placements[index];
 	int width = Renderer::Tiles().GetWidth(m_Tile);
 	int height = Renderer::Tiles().GetHeight(m_Tile);
+	float x0 = static_cast<float>(rect.x + m_Border), y0 = static_cast<float>(rect.y + m_Border);
+	float x1 = static_cast<float>(rect.x + rect.w), y1 = static_cast<float>(rect.y + rect.h);
+	// rotated tiles are stored transposed, so their corners swap axes
 	if (rect.r)
-		actor.CropToRect({ rect.x + m_Border, rect.y + m_Border, rect.h - m_Border, rect.w - m_Border }, width, height);
+		actor.CropPoints({ { x0, y0 }, { x0, y1 }, { x1, y1 }, { x1, y0 } }, width, height);
 	else
-		actor.CropToRect({ rect.x + m_Border, rect.y + m_Border, rect.w - m_Border, rect.h - m_Border }, width, height);
+		actor.CropToRect({ x0, y0, rect.w - m_Border, rect.h - m_Border }, width, height);
 	actor.SetPivot(0.5, 0.5);
 	if (actor.Fickler().transformable)
 	{
-		*actor.Fickler().Scale() = { (rect.w - m_Border) / static_cast<float>(width), (rect.h - m_Border) / static_cast<float>(height) };
+		int tile_w = (rect.r ? rect.h : rect.w) - m_Border;
+		int tile_h = (rect.r ? rect.w : rect.h) - m_Border;
+		*actor.Fickler().Scale() = { tile_w / static_cast<float>(width), tile_h / static_cast<float>(height) };
 		actor.Fickler().SyncRS();
 	}
 	return actor;
@@ -15,6 +15,27 @@ struct Placement
 	bool operator==(const Placement&) const = default;
 };
 
+enum class AtlasPacking : unsigned char
+{
+	// splits free subsections like a guillotine, and merges them after every placement. Slow for many tiles.
+	Guillotine,
+	// maximal free rects, placing where the shorter leftover side is smallest
+	MaxRects,
+	// bottom left on a skyline. The fastest, but loses the space under overhangs.
+	Skyline
+};
+
+struct AtlasPackStats
+{
+	size_t placed = 0;
+	size_t failed = 0;
+	// fraction of the atlas covered by placed tiles and their borders
+	float occupancy = 0.0f;
+	double milliseconds = 0.0;
+
+	bool operator==(const AtlasPackStats&) const = default;
+};
+
 class null_pointer_error : public std::exception
 {
 };
@@ -30,14 +51,18 @@ class Atlas
 	TileHandle m_Tile;
 	int m_Border;
 	std::vector<Placement> m_Placements;
+	AtlasPackStats m_PackStats;
 
 public:
 	static constexpr unsigned char BPP = 4;
 	static constexpr unsigned char STRIDE_BYTES = sizeof(unsigned char) * BPP;
 
-	Atlas(std::vector<TileHandle>& tiles, int width = -1, int height = -1, int border = 0);
+	// tiles are sorted into the order of the placements. A width or height of 0 or less is sized to fit.
+	// The defaults pack like atlases always have, so saved and cached atlases keep their layout. MaxRects with rotation usually packs tighter.
+	Atlas(std::vector<TileHandle>& tiles, int width = -1, int height = -1, int border = 0, AtlasPacking packing = AtlasPacking::Guillotine, bool allow_rotation = false);
 	Atlas(const std::string& texture_filepath, const std::vector<Placement>& placements, int border);
 	Atlas(const std::string& texture_filepath, std::vector<Placement>&& placements, int border);
+	Atlas(TileHandle tile, std::vector<Placement>&& placements, int border);
 	Atlas(const Atlas&) = delete;
 	Atlas(Atlas&&) noexcept = default;
 	Atlas& operator=(Atlas&&) noexcept = default;
@@ -46,6 +71,7 @@ public:
 
 	int GetBorder() const { return m_Border; }
 	const std::vector<Placement>& GetPlacements() const { return m_Placements; }
+	const AtlasPackStats& GetPackStats() const { return m_PackStats; }
 	unsigned char const* GetBuffer() const { return Renderer::Tiles().GetImageBuffer(m_Tile); }
 	
 	class RectRender SampleSubtile(size_t index, const struct TextureSettings& texture_settings = Texture::nearest_settings,
@@ -55,7 +81,12 @@ public:
 	int GetWidth() const { return Renderer::Tiles().GetWidth(m_Tile); }
 	int GetHeight() const { return Renderer::Tiles().GetHeight(m_Tile); }
 
+	// Packs rects of w x h, in their order, and sets their x, y and r. Rotated rects have w and h swapped. Rects that do not fit get an x and y of -1.
+	static AtlasPackStats PackRects(std::vector<Placement>& rects, int& width, int& height, AtlasPacking packing, bool allow_rotation = true);
+	// Copies a width x height tile of 1 to 4 bytes per texel to (x, y) of an RGBA atlas, transposed if rotated.
+	static void BlitTile(const unsigned char* pixels, int width, int height, int bpp, bool rotated, unsigned char* atlas, int atlas_width, int x, int y);
+
 private:
-	void RectPack(std::vector<TileHandle>& tiles, int width = -1, int height = -1);
+	void RectPack(std::vector<TileHandle>& tiles, int& width, int& height, AtlasPacking packing, bool allow_rotation);
 	void PlaceTiles(unsigned char* image_buffer, int atlas_width);
 };
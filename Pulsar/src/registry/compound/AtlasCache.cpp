@@ -0,0 +1,196 @@
+#include "AtlasCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include "IO.h"
+#include "PulsarSettings.h"
+#include "utils/LZ4.h"
+
+static constexpr unsigned char ATLAS_CACHE_MAGIC[8] = { 'P', 'L', 'S', 'R', 'A', 'T', 'L', 'S' };
+static constexpr uint32_t ATLAS_CACHE_VERSION = 1;
+static constexpr uint32_t ATLAS_CACHE_LZ4 = 1;
+static constexpr uint32_t ATLAS_CACHE_PREMULTIPLIED = 2;
+static constexpr size_t ATLAS_CACHE_HEADER_SIZE = 64;
+static constexpr size_t ATLAS_CACHE_PLACEMENT_SIZE = 20;
+// of the pixel payload in the file, so that uncompressed pixels can be read from the mapping with aligned loads
+static constexpr size_t ATLAS_CACHE_PIXEL_ALIGNMENT = 16;
+
+// Header, all little-endian:
+//  0 magic             8 bytes
+//  8 version           u32
+// 12 flags             u32
+// 16 width, height, bpp, border  i32 each
+// 32 placement count   u32
+// 36 image path length u32
+// 40 source hash       u64
+// 48 pixel offset      u64
+// 56 pixel size        u64, as stored
+// followed by the placements as x, y, w, h and r, 20 bytes each, the image path, and the pixels.
+
+static size_t align_up(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// FNV-1a over 8 byte words, which keeps hashing well below the cost of decoding the image.
+static unsigned long long hash_words(const unsigned char* data, size_t size, unsigned long long hash)
+{
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	return (hash ^ size) * 1099511628211ull;
+}
+
+std::string AtlasCache::PathOf(const std::string& asset_filepath)
+{
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.atlas", hash_words(reinterpret_cast<const unsigned char*>(asset_filepath.data()), asset_filepath.size(), 14695981039346656037ull));
+	return (std::filesystem::path(PulsarSettings::atlas_cache_directory()) / name).string();
+}
+
+bool AtlasCache::SourceHash(const char* asset_filepath, const char* texture_filepath, unsigned long long& hash)
+{
+	MappedFile asset(asset_filepath);
+	MappedFile texture(texture_filepath);
+	if (!asset || !texture)
+		return false;
+	hash = hash_words(asset.GetData(), asset.GetSize(), 14695981039346656037ull);
+	hash = hash_words(texture.GetData(), texture.GetSize(), hash);
+	return true;
+}
+
+bool AtlasCache::Write(const std::string& filepath, const AtlasCacheEntry& entry, const unsigned char* pixels, bool compress)
+{
+	size_t raw_size = static_cast<size_t>(entry.width) * entry.height * entry.bpp;
+	size_t pixel_offset = align_up(ATLAS_CACHE_HEADER_SIZE + entry.placements.size() * ATLAS_CACHE_PLACEMENT_SIZE + entry.texture_filepath.size(),
+		ATLAS_CACHE_PIXEL_ALIGNMENT);
+	std::vector<unsigned char> file(pixel_offset + (compress ? LZ4::Bound(raw_size) : raw_size), 0);
+	size_t pixel_size = raw_size;
+	if (compress)
+	{
+		pixel_size = LZ4::Compress(pixels, raw_size, file.data() + pixel_offset, file.size() - pixel_offset);
+		// incompressible pixels are stored as they are
+		if (pixel_size == 0 || pixel_size >= raw_size)
+			compress = false;
+	}
+	if (!compress)
+	{
+		pixel_size = raw_size;
+		memcpy(file.data() + pixel_offset, pixels, raw_size);
+	}
+	file.resize(pixel_offset + pixel_size);
+
+	auto put32 = [&file](size_t at, uint32_t value) { memcpy(file.data() + at, &value, 4); };
+	auto put64 = [&file](size_t at, uint64_t value) { memcpy(file.data() + at, &value, 8); };
+	memcpy(file.data(), ATLAS_CACHE_MAGIC, 8);
+	put32(8, ATLAS_CACHE_VERSION);
+	put32(12, (compress ? ATLAS_CACHE_LZ4 : 0) | (entry.premultiplied ? ATLAS_CACHE_PREMULTIPLIED : 0));
+	put32(16, entry.width);
+	put32(20, entry.height);
+	put32(24, entry.bpp);
+	put32(28, entry.border);
+	put32(32, static_cast<uint32_t>(entry.placements.size()));
+	put32(36, static_cast<uint32_t>(entry.texture_filepath.size()));
+	put64(40, entry.source_hash);
+	put64(48, pixel_offset);
+	put64(56, pixel_size);
+	size_t at = ATLAS_CACHE_HEADER_SIZE;
+	for (const Placement& p : entry.placements)
+	{
+		put32(at, p.x);
+		put32(at + 4, p.y);
+		put32(at + 8, p.w);
+		put32(at + 12, p.h);
+		put32(at + 16, p.r);
+		at += ATLAS_CACHE_PLACEMENT_SIZE;
+	}
+	memcpy(file.data() + at, entry.texture_filepath.data(), entry.texture_filepath.size());
+
+	// written to a temporary file first, so that concurrent loads never map a partial file
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(filepath).parent_path(), ec);
+	std::string temporary = filepath + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	{
+		std::ofstream out(temporary, std::ios_base::binary | std::ios_base::trunc);
+		if (!out.write(reinterpret_cast<const char*>(file.data()), file.size()))
+			return false;
+	}
+	std::filesystem::rename(temporary, filepath, ec);
+	if (ec)
+		std::filesystem::remove(temporary, ec);
+	return !ec;
+}
+
+bool AtlasCache::Read(const std::string& filepath, const char* asset_filepath, AtlasCacheEntry& entry, const unsigned char*& pixels, std::unique_ptr<MappedFile>& mapping)
+{
+	auto file = std::make_unique<MappedFile>(filepath.c_str());
+	if (!*file || file->GetSize() < ATLAS_CACHE_HEADER_SIZE || memcmp(file->GetData(), ATLAS_CACHE_MAGIC, 8) != 0)
+		return false;
+	const unsigned char* data = file->GetData();
+	size_t size = file->GetSize();
+	auto get32 = [data](size_t at) { uint32_t value; memcpy(&value, data + at, 4); return value; };
+	auto get64 = [data](size_t at) { uint64_t value; memcpy(&value, data + at, 8); return value; };
+	uint32_t flags = get32(12);
+	if (get32(8) != ATLAS_CACHE_VERSION || (flags & ~(ATLAS_CACHE_LZ4 | ATLAS_CACHE_PREMULTIPLIED)) != 0
+		|| ((flags & ATLAS_CACHE_PREMULTIPLIED) != 0) != PulsarSettings::premultiplied_alpha())
+		return false;
+
+	AtlasCacheEntry read;
+	read.width = static_cast<int>(get32(16));
+	read.height = static_cast<int>(get32(20));
+	read.bpp = static_cast<int>(get32(24));
+	read.border = static_cast<int>(get32(28));
+	read.premultiplied = (flags & ATLAS_CACHE_PREMULTIPLIED) != 0;
+	size_t placement_count = get32(32), path_length = get32(36);
+	read.source_hash = get64(40);
+	uint64_t pixel_offset = get64(48), pixel_size = get64(56);
+	size_t table_end = ATLAS_CACHE_HEADER_SIZE + placement_count * ATLAS_CACHE_PLACEMENT_SIZE + path_length;
+	size_t raw_size = static_cast<size_t>(read.width) * read.height * read.bpp;
+	if (read.width <= 0 || read.height <= 0 || read.bpp < 1 || read.bpp > 4 || table_end > size || pixel_offset < table_end
+		|| pixel_offset > size || pixel_size > size - pixel_offset || (!(flags & ATLAS_CACHE_LZ4) && pixel_size != raw_size))
+		return false;
+
+	read.texture_filepath.assign(reinterpret_cast<const char*>(data) + table_end - path_length, path_length);
+	unsigned long long source_hash;
+	if (!SourceHash(asset_filepath, read.texture_filepath.c_str(), source_hash) || source_hash != read.source_hash)
+		return false;
+
+	read.placements.resize(placement_count);
+	for (size_t i = 0; i < placement_count; ++i)
+	{
+		size_t at = ATLAS_CACHE_HEADER_SIZE + i * ATLAS_CACHE_PLACEMENT_SIZE;
+		Placement& p = read.placements[i];
+		p.tile = 0;
+		p.x = static_cast<int>(get32(at));
+		p.y = static_cast<int>(get32(at + 4));
+		p.w = static_cast<int>(get32(at + 8));
+		p.h = static_cast<int>(get32(at + 12));
+		p.r = get32(at + 16) != 0;
+	}
+
+	if (!(flags & ATLAS_CACHE_LZ4))
+	{
+		entry = std::move(read);
+		pixels = data + pixel_offset;
+		mapping = std::move(file);
+		return true;
+	}
+	std::unique_ptr<unsigned char[]> buffer(new unsigned char[raw_size]);
+	if (!LZ4::Decompress(data + pixel_offset, pixel_size, buffer.get(), raw_size))
+		return false;
+	entry = std::move(read);
+	pixels = buffer.release();
+	mapping.reset();
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Atlas.h"
+#include "IO.h"
+
+// Everything but the pixels of a cached atlas.
+struct AtlasCacheEntry
+{
+	std::string texture_filepath;
+	int width = 0, height = 0, bpp = 0, border = 0;
+	bool premultiplied = false;
+	std::vector<Placement> placements;
+	// hash of the atlas asset file and its image, which the cache file is only valid for
+	unsigned long long source_hash = 0;
+};
+
+// Cache of atlases loaded from asset files, stored as binary files that later loads map into memory instead of parsing the asset file and decoding its image.
+// A cache file holds a fixed header, the placement table, the image path, and the pixels exactly as stored in the atlas tile, optionally LZ4 compressed.
+// Files are keyed by the asset path, and rebuilt once the asset file or its image no longer hash to the stored source hash.
+namespace AtlasCache {
+
+	std::string PathOf(const std::string& asset_filepath);
+	bool SourceHash(const char* asset_filepath, const char* texture_filepath, unsigned long long& hash);
+
+	// pixels holds width * height * bpp bytes.
+	bool Write(const std::string& filepath, const AtlasCacheEntry& entry, const unsigned char* pixels, bool compress);
+	// Fails on missing, malformed and stale files, and on files whose pixels are premultiplied unlike the premultiplied_alpha setting.
+	// On success, pixels holds width * height * bpp bytes. Uncompressed pixels are read in place: pixels then points into mapping, which must outlive it.
+	// Otherwise mapping is null, and pixels is a new[] buffer owned by the caller.
+	bool Read(const std::string& filepath, const char* asset_filepath, AtlasCacheEntry& entry, const unsigned char*& pixels, std::unique_ptr<MappedFile>& mapping);
+
+}
@@ -0,0 +1,420 @@
+#include "DynamicAtlas.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <mutex>
+
+#include <stb/stb_image.h>
+
+#include "Logger.inl"
+#include "render/GLDebug.h"
+#include "render/Renderer.h"
+
+// Page textures replaced this recently may still be bound by snapshots that are not submitted yet.
+static constexpr unsigned long long PAGE_FRAMES_IN_FLIGHT = 2;
+static constexpr size_t PAGE_BPP = 4;
+
+DynamicAtlas::DynamicAtlas(int page_size, int max_size, int padding, float defrag_threshold)
+	: m_PageSize(page_size), m_MaxSize(std::min(max_size, page_size - 2 * padding)), m_Padding(padding), m_DefragThreshold(defrag_threshold),
+	m_IsRegion(std::make_unique<std::atomic<bool>[]>(size_t(TextureRegistry::HANDLE_CAP) + 1))
+{
+}
+
+bool DynamicAtlas::Shareable(const TextureSettings& settings)
+{
+	return settings.wrapS == TextureWrap::ClampToEdge && settings.wrapT == TextureWrap::ClampToEdge
+		&& (settings.minFilter == MinFilter::Nearest || settings.minFilter == MinFilter::Linear);
+}
+
+// Only RGB and RGBA images qualify, since pages are RGBA8 and would sample 1 and 2 channel images differently.
+bool DynamicAtlas::Qualifies(int width, int height, int bpp, const TextureSettings& settings) const
+{
+	return m_MaxSize > 0 && width > 0 && height > 0 && width <= m_MaxSize && height <= m_MaxSize && (bpp == 3 || bpp == 4) && Shareable(settings);
+}
+
+bool DynamicAtlas::Accepts(const TextureConstructArgs_filepath& args) const
+{
+	if (m_MaxSize <= 0 || !Shareable(args.settings))
+		return false;
+	int width = 0, height = 0, bpp = 0;
+	return stbi_info(args.filepath.c_str(), &width, &height, &bpp) && Qualifies(width, height, bpp, args.settings);
+}
+
+TextureHandle DynamicAtlas::Pack(const TextureConstructArgs_filepath& args)
+{
+	Tile tile{ TileConstructArgs_filepath(args.filepath, args.svg_scale) };
+	if (!tile)
+		return 0;
+	return Pack(tile.GetImageBuffer(), tile.GetWidth(), tile.GetHeight(), tile.GetBPP(), args.settings);
+}
+
+// Copies the image into the center of a block padded on every side, and extends its edge texels into the padding.
+static void extrude(const unsigned char* pixels, int width, int height, int bpp, int padding, unsigned char* block)
+{
+	int block_width = width + 2 * padding;
+	int block_height = height + 2 * padding;
+	for (int y = 0; y < block_height; ++y)
+	{
+		const unsigned char* row = pixels + static_cast<size_t>(std::clamp(y - padding, 0, height - 1)) * width * bpp;
+		unsigned char* dst = block + static_cast<size_t>(y) * block_width * PAGE_BPP;
+		for (int x = 0; x < block_width; ++x, dst += PAGE_BPP)
+		{
+			const unsigned char* src = row + static_cast<size_t>(std::clamp(x - padding, 0, width - 1)) * bpp;
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = bpp == 4 ? src[3] : 255;
+		}
+	}
+}
+
+// The image is extruded on the calling thread. Only placing it into a page runs on the GL thread.
+TextureHandle DynamicAtlas::Pack(const unsigned char* pixels, int width, int height, int bpp, const TextureSettings& settings)
+{
+	if (!pixels || !Qualifies(width, height, bpp, settings))
+		return 0;
+	int block_width = width + 2 * m_Padding;
+	int block_height = height + 2 * m_Padding;
+	std::vector<unsigned char> block(static_cast<size_t>(block_width) * block_height * PAGE_BPP);
+	extrude(pixels, width, height, bpp, m_Padding, block.data());
+	TextureHandle handle = Renderer::Textures()._ReserveHandle();
+	bool packed = false;
+	Renderer::_GLInvoke([&]() {
+		std::unique_lock<std::shared_mutex> lock(m_Mutex);
+		TileRect slot;
+		Page* page = Allocate(settings, block_width, block_height, slot);
+		if (!page)
+			return;
+		Place(handle, *page, slot, block.data(), width, height);
+		packed = true;
+	});
+	if (!packed)
+	{
+		Logger::LogError("Failed to pack " + std::to_string(width) + "x" + std::to_string(height) + " image into the dynamic atlas.");
+		return 0;
+	}
+	return handle;
+}
+
+bool DynamicAtlas::Release(TextureHandle handle)
+{
+	if (!IsRegion(handle))
+		return false;
+	Renderer::_GLInvoke([this, handle]() {
+		std::unique_lock<std::shared_mutex> lock(m_Mutex);
+		auto iter = m_Regions.find(handle);
+		if (iter != m_Regions.end())
+			Unplace(handle, iter->second);
+	});
+	return true;
+}
+
+// Regions change settings by moving to a page with the new settings. Settings that regions cannot share are ignored.
+void DynamicAtlas::SetSettings(TextureHandle handle, const TextureSettings& settings)
+{
+	if (!Shareable(settings))
+	{
+		Logger::LogWarning("Cannot set wrapping other than ClampToEdge or mipmap filtering on dynamic atlas region (" + std::to_string(handle) + ").");
+		return;
+	}
+	Renderer::_GLInvoke([this, handle, &settings]() {
+		std::unique_lock<std::shared_mutex> lock(m_Mutex);
+		auto iter = m_Regions.find(handle);
+		if (iter == m_Regions.end() || iter->second.page->settings == settings)
+			return;
+		Region region = iter->second;
+		std::vector<unsigned char> block(static_cast<size_t>(region.slot.w) * region.slot.h * PAGE_BPP);
+		for (int y = 0; y < region.slot.h; ++y)
+			memcpy(block.data() + static_cast<size_t>(y) * region.slot.w * PAGE_BPP,
+				region.page->buffer.get() + (static_cast<size_t>(region.slot.y + y) * m_PageSize + region.slot.x) * PAGE_BPP, region.slot.w * PAGE_BPP);
+		Unplace(handle, region);
+		TileRect slot;
+		Page* page = Allocate(settings, region.slot.w, region.slot.h, slot);
+		if (page)
+			Place(handle, *page, slot, block.data(), region.width, region.height);
+		else
+			Logger::LogError("Failed to move dynamic atlas region (" + std::to_string(handle) + ") to a page with new settings.");
+	});
+}
+
+bool DynamicAtlas::GetRegion(TextureHandle handle, AtlasRegion& region) const
+{
+	if (!IsRegion(handle))
+		return false;
+	std::shared_lock<std::shared_mutex> lock(m_Mutex);
+	auto iter = m_Regions.find(handle);
+	if (iter == m_Regions.end())
+		return false;
+	region = { iter->second.page->texture, iter->second.uvRect, iter->second.width, iter->second.height };
+	return true;
+}
+
+DynamicAtlasStats DynamicAtlas::Stats() const
+{
+	std::shared_lock<std::shared_mutex> lock(m_Mutex);
+	DynamicAtlasStats stats;
+	stats.pages = m_Pages.size();
+	stats.regions = m_Regions.size();
+	size_t used = 0;
+	for (const auto& page : m_Pages)
+		used += page->usedArea;
+	if (!m_Pages.empty())
+		stats.occupancy = static_cast<float>(used) / (static_cast<float>(m_PageSize) * m_PageSize * m_Pages.size());
+	stats.defragmentations = m_Defragmentations;
+	return stats;
+}
+
+bool DynamicAtlas::_NeedsMaintenance() const
+{
+	std::shared_lock<std::shared_mutex> lock(m_Mutex);
+	return !m_Retired.empty() || std::any_of(m_Pages.begin(), m_Pages.end(), [](const auto& page) { return page->released; });
+}
+
+void DynamicAtlas::_Maintain()
+{
+	std::unique_lock<std::shared_mutex> lock(m_Mutex);
+	unsigned long long frame = m_Frame.load(std::memory_order_relaxed);
+	for (auto iter = m_Pages.begin(); iter != m_Pages.end(); )
+	{
+		Page& page = **iter;
+		if (page.released && page.regions.empty())
+		{
+			Retire(page.texture, page.tile, std::move(page.buffer));
+			iter = m_Pages.erase(iter);
+			continue;
+		}
+		if (page.released)
+		{
+			page.released = false;
+			if (Fragmentation(page) > m_DefragThreshold)
+				Defragment(page);
+		}
+		++iter;
+	}
+	std::erase_if(m_Retired, [frame](const Retired& retired) {
+		if (retired.frame + PAGE_FRAMES_IN_FLIGHT >= frame)
+			return false;
+		Renderer::Textures().Destroy(retired.texture);
+		Renderer::Tiles().Destroy(retired.tile);
+		return true;
+	});
+}
+
+// Best area fit among the free rects. The leftover is split along its shorter side, which keeps the larger free rect as large as possible.
+static bool guillotine_insert(std::vector<TileRect>& free_rects, int width, int height, TileRect& placed)
+{
+	size_t best = free_rects.size();
+	long long best_area = LLONG_MAX;
+	for (size_t i = 0; i < free_rects.size(); ++i)
+	{
+		const TileRect& rect = free_rects[i];
+		long long area = static_cast<long long>(rect.w) * rect.h;
+		if (rect.w >= width && rect.h >= height && area < best_area)
+		{
+			best = i;
+			best_area = area;
+		}
+	}
+	if (best == free_rects.size())
+		return false;
+	TileRect rect = free_rects[best];
+	free_rects[best] = free_rects.back();
+	free_rects.pop_back();
+	placed = { rect.x, rect.y, width, height };
+	int right_width = rect.w - width;
+	int top_height = rect.h - height;
+	TileRect right, top;
+	if (right_width < top_height)
+	{
+		right = { rect.x + width, rect.y, right_width, height };
+		top = { rect.x, rect.y + height, rect.w, top_height };
+	}
+	else
+	{
+		right = { rect.x + width, rect.y, right_width, rect.h };
+		top = { rect.x, rect.y + height, width, top_height };
+	}
+	if (right.w > 0 && right.h > 0)
+		free_rects.push_back(right);
+	if (top.w > 0 && top.h > 0)
+		free_rects.push_back(top);
+	return true;
+}
+
+// Merges free rects that share a whole edge, until none do.
+static void merge_free_rects(std::vector<TileRect>& free_rects)
+{
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < free_rects.size() && !merged; ++i)
+		{
+			for (size_t j = i + 1; j < free_rects.size(); ++j)
+			{
+				TileRect& a = free_rects[i];
+				const TileRect& b = free_rects[j];
+				if (a.x == b.x && a.w == b.w && (a.y + a.h == b.y || b.y + b.h == a.y))
+				{
+					a.y = std::min(a.y, b.y);
+					a.h += b.h;
+				}
+				else if (a.y == b.y && a.h == b.h && (a.x + a.w == b.x || b.x + b.w == a.x))
+				{
+					a.x = std::min(a.x, b.x);
+					a.w += b.w;
+				}
+				else
+					continue;
+				free_rects[j] = free_rects.back();
+				free_rects.pop_back();
+				merged = true;
+				break;
+			}
+		}
+	}
+}
+
+// Tries the pages with the same settings, then those of them fragmented enough that repacking may make room, and otherwise opens a new page.
+DynamicAtlas::Page* DynamicAtlas::Allocate(const TextureSettings& settings, int width, int height, TileRect& slot)
+{
+	for (const auto& page : m_Pages)
+	{
+		if (page->settings == settings && guillotine_insert(page->freeRects, width, height, slot))
+			return page.get();
+	}
+	size_t area = static_cast<size_t>(width) * height;
+	for (const auto& page : m_Pages)
+	{
+		if (page->settings == settings && static_cast<size_t>(m_PageSize) * m_PageSize - page->usedArea >= area && Fragmentation(*page) > m_DefragThreshold
+			&& Defragment(*page) && guillotine_insert(page->freeRects, width, height, slot))
+			return page.get();
+	}
+	Page* page = NewPage(settings);
+	if (page && guillotine_insert(page->freeRects, width, height, slot))
+		return page;
+	return nullptr;
+}
+
+// Pages are tiles over a buffer the atlas owns, so that their textures can be evicted and reloaded like any other tile texture.
+DynamicAtlas::Page* DynamicAtlas::NewPage(const TextureSettings& settings)
+{
+	auto page = std::make_unique<Page>();
+	page->settings = settings;
+	page->buffer.reset(new unsigned char[static_cast<size_t>(m_PageSize) * m_PageSize * PAGE_BPP]());
+	page->tile = Renderer::Tiles().Register(Tile(TileConstructArgs_buffer(page->buffer.get(), m_PageSize, m_PageSize, PAGE_BPP, TileDeletionPolicy::FROM_EXTERNAL)));
+	page->texture = Renderer::Textures().GetHandle(TextureConstructArgs_tile(page->tile, 0, settings));
+	if (!page->texture)
+	{
+		Renderer::Tiles().Destroy(page->tile);
+		return nullptr;
+	}
+	if (Texture const* texture = Renderer::Textures().Get(page->texture))
+		GLDebug::Label(GL_TEXTURE, texture->GetRID(), "dynamic atlas page");
+	page->freeRects.push_back({ 0, 0, m_PageSize, m_PageSize });
+	m_Pages.push_back(std::move(page));
+	return m_Pages.back().get();
+}
+
+// Repacks the page's regions, tallest first, into a new page texture. The old texture is retired rather than overwritten,
+// since snapshots in flight may still sample it at the old UVs.
+bool DynamicAtlas::Defragment(Page& page)
+{
+	std::vector<TextureHandle> order = page.regions;
+	std::sort(order.begin(), order.end(), [this](TextureHandle a, TextureHandle b) {
+		const TileRect& ra = m_Regions[a].slot;
+		const TileRect& rb = m_Regions[b].slot;
+		return ra.h != rb.h ? ra.h > rb.h : ra.w > rb.w;
+	});
+	std::vector<TileRect> free_rects{ { 0, 0, m_PageSize, m_PageSize } };
+	std::vector<TileRect> slots(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const TileRect& slot = m_Regions[order[i]].slot;
+		if (!guillotine_insert(free_rects, slot.w, slot.h, slots[i]))
+			return false;
+	}
+	std::unique_ptr<unsigned char[]> buffer(new unsigned char[static_cast<size_t>(m_PageSize) * m_PageSize * PAGE_BPP]());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const TileRect& from = m_Regions[order[i]].slot;
+		const TileRect& to = slots[i];
+		for (int y = 0; y < from.h; ++y)
+			memcpy(buffer.get() + (static_cast<size_t>(to.y + y) * m_PageSize + to.x) * PAGE_BPP,
+				page.buffer.get() + (static_cast<size_t>(from.y + y) * m_PageSize + from.x) * PAGE_BPP, from.w * PAGE_BPP);
+	}
+	TileHandle tile = Renderer::Tiles().Register(Tile(TileConstructArgs_buffer(buffer.get(), m_PageSize, m_PageSize, PAGE_BPP, TileDeletionPolicy::FROM_EXTERNAL)));
+	TextureHandle texture = Renderer::Textures().GetHandle(TextureConstructArgs_tile(tile, 0, page.settings));
+	if (!texture)
+	{
+		Renderer::Tiles().Destroy(tile);
+		return false;
+	}
+	if (Texture const* t = Renderer::Textures().Get(texture))
+		GLDebug::Label(GL_TEXTURE, t->GetRID(), "dynamic atlas page");
+	Retire(page.texture, page.tile, std::move(page.buffer));
+	page.buffer = std::move(buffer);
+	page.tile = tile;
+	page.texture = texture;
+	page.freeRects = std::move(free_rects);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		Region& region = m_Regions[order[i]];
+		region.slot = slots[i];
+		region.uvRect = { static_cast<float>(slots[i].x + m_Padding) / m_PageSize, static_cast<float>(slots[i].y + m_Padding) / m_PageSize,
+			static_cast<float>(region.width) / m_PageSize, static_cast<float>(region.height) / m_PageSize };
+	}
+	++m_Defragmentations;
+	return true;
+}
+
+void DynamicAtlas::Retire(TextureHandle texture, TileHandle tile, std::unique_ptr<unsigned char[]>&& buffer)
+{
+	m_Retired.push_back({ texture, tile, std::move(buffer), m_Frame.load(std::memory_order_relaxed) });
+}
+
+void DynamicAtlas::Place(TextureHandle handle, Page& page, const TileRect& slot, const unsigned char* block, int width, int height)
+{
+	for (int y = 0; y < slot.h; ++y)
+		memcpy(page.buffer.get() + (static_cast<size_t>(slot.y + y) * m_PageSize + slot.x) * PAGE_BPP, block + static_cast<size_t>(y) * slot.w * PAGE_BPP, slot.w * PAGE_BPP);
+	glm::vec4 uv_rect = { static_cast<float>(slot.x + m_Padding) / m_PageSize, static_cast<float>(slot.y + m_Padding) / m_PageSize,
+		static_cast<float>(width) / m_PageSize, static_cast<float>(height) / m_PageSize };
+	m_Regions[handle] = { &page, slot, width, height, uv_rect };
+	page.regions.push_back(handle);
+	page.usedArea += static_cast<size_t>(slot.w) * slot.h;
+	Upload(page, slot);
+	m_IsRegion[handle].store(true, std::memory_order_release);
+}
+
+// The freed texels are left as they are. Snapshots in flight may still sample them.
+void DynamicAtlas::Unplace(TextureHandle handle, const Region& region)
+{
+	Page& page = *region.page;
+	page.freeRects.push_back(region.slot);
+	merge_free_rects(page.freeRects);
+	page.usedArea -= static_cast<size_t>(region.slot.w) * region.slot.h;
+	std::erase(page.regions, handle);
+	page.released = true;
+	m_IsRegion[handle].store(false, std::memory_order_release);
+	m_Regions.erase(handle);
+}
+
+// An evicted page has no texture to update. Its tile already holds the change, and it is reloaded from it.
+void DynamicAtlas::Upload(const Page& page, const TileRect& rect) const
+{
+	if (Texture const* texture = Renderer::Textures().Get(page.texture))
+		Renderer::Uploader().SubImage(*texture, page.buffer.get() + (static_cast<size_t>(rect.y) * m_PageSize + rect.x) * PAGE_BPP, rect.x, rect.y, rect.w, rect.h, m_PageSize);
+}
+
+// 1 - the largest free rect's share of the free area. 0 means all free texels are in one rect.
+float DynamicAtlas::Fragmentation(const Page& page) const
+{
+	size_t free_area = static_cast<size_t>(m_PageSize) * m_PageSize - page.usedArea;
+	if (free_area == 0)
+		return 0.0f;
+	size_t largest = 0;
+	for (const TileRect& rect : page.freeRects)
+		largest = std::max(largest, static_cast<size_t>(rect.w) * rect.h);
+	return 1.0f - static_cast<float>(largest) / free_area;
+}
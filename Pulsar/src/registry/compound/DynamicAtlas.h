@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "registry/Texture.h"
+
+// Where a packed image lives. uvRect is the x, y, width and height of its texels in the page, normalized to the page size.
+struct AtlasRegion
+{
+	TextureHandle page = 0;
+	glm::vec4 uvRect = { 0.0f, 0.0f, 1.0f, 1.0f };
+	int width = 0, height = 0;
+};
+
+struct DynamicAtlasStats
+{
+	size_t pages = 0;
+	size_t regions = 0;
+	// fraction of the pages' texels covered by regions, including their padding
+	float occupancy = 0.0f;
+	unsigned long long defragmentations = 0;
+};
+
+// Packs small images into shared RGBA8 pages, so that actors drawing them batch under one texture slot.
+// Each packed image gets a region handle from the texture registry. The registry reports the image's own size for it, and binds its page.
+// Canvas layers batch regions as their page, and remap the UVs of pooled vertices into the region, found through their shader's texcoord_attrib,
+// so actors keep UVs relative to the image, and RectRender/ActorPrimitive2D crops work unchanged.
+// Images are padded, and their edge texels extruded into the padding, so that filtering never samples a neighbour.
+// Pages keep a CPU copy, from which they are reloaded if evicted, and repacked into a new page texture when released regions leave them too fragmented.
+// Only settings that regions can share qualify: ClampToEdge wrapping, and no mipmap filtering.
+// Packing, releasing and repacking run on the GL thread. Region lookups may be called from any thread.
+class DynamicAtlas
+{
+	struct Page
+	{
+		TextureSettings settings;
+		std::unique_ptr<unsigned char[]> buffer;
+		TileHandle tile = 0;
+		TextureHandle texture = 0;
+		std::vector<TileRect> freeRects;
+		std::vector<TextureHandle> regions;
+		size_t usedArea = 0;
+		// regions were released since the page was last checked for fragmentation
+		bool released = false;
+	};
+	struct Region
+	{
+		Page* page;
+		// padded rect in the page
+		TileRect slot;
+		int width, height;
+		glm::vec4 uvRect;
+	};
+	// page textures replaced by repacking, or of emptied pages, kept until snapshots in flight no longer bind them
+	struct Retired
+	{
+		TextureHandle texture;
+		TileHandle tile;
+		std::unique_ptr<unsigned char[]> buffer;
+		unsigned long long frame;
+	};
+
+	int m_PageSize, m_MaxSize, m_Padding;
+	float m_DefragThreshold;
+	std::vector<std::unique_ptr<Page>> m_Pages;
+	std::unordered_map<TextureHandle, Region> m_Regions;
+	// indexed by handle, so that handles of standalone textures are told apart without locking
+	std::unique_ptr<std::atomic<bool>[]> m_IsRegion;
+	std::vector<Retired> m_Retired;
+	std::atomic<unsigned long long> m_Frame = 0;
+	unsigned long long m_Defragmentations = 0;
+	mutable std::shared_mutex m_Mutex;
+
+public:
+	DynamicAtlas(int page_size, int max_size, int padding, float defrag_threshold);
+	DynamicAtlas(const DynamicAtlas&) = delete;
+	DynamicAtlas(DynamicAtlas&&) = delete;
+
+	// Whether the file at args is small enough to pack, and its settings can be shared. Only the image header is read.
+	bool Accepts(const TextureConstructArgs_filepath& args) const;
+	// Returns the region handle of the packed image, or 0 if it does not qualify.
+	TextureHandle Pack(const TextureConstructArgs_filepath& args);
+	TextureHandle Pack(const unsigned char* pixels, int width, int height, int bpp, const TextureSettings& settings);
+	bool Release(TextureHandle handle);
+	void SetSettings(TextureHandle handle, const TextureSettings& settings);
+
+	bool IsRegion(TextureHandle handle) const { return m_IsRegion[handle].load(std::memory_order_acquire); }
+	bool GetRegion(TextureHandle handle, AtlasRegion& region) const;
+	DynamicAtlasStats Stats() const;
+
+	void _NextFrame() { m_Frame.fetch_add(1, std::memory_order_relaxed); }
+	// Whether pages were released, or retired page textures wait to be destroyed.
+	bool _NeedsMaintenance() const;
+	// Repacks fragmented pages, and destroys retired page textures. Runs on the GL thread while the main thread waits for it,
+	// so that regions never move while canvas layers are recorded.
+	void _Maintain();
+
+	static bool Shareable(const TextureSettings& settings);
+
+private:
+	bool Qualifies(int width, int height, int bpp, const TextureSettings& settings) const;
+	Page* Allocate(const TextureSettings& settings, int width, int height, TileRect& slot);
+	Page* NewPage(const TextureSettings& settings);
+	bool Defragment(Page& page);
+	void Retire(TextureHandle texture, TileHandle tile, std::unique_ptr<unsigned char[]>&& buffer);
+	void Place(TextureHandle handle, Page& page, const TileRect& slot, const unsigned char* block, int width, int height);
+	void Unplace(TextureHandle handle, const Region& region);
+	void Upload(const Page& page, const TileRect& rect) const;
+	float Fragmentation(const Page& page) const;
+};
@@ -4,12 +4,21 @@
 
 typedef signed short ZIndex;
 
+// Actors that report a proxy type other than NONE are drawn by the canvas layer through compact proxies instead of RequestDraw().
+enum class RenderProxyType : unsigned char
+{
+	NONE,
+	PRIMITIVE,
+	RECT
+};
+
 struct ActorRenderBase2D
 {
 	ZIndex z;
 	ActorRenderBase2D(ZIndex z = 0) : z(z) {}
 	virtual ~ActorRenderBase2D() = default;
 	virtual void RequestDraw(class CanvasLayer* canvas_layer) = 0;
+	virtual RenderProxyType ProxyType() const { return RenderProxyType::NONE; }
 };
 
 struct FickleActor2D : public ActorRenderBase2D
@@ -1,7 +1,11 @@
 #include "render/CanvasLayer.h"
 
+#include <algorithm>
+
 #include "Macros.h"
+#include "utils/Data.inl"
 #include "Renderer.h"
+#include "GLDebug.h"
 #include "registry/Shader.h"
 #include "actors/ActorPrimitive.h"
 #include "actors/shapes/DebugMultiPolygon.h"
@@ -9,25 +13,48 @@
 
 void RectBatcher::set_size(GLsizei i)
 {
-	GLsizei prev_size = static_cast<GLsizei>(indexes.size());
-	if (i < prev_size)
-	{
-		indexes.resize(i);
-		index_counts.resize(i);
-		indexes.shrink_to_fit();
-		index_counts.shrink_to_fit();
-	}
-	else
+	size = i;
+}
+
+// Only accessed on submission, and therefore only by the thread owning the GL context.
+static std::vector<GLint> rect_firsts; // { 0, 4, 8, ... }
+static std::vector<GLsizei> rect_counts; // { 4, 4, 4, ... }
+
+static void reserve_rects(GLsizei count)
+{
+	size_t prev_size = rect_firsts.size();
+	if (count <= prev_size)
+		return;
+	rect_firsts.resize(count);
+	rect_counts.resize(count);
+	for (size_t j = prev_size; j < count; ++j)
 	{
-		indexes.resize(i);
-		index_counts.resize(i);
-		for (size_t j = prev_size; j < i; ++j)
-		{
-			indexes[j] = static_cast<GLint>(4 * j);
-			index_counts[j] = static_cast<GLsizei>(4);
-		}
+		rect_firsts[j] = static_cast<GLint>(4 * j);
+		rect_counts[j] = static_cast<GLsizei>(4);
 	}
-	size = i;
+}
+
+// Last view-projection passed to each shader, so u_VP is only re-uploaded when a different view is submitted with it.
+static std::unordered_map<ShaderHandle, glm::mat3> submitted_vps;
+
+static void pass_vp_uniform(ShaderHandle shader, const glm::mat3& vp)
+{
+	auto submitted = submitted_vps.find(shader);
+	if (submitted != submitted_vps.end() && submitted->second == vp)
+		return;
+	Renderer::Shaders().SetUniformMatrix3fv(shader, "u_VP", &vp[0][0]);
+	submitted_vps[shader] = vp;
+}
+
+void LayerSnapshot2D::Clear()
+{
+	vertexPool.clear();
+	indexPool.clear();
+	textures.clear();
+	multiFirsts.clear();
+	multiCounts.clear();
+	pooledUniforms = 0;
+	commands.clear();
 }
 
 bool RectBatcher::increment_and_push_size(GLsizei hard_limit, GLsizei hit_limit_incr)
@@ -59,57 +86,58 @@ bool RectBatcher::try_increment()
 CanvasLayer::CanvasLayer(const CanvasLayerData& data)
 	: m_Data(data), m_LayerView((float)m_Data.pLeft, (float)m_Data.pRight, (float)m_Data.pBottom, (float)m_Data.pTop)
 {
-	m_VertexPool = new GLfloat[m_Data.maxVertexPoolSize];
-	m_IndexPool = new GLuint[m_Data.maxIndexPoolSize];
-	vertexPos = m_VertexPool;
-	indexPos = m_IndexPool;
-
-	// generate buffers
-	PULSAR_TRY(glGenBuffers(1, &m_VB));
-	PULSAR_TRY(glGenBuffers(1, &m_IB));
-	// bind buffers
-	PULSAR_TRY(glBindBuffer(GL_ARRAY_BUFFER, m_VB));
-	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IB));
-	// initialize buffers
-	PULSAR_TRY(glBufferData(GL_ARRAY_BUFFER, m_Data.maxVertexPoolSize * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW));
-	PULSAR_TRY(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Data.maxIndexPoolSize * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW));
-	// unbind buffers
-	PULSAR_TRY(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	for (auto& snapshot : m_Snapshots)
+	{
+		snapshot.vertexPool.reserve(m_Data.maxVertexPoolSize);
+		snapshot.indexPool.reserve(m_Data.maxIndexPoolSize);
+	}
 }
 
 CanvasLayer::~CanvasLayer()
 {
-	if (m_VertexPool)
-	{
-		delete m_VertexPool;
-		m_VertexPool = nullptr;
-	}
-	if (m_IndexPool)
-	{
-		delete m_IndexPool;
-		m_IndexPool = nullptr;
-	}
+}
 
-	PULSAR_TRY(glDeleteBuffers(1, &m_VB));
-	PULSAR_TRY(glDeleteBuffers(1, &m_IB));
-	m_VB = m_IB = 0;
+PrimitiveProxy2D CanvasLayer::MakeProxy(ActorPrimitive2D* primitive)
+{
+	return { primitive, &primitive->m_Render, &primitive->m_Status };
+}
 
-	for (const auto& [model, vao] : m_VAOs)
-	{
-		PULSAR_TRY(glDeleteVertexArrays(1, &vao));
-	}
+// 16 bits of ZIndex, 4 of proxy type, 16 of shader and 28 of attach sequence.
+static constexpr unsigned int DRAW_KEY_SEQUENCE_BITS = 28;
+static constexpr unsigned long long DRAW_KEY_SEQUENCE_MASK = (1ull << DRAW_KEY_SEQUENCE_BITS) - 1;
+static constexpr unsigned long long DRAW_KEY_SHADER_MASK = 0xFFFFull << DRAW_KEY_SEQUENCE_BITS;
+
+static unsigned long long draw_key(ZIndex z, RenderProxyType type, ShaderHandle shader, unsigned int sequence)
+{
+	return (static_cast<unsigned long long>(static_cast<unsigned short>(z) ^ 0x8000) << 48)
+		| (static_cast<unsigned long long>(type) << 44)
+		| (static_cast<unsigned long long>(shader) << DRAW_KEY_SEQUENCE_BITS)
+		| sequence;
+}
+
+static unsigned long long with_shader(unsigned long long key, ShaderHandle shader)
+{
+	return (key & ~DRAW_KEY_SHADER_MASK) | (static_cast<unsigned long long>(shader) << DRAW_KEY_SEQUENCE_BITS);
 }
 
 void CanvasLayer::OnAttach(ActorRenderBase2D* const actor)
 {
-	auto entry = m_Batcher.find(actor->z);
-	if (entry == m_Batcher.end())
+	if (m_BatcherLookup.find(actor) != m_BatcherLookup.end())
+		return;
+	DrawEntry2D entry{ 0, actor, {}, actor->ProxyType() };
+	ShaderHandle shader = 0;
+	if (entry.type != RenderProxyType::NONE)
 	{
-		m_Batcher.emplace(actor->z, std::list<ActorRenderBase2D*>());
-		entry = m_Batcher.find(actor->z);
+		entry.proxy = MakeProxy(static_cast<ActorPrimitive2D*>(actor));
+		shader = entry.proxy.render->model.shader;
 	}
-	entry->second.push_back(actor);
+	if (m_AttachSequence > DRAW_KEY_SEQUENCE_MASK)
+		RenumberBatcher();
+	entry.key = draw_key(actor->z, entry.type, shader, m_AttachSequence++);
+	if (!m_Batcher.empty() && m_Batcher.back().key > entry.key)
+		m_BatcherDirty = true;
+	m_BatcherLookup[actor] = m_Batcher.size();
+	m_Batcher.push_back(entry);
 }
 
 bool CanvasLayer::OnSetZIndex(ActorRenderBase2D* const actor, ZIndex new_val)
@@ -123,22 +151,45 @@ bool CanvasLayer::OnSetZIndex(ActorRenderBase2D* const actor, ZIndex new_val)
 
 bool CanvasLayer::OnDetach(ActorRenderBase2D* const actor)
 {
-	auto entry = m_Batcher.find(actor->z);
-	if (entry == m_Batcher.end())
+	auto lookup = m_BatcherLookup.find(actor);
+	if (lookup == m_BatcherLookup.end())
 		return false;
-	entry->second.remove(actor);
+	size_t index = lookup->second;
+	m_BatcherLookup.erase(lookup);
+	if (index + 1 < m_Batcher.size())
+	{
+		m_BatcherLookup[m_Batcher.back().actor] = index;
+		m_BatcherDirty = true;
+	}
+	swap_pop(m_Batcher, index);
 	return true;
 }
 
+void CanvasLayer::SortBatcher()
+{
+	radix_sort_64(m_Batcher, m_BatcherSortBuffer, [](const DrawEntry2D& entry) { return entry.key; });
+	for (size_t i = 0; i < m_Batcher.size(); ++i)
+		m_BatcherLookup[m_Batcher[i].actor] = i;
+	m_BatcherDirty = false;
+}
+
+// Once the attach sequence runs out of bits, the entries are numbered again in their sorted order, which keeps that order.
+void CanvasLayer::RenumberBatcher()
+{
+	if (m_BatcherDirty)
+		SortBatcher();
+	for (size_t i = 0; i < m_Batcher.size(); ++i)
+		m_Batcher[i].key = (m_Batcher[i].key & ~DRAW_KEY_SEQUENCE_MASK) | i;
+	m_AttachSequence = static_cast<unsigned int>(m_Batcher.size());
+}
+
 void CanvasLayer::Clear()
 {
-	for (const auto& [model, vao] : m_VAOs)
-	{
-		PULSAR_TRY(glDeleteVertexArrays(1, &vao));
-	}
-	m_VAOs.clear();
 	m_TextureSlotBatch.clear();
 	m_Batcher.clear();
+	m_BatcherLookup.clear();
+	m_BatcherDirty = false;
+	m_AttachSequence = 0;
 	rectBatcher.set_size(0);
 	rectBatcher.draw_count = 0;
 	ResetPoolsAndLexicon();
@@ -146,36 +197,105 @@ void CanvasLayer::Clear()
 
 void CanvasLayer::OnDraw()
 {
-	SetBlending();
+	BeginDraw();
+	DrawBatcherOf(*this);
+	EndDraw();
+	_Submit();
+}
+
+bool CanvasLayer::SharesState(const CanvasLayer& other) const
+{
+	if (m_Data.enableGLBlend != other.m_Data.enableGLBlend)
+		return false;
+	if (m_Data.enableGLBlend && (m_Data.sourceBlend != other.m_Data.sourceBlend || m_Data.destBlend != other.m_Data.destBlend))
+		return false;
+	return m_LayerView.SharesView(other.m_LayerView);
+}
+
+// Records the actors of layers, in order, into this layer's pools and command list. Touches no GL state, so layers can be recorded concurrently.
+void CanvasLayer::_Record(const frame_vector<CanvasLayer*>& layers, unsigned char snapshot)
+{
+	m_Recording = &m_Snapshots[snapshot];
+	BeginDraw();
+	for (CanvasLayer* layer : layers)
+		DrawBatcherOf(*layer);
+	EndDraw();
+}
+
+// Must be called on the main thread, after recording.
+void CanvasLayer::_ApplyTouches()
+{
+	for (TextureHandle texture : m_Touched)
+		Renderer::Textures().Touch(texture);
+}
+
+// Replays a recorded snapshot. Must be called on the thread owning the GL context.
+void CanvasLayer::_Submit(unsigned char snapshot) const
+{
+	if (GLDebug::Enabled())
+		GLDebug::PushGroup("CanvasLayer " + std::to_string(m_Data.ci));
+	const LayerSnapshot2D& submission = m_Snapshots[snapshot];
+	SetBlending(submission);
+	for (const auto& command : submission.commands)
+		SubmitCommand(submission, command);
+	GLDebug::PopGroup();
+}
+
+void CanvasLayer::BeginDraw()
+{
 	currentModel = BatchModel();
+	currentDrawMode = DrawMode::VOID;
+	m_TextureSlotBatch.clear();
+	m_Touched.clear();
+	m_Recording->Clear();
+	m_Recording->vp = m_LayerView.m_VP;
+	m_Recording->enableGLBlend = m_Data.enableGLBlend;
+	m_Recording->sourceBlend = m_Data.sourceBlend;
+	m_Recording->destBlend = m_Data.destBlend;
 	ResetPoolsAndLexicon();
-	for (const auto& list : m_Batcher)
-		for (const auto& element : list.second)
-			element->RequestDraw(this);
-	FlushAndReset();
 }
 
-void CanvasLayer::DrawPrimitive(ActorPrimitive2D* primitive)
+// Draws the actors of layer into this layer's batches. Layers with shared state can thereby be merged into one submission.
+// Proxies whose shader changed since they were attached get their key rebuilt, and are sorted into place from the next frame on.
+void CanvasLayer::DrawBatcherOf(CanvasLayer& layer)
 {
-	if (currentDrawMode != DrawMode::PRIMITIVE)
-	{
-		FlushAndReset();
-		currentDrawMode = DrawMode::PRIMITIVE;
-	}
-	const auto& render = primitive->m_Render;
-	if (render.model != currentModel || !currentLexicon.Shares(render.uniformLexicon))
+	if (layer.m_BatcherDirty)
+		layer.SortBatcher();
+	for (auto& entry : layer.m_Batcher)
 	{
-		SendTriangles();
-		SetBatchModel(render.model);
-		SetUniformLexicon(render.uniformLexicon);
-	}
-	else if (m_Data.maxVertexPoolSize - (vertexPos - m_VertexPool) < Render::VertexBufferLayoutCount(render)
-			|| m_Data.maxIndexPoolSize - (indexPos - m_IndexPool) < render.indexCount)
-	{
-		SendTriangles();
+		if (entry.type != RenderProxyType::NONE)
+		{
+			unsigned long long key = with_shader(entry.key, entry.proxy.render->model.shader);
+			if (key != entry.key)
+			{
+				entry.key = key;
+				layer.m_BatcherDirty = true;
+			}
+		}
+		switch (entry.type)
+		{
+		case RenderProxyType::RECT:
+			DrawRectProxy(entry.proxy);
+			break;
+		case RenderProxyType::PRIMITIVE:
+			DrawPrimitiveProxy(entry.proxy);
+			break;
+		default:
+			entry.actor->RequestDraw(this);
+		}
 	}
-	primitive->OnDraw(GetTextureSlot(render));
-	PoolOverAll(render);
+}
+
+void CanvasLayer::EndDraw()
+{
+	FlushAndReset();
+}
+
+void CanvasLayer::DrawPrimitive(ActorPrimitive2D* primitive)
+{
+	TextureSlot slot = BatchPrimitive(primitive->m_Render);
+	primitive->OnDraw(slot);
+	PoolOverAll(primitive->m_Render);
 }
 
 void CanvasLayer::DrawArray(const Renderable& renderable, GLenum indexing_mode)
@@ -199,7 +319,7 @@ void CanvasLayer::DrawMultiArray(DebugMultiPolygon* multi_polygon)
 	{
 		if (!poly->DrawPrep())
 			continue;
-		if (m_Data.maxVertexPoolSize - (vertexPos - m_VertexPool) < Render::VertexBufferLayoutCount(poly->m_Renderable))
+		if (m_Data.maxVertexPoolSize - PooledVertexCount() < Render::VertexBufferLayoutCount(poly->m_Renderable))
 			SendMultiArray(multi_polygon);
 		PoolOverVertexBuffer(poly->m_Renderable);
 		PoolOverLexicon(poly->m_Renderable.uniformLexicon);
@@ -208,6 +328,56 @@ void CanvasLayer::DrawMultiArray(DebugMultiPolygon* multi_polygon)
 }
 
 void CanvasLayer::DrawRect(const Renderable& renderable, const Functor<void, TextureSlot>& on_draw_callback)
+{
+	on_draw_callback(BatchRect(renderable));
+	PoolOverVertexBuffer(renderable);
+	PoolOverLexicon(renderable.uniformLexicon);
+}
+
+// Only repacks the actor's vertex buffer when its texture slot or fickle state changed since it was last drawn.
+static void sync_proxy(const PrimitiveProxy2D& proxy, TextureSlot slot)
+{
+	if (proxy.render->vertexBufferData && ((*proxy.status & 0b1110) || proxy.render->vertexBufferData[0] != slot))
+		proxy.actor->OnDraw(slot);
+}
+
+void CanvasLayer::DrawRectProxy(const PrimitiveProxy2D& proxy)
+{
+	sync_proxy(proxy, BatchRect(*proxy.render));
+	PoolOverVertexBuffer(*proxy.render);
+	PoolOverLexicon(proxy.render->uniformLexicon);
+}
+
+void CanvasLayer::DrawPrimitiveProxy(const PrimitiveProxy2D& proxy)
+{
+	if (!(*proxy.status & 0b1))
+		return;
+	sync_proxy(proxy, BatchPrimitive(*proxy.render));
+	PoolOverAll(*proxy.render);
+}
+
+TextureSlot CanvasLayer::BatchPrimitive(const Renderable& render)
+{
+	if (currentDrawMode != DrawMode::PRIMITIVE)
+	{
+		FlushAndReset();
+		currentDrawMode = DrawMode::PRIMITIVE;
+	}
+	if (render.model != currentModel || !BatchSharesLexicon(render.uniformLexicon))
+	{
+		SendTriangles();
+		SetBatchModel(render.model);
+		SetUniformLexicon(render.uniformLexicon);
+	}
+	else if (m_Data.maxVertexPoolSize - PooledVertexCount() < Render::VertexBufferLayoutCount(render)
+			|| m_Data.maxIndexPoolSize - PooledIndexCount() < render.indexCount)
+	{
+		SendTriangles();
+	}
+	return GetTextureSlot(render);
+}
+
+TextureSlot CanvasLayer::BatchRect(const Renderable& renderable)
 {
 	if (currentDrawMode != DrawMode::RECT)
 	{
@@ -219,30 +389,28 @@ void CanvasLayer::DrawRect(const Renderable& renderable, const Functor<void, Tex
 		SendRects();
 		rectBatcher.draw_count = 1;
 	}
-	if (renderable.model != currentModel || !currentLexicon.Shares(renderable.uniformLexicon))
+	if (renderable.model != currentModel || !BatchSharesLexicon(renderable.uniformLexicon))
 	{
 		SendRects();
 		rectBatcher.draw_count = 1;
 		SetBatchModel(renderable.model);
 		SetUniformLexicon(renderable.uniformLexicon);
 	}
-	else if (m_Data.maxVertexPoolSize - (vertexPos - m_VertexPool) < Render::VertexBufferLayoutCount(renderable)
-		|| m_Data.maxIndexPoolSize - (indexPos - m_IndexPool) < renderable.indexCount)
+	else if (m_Data.maxVertexPoolSize - PooledVertexCount() < Render::VertexBufferLayoutCount(renderable)
+		|| m_Data.maxIndexPoolSize - PooledIndexCount() < renderable.indexCount)
 	{
 		SendRects();
 		rectBatcher.draw_count = 1;
 	}
-	on_draw_callback(GetTextureSlot(renderable));
-	PoolOverVertexBuffer(renderable);
-	PoolOverLexicon(renderable.uniformLexicon);
+	return GetTextureSlot(renderable);
 }
 
-void CanvasLayer::SetBlending() const
+void CanvasLayer::SetBlending(const LayerSnapshot2D& snapshot)
 {
-	if (m_Data.enableGLBlend)
+	if (snapshot.enableGLBlend)
 	{
 		PULSAR_TRY(glEnable(GL_BLEND));
-		PULSAR_TRY(glBlendFunc(m_Data.sourceBlend, m_Data.destBlend));
+		PULSAR_TRY(glBlendFunc(snapshot.sourceBlend, snapshot.destBlend));
 	}
 	else
 	{
@@ -253,14 +421,18 @@ void CanvasLayer::SetBlending() const
 void CanvasLayer::SetBatchModel(const BatchModel& model)
 {
 	currentModel = model;
-	if (m_VAOs.find(currentModel) == m_VAOs.end())
-		RegisterModel();
+	char attrib = Renderer::Shaders().ModulationAttrib(model.shader);
+	if (attrib < 0 || !Render::AttribOf(model.layout, model.layoutMask, attrib, m_ModulationOffset, m_ModulationWidth))
+		m_ModulationWidth = 0;
+	attrib = Renderer::Shaders().TexCoordAttrib(model.shader);
+	if (attrib < 0 || !Render::AttribOf(model.layout, model.layoutMask, attrib, m_TexCoordOffset, m_TexCoordWidth))
+		m_TexCoordWidth = 0;
 }
 
 void CanvasLayer::SetUniformLexicon(UniformLexiconHandle lexicon)
 {
-	currentLexicon.Clear();
-	currentLexicon.MergeLexicon(lexicon);
+	m_LexiconBatch.clear();
+	PoolOverLexicon(lexicon);
 }
 
 // NOTE If buffer data is too large to fit in corresponding pool, it will not be rendered.
@@ -275,26 +447,99 @@ void CanvasLayer::PoolOverAll(const Renderable& renderable)
 
 void CanvasLayer::PoolOverIndexBuffer(const Renderable& renderable)
 {
+	size_t first = m_Recording->indexPool.size();
 	if (renderable.indexBufferData)
-		memcpy_s(indexPos, (m_Data.maxIndexPoolSize - (indexPos - m_IndexPool)) * sizeof(VertexSize),
-			renderable.indexBufferData, renderable.indexCount * sizeof(GLuint));
+		m_Recording->indexPool.insert(m_Recording->indexPool.end(), renderable.indexBufferData, renderable.indexBufferData + renderable.indexCount);
+	else
+		m_Recording->indexPool.resize(first + renderable.indexCount);
 	if (renderable.vertexCount)
-		for (size_t ic = 0; ic < renderable.indexCount; ic++)
-			*(indexPos + ic) += (GLuint)(vertexPos - m_VertexPool) / Render::StrideCountOf(renderable.model.layout, renderable.model.layoutMask);
-	indexPos += renderable.indexCount;
+	{
+		GLuint offset = (GLuint)PooledVertexCount() / Render::StrideCountOf(renderable.model.layout, renderable.model.layoutMask);
+		for (size_t ic = first; ic < m_Recording->indexPool.size(); ic++)
+			m_Recording->indexPool[ic] += offset;
+	}
+}
+
+// Whether any vertex carries a modulation color other than white. Unknown modulation attributes are assumed to be modulated.
+static bool is_modulated(const Renderable& renderable, Stride offset, Stride width)
+{
+	if (width == 0 || !renderable.vertexBufferData)
+		return width == 0;
+	Stride stride = Render::StrideCountOf(renderable.model.layout, renderable.model.layoutMask);
+	const GLfloat* color = renderable.vertexBufferData + offset;
+	for (VertexBufferCounter v = 0; v < renderable.vertexCount; ++v, color += stride)
+	{
+		for (Stride c = 0; c < width; ++c)
+		{
+			if (color[c] != 1.0f)
+				return true;
+		}
+	}
+	return false;
 }
 
 void CanvasLayer::PoolOverVertexBuffer(const Renderable& renderable)
 {
+	VertexBufferCounter count = Render::VertexBufferLayoutCount(renderable);
+	size_t first = m_Recording->vertexPool.size();
 	if (renderable.vertexBufferData)
-		memcpy_s(vertexPos, (m_Data.maxVertexPoolSize - (vertexPos - m_VertexPool)) * sizeof(VertexSize),
-			renderable.vertexBufferData, Render::VertexBufferLayoutCount(renderable) * sizeof(GLfloat));
-	vertexPos += Render::VertexBufferLayoutCount(renderable);
+		m_Recording->vertexPool.insert(m_Recording->vertexPool.end(), renderable.vertexBufferData, renderable.vertexBufferData + count);
+	else
+		m_Recording->vertexPool.resize(m_Recording->vertexPool.size() + count);
+	if (m_AtlasRemap)
+		RemapAtlasUVs(renderable, first);
+	if (!m_BatchModulated)
+		m_BatchModulated = is_modulated(renderable, m_ModulationOffset, m_ModulationWidth);
+}
+
+// Maps the UVs of the pooled vertices, which actors keep relative to the region's image, into the region's rect in its page.
+// The UVs are found through the texcoord attribute of the batch's shader. Without one, they are left as they are.
+void CanvasLayer::RemapAtlasUVs(const Renderable& renderable, size_t first)
+{
+	m_AtlasRemap = false;
+	if (m_TexCoordWidth < 2)
+		return;
+	Stride stride = Render::StrideCountOf(renderable.model.layout, renderable.model.layoutMask);
+	Stride uv = m_TexCoordOffset;
+	for (size_t v = first; v + uv + 1 < m_Recording->vertexPool.size(); v += stride)
+	{
+		m_Recording->vertexPool[v + uv] = m_AtlasUVRect.x + m_Recording->vertexPool[v + uv] * m_AtlasUVRect.z;
+		m_Recording->vertexPool[v + uv + 1] = m_AtlasUVRect.y + m_Recording->vertexPool[v + uv + 1] * m_AtlasUVRect.w;
+	}
 }
 
+// Lexicons are only referenced while batching. Their uniforms are copied into the snapshot once the batch is recorded.
 void CanvasLayer::PoolOverLexicon(UniformLexiconHandle lexicon)
 {
-	currentLexicon.MergeLexicon(lexicon);
+	if (lexicon != 0 && std::find(m_LexiconBatch.begin(), m_LexiconBatch.end(), lexicon) == m_LexiconBatch.end())
+		m_LexiconBatch.push_back(lexicon);
+}
+
+// Whether every uniform of lexicon either is absent from the batch, or has the same value as in the batch.
+bool CanvasLayer::BatchSharesLexicon(UniformLexiconHandle lexicon) const
+{
+	if (lexicon == 0 || m_LexiconBatch.empty())
+		return true;
+	UniformLexicon const* other = Renderer::UniformLexicons().Get(lexicon);
+	if (!other)
+		return true;
+	for (const auto& [name, uniform] : other->m_Uniforms)
+	{
+		for (UniformLexiconHandle handle : m_LexiconBatch)
+		{
+			UniformLexicon const* merged = Renderer::UniformLexicons().Get(handle);
+			if (!merged)
+				continue;
+			auto iter = merged->m_Uniforms.find(name);
+			if (iter != merged->m_Uniforms.end())
+			{
+				if (iter->second != uniform)
+					return false;
+				break;
+			}
+		}
+	}
+	return true;
 }
 
 void CanvasLayer::FlushAndReset()
@@ -307,96 +552,145 @@ void CanvasLayer::FlushAndReset()
 
 TextureSlot CanvasLayer::GetTextureSlot(const Renderable& render)
 {
+	m_AtlasRemap = false;
 	if (render.textureHandle == 0) // no texture
+	{
+		m_BatchUntextured = true;
 		return -1;
+	}
+	// dynamic atlas regions are batched as their page, so that regions of one page share a slot
+	TextureBinding binding{ render.textureHandle, render.samplerHandle };
+	AtlasRegion region;
+	if (Renderer::Atlases().GetRegion(binding.texture, region))
+	{
+		binding.texture = region.page;
+		m_AtlasRemap = true;
+		m_AtlasUVRect = region.uvRect;
+	}
 	for (auto it = m_TextureSlotBatch.begin(); it != m_TextureSlotBatch.end(); it++)
 	{
-		if (*it == render.textureHandle)
+		if (*it == binding)
 			return static_cast<TextureSlot>(it - m_TextureSlotBatch.begin());
 	}
 	if (m_TextureSlotBatch.size() >= PulsarSettings::max_texture_slots())
 		FlushAndReset();
 	TextureSlot slot = static_cast<TextureSlot>(m_TextureSlotBatch.size());
-	m_TextureSlotBatch.push_back(render.textureHandle);
+	m_TextureSlotBatch.push_back(binding);
+	// once per texture and batch, which keeps the texture resident, or reloads it if it was evicted
+	m_Touched.push_back(binding.texture);
 	return slot;
 }
 
-void CanvasLayer::RegisterModel()
-{
-	GLuint vao;
-	PULSAR_TRY(glGenVertexArrays(1, &vao));
-	BindVertexArray(vao);
-	Render::_AttribLayout(currentModel.layout, currentModel.layoutMask);
-	UnbindVertexArray();
-	m_VAOs[currentModel] = vao;
-}
-
-void CanvasLayer::BindVertexArray(GLuint vao) const
+// Picks the cheapest permutation of the model's shader that can draw the pooled batch. The variant itself is resolved on submission.
+ShaderVariant CanvasLayer::BatchVariant() const
 {
-	// order of these calls is crucial
-	PULSAR_TRY(glBindVertexArray(vao));
-	PULSAR_TRY(glBindBuffer(GL_ARRAY_BUFFER, m_VB));
-	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IB));
+	ShaderVariant variant = 0;
+	if (m_TextureSlotBatch.empty())
+		variant |= SHADER_VARIANT_UNTEXTURED;
+	else if (m_TextureSlotBatch.size() == 1 && !m_BatchUntextured)
+		variant |= SHADER_VARIANT_SINGLE_TEXTURE;
+	if (!m_BatchModulated)
+		variant |= SHADER_VARIANT_UNMODULATED;
+	return variant;
 }
 
-void CanvasLayer::UnbindVertexArray() const
+DrawCommand2D& CanvasLayer::RecordCommand(DrawMode mode, bool bind_textures)
 {
-	// order of these calls is crucial
-	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-	PULSAR_TRY(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	PULSAR_TRY(glBindVertexArray(0));
+	DrawCommand2D& command = m_Recording->commands.emplace_back();
+	command.mode = mode;
+	command.model = currentModel;
+	command.variant = BatchVariant();
+	auto& uniforms = m_Recording->uniforms;
+	command.firstUniform = m_Recording->pooledUniforms;
+	for (size_t i = 0; i < m_LexiconBatch.size(); ++i)
+	{
+		UniformLexicon const* lexicon = Renderer::UniformLexicons().Get(m_LexiconBatch[i]);
+		if (!lexicon)
+			continue;
+		for (const auto& [name, uniform] : lexicon->m_Uniforms)
+		{
+			auto begin = uniforms.begin() + command.firstUniform;
+			auto end = uniforms.begin() + m_Recording->pooledUniforms;
+			if (std::find_if(begin, end, [&name](const auto& pooled) { return pooled.first == name; }) != end)
+				continue;
+			if (m_Recording->pooledUniforms < uniforms.size())
+			{
+				uniforms[m_Recording->pooledUniforms].first.assign(name);
+				uniforms[m_Recording->pooledUniforms].second = uniform;
+			}
+			else
+				uniforms.emplace_back(name, uniform);
+			++m_Recording->pooledUniforms;
+		}
+	}
+	command.uniformCount = m_Recording->pooledUniforms - command.firstUniform;
+	command.firstVertex = vertexBatch;
+	command.vertexCount = PooledVertexCount();
+	command.firstIndex = indexBatch;
+	command.indexCount = PooledIndexCount();
+	command.firstTexture = m_Recording->textures.size();
+	command.textureCount = bind_textures ? m_TextureSlotBatch.size() : 0;
+	if (bind_textures)
+		m_Recording->textures.insert(m_Recording->textures.end(), m_TextureSlotBatch.begin(), m_TextureSlotBatch.end());
+	return command;
 }
 
-void CanvasLayer::OpenShading() const
+void CanvasLayer::SubmitCommand(const LayerSnapshot2D& snapshot, const DrawCommand2D& command)
 {
 	// order of these calls is crucial
-	BindVertexArray(m_VAOs.find(currentModel)->second);
-	Renderer::Shaders().Bind(currentModel.shader);
-	m_LayerView.PassVPUniform(currentModel.shader);
-	currentLexicon.OnApply(currentModel.shader);
-}
-
-void CanvasLayer::CloseShading() const
-{
+	ShaderHandle shader = Renderer::Shaders().Variant(command.model.shader, command.variant);
+	Renderer::Arena().BindModel(command.model);
+	Renderer::Shaders().Bind(shader);
+	pass_vp_uniform(shader, snapshot.vp);
+	for (size_t i = 0; i < command.uniformCount; ++i)
+		UniformLexicon::ApplyUniform(shader, snapshot.uniforms[command.firstUniform + i].first.c_str(), snapshot.uniforms[command.firstUniform + i].second);
+	for (size_t i = 0; i < command.textureCount; ++i)
+	{
+		// NOTE due to the abstraction of glDrawElements and glBufferSubData behind CanvasLayer, there is currently no need to actually call TextureRegistry::Unbind on anything.
+		const TextureBinding& binding = snapshot.textures[command.firstTexture + i];
+		Renderer::Textures().Bind(binding.texture, static_cast<TextureSlot>(i), binding.sampler);
+	}
+	Renderer::Arena().StreamVertices(snapshot.vertexPool.data() + command.firstVertex, command.vertexCount);
+	switch (command.mode)
+	{
+	case DrawMode::PRIMITIVE:
+	{
+		GLintptr index_offset = Renderer::Arena().StreamIndexes(snapshot.indexPool.data() + command.firstIndex, command.indexCount);
+		PULSAR_TRY(glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(command.indexCount), GL_UNSIGNED_INT, (const GLvoid*)index_offset));
+		break;
+	}
+	case DrawMode::ARRAY:
+		PULSAR_TRY(glDrawArrays(command.indexingMode, 0, command.drawCount));
+		break;
+	case DrawMode::MULTI_ARRAY:
+		PULSAR_TRY(glMultiDrawArrays(command.indexingMode, snapshot.multiFirsts.data() + command.firstMulti, snapshot.multiCounts.data() + command.firstMulti, command.drawCount));
+		break;
+	case DrawMode::RECT:
+		reserve_rects(command.drawCount);
+		PULSAR_TRY(glMultiDrawArrays(GL_TRIANGLE_FAN, rect_firsts.data(), rect_counts.data(), command.drawCount));
+		break;
+	default:
+		break;
+	}
 	Renderer::Shaders().Unbind();
-	UnbindVertexArray();
+	Renderer::Arena().Unbind();
 }
 
 void CanvasLayer::ResetPoolsAndLexicon()
 {
-	vertexPos = m_VertexPool;
-	indexPos = m_IndexPool;
-	currentLexicon.Clear();
-}
-
-void CanvasLayer::BindTextureSlots() const
-{
-	for (auto it = m_TextureSlotBatch.begin(); it != m_TextureSlotBatch.end(); it++)
-		// NOTE due to the abstraction of glDrawElements and glBufferSubData behind CanvasLayer, there is currently no need to actually call TextureRegistry::Unbind on anything.
-		Renderer::Textures().Bind(*it, (TextureSlot)(it - m_TextureSlotBatch.begin()));
-}
-
-void CanvasLayer::SendVertexPool() const
-{
-	PULSAR_TRY(glBufferSubData(GL_ARRAY_BUFFER, 0, (vertexPos - m_VertexPool) * sizeof(GLfloat), m_VertexPool));
-}
-
-void CanvasLayer::SendIndexPool() const
-{
-	PULSAR_TRY(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, (indexPos - m_IndexPool) * sizeof(GLuint), m_IndexPool));
+	vertexBatch = m_Recording->vertexPool.size();
+	indexBatch = m_Recording->indexPool.size();
+	m_LexiconBatch.clear();
+	m_BatchUntextured = false;
+	m_BatchModulated = false;
 }
 
 void CanvasLayer::SendTriangles()
 {
-	if (vertexPos - m_VertexPool > 0)
+	if (PooledVertexCount() > 0)
 	{
-		PULSAR_ASSERT(indexPos - m_IndexPool > 0);
-		OpenShading();
-		BindTextureSlots();
-		SendVertexPool();
-		SendIndexPool();
-		PULSAR_TRY(glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexPos - m_IndexPool), GL_UNSIGNED_INT, nullptr));
-		CloseShading();
+		PULSAR_ASSERT(PooledIndexCount() > 0);
+		RecordCommand(DrawMode::PRIMITIVE, true);
 		ResetPoolsAndLexicon();
 		m_TextureSlotBatch.clear();
 	}
@@ -404,38 +698,36 @@ void CanvasLayer::SendTriangles()
 
 void CanvasLayer::SendArray(const Renderable& renderable, GLenum indexing_mode)
 {
-	if (vertexPos - m_VertexPool > 0)
+	if (PooledVertexCount() > 0)
 	{
-		OpenShading();
-		SendVertexPool();
-		PULSAR_TRY(glDrawArrays(indexing_mode, 0, renderable.vertexCount));
-		CloseShading();
+		DrawCommand2D& command = RecordCommand(DrawMode::ARRAY, false);
+		command.indexingMode = indexing_mode;
+		command.drawCount = renderable.vertexCount;
 		ResetPoolsAndLexicon();
 	}
 }
 
 void CanvasLayer::SendMultiArray(DebugMultiPolygon* multi_polygon)
 {
-	if (vertexPos - m_VertexPool > 0)
+	if (PooledVertexCount() > 0)
 	{
-		OpenShading();
-		SendVertexPool();
-		PULSAR_TRY(glMultiDrawArrays(multi_polygon->m_IndexMode, multi_polygon->indexes_ptr, multi_polygon->index_counts_ptr, multi_polygon->DrawCount()));
-		CloseShading();
+		DrawCommand2D& command = RecordCommand(DrawMode::MULTI_ARRAY, false);
+		command.indexingMode = multi_polygon->m_IndexMode;
+		command.drawCount = multi_polygon->DrawCount();
+		command.firstMulti = m_Recording->multiFirsts.size();
+		m_Recording->multiFirsts.insert(m_Recording->multiFirsts.end(), multi_polygon->indexes_ptr, multi_polygon->indexes_ptr + command.drawCount);
+		m_Recording->multiCounts.insert(m_Recording->multiCounts.end(), multi_polygon->index_counts_ptr, multi_polygon->index_counts_ptr + command.drawCount);
 		ResetPoolsAndLexicon();
 	}
 }
 
 void CanvasLayer::SendRects()
 {
-	if (vertexPos - m_VertexPool > 0)
+	if (PooledVertexCount() > 0)
 	{
-		OpenShading();
-		BindTextureSlots();
-		SendVertexPool();
-		PULSAR_TRY(glMultiDrawArrays(GL_TRIANGLE_FAN, rectBatcher.indexes.data(), rectBatcher.index_counts.data(), rectBatcher.draw_count));
+		DrawCommand2D& command = RecordCommand(DrawMode::RECT, true);
+		command.drawCount = rectBatcher.draw_count;
 		rectBatcher.draw_count = 0;
-		CloseShading();
 		ResetPoolsAndLexicon();
 		m_TextureSlotBatch.clear();
 	}
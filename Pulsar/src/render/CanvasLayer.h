@@ -1,14 +1,15 @@
 #pragma once
 
 #include <GL/glew.h>
-#include <map>
-#include <list>
+#include <string>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include "PulsarSettings.h"
+#include "utils/FrameArena.h"
 #include "utils/Functor.inl"
 #include "ActorRenderBase.h"
 #include "LayerView.h"
@@ -25,15 +26,13 @@ struct CanvasLayerData
 	int pLeft, pRight, pBottom, pTop;
 	VertexSize maxVertexPoolSize, maxIndexPoolSize;
 	CanvasLayerData(CanvasIndex ci, VertexSize max_vertex_pool_size = 0, VertexSize max_index_pool_size = 0)
-		: ci(ci), enableGLBlend(true), sourceBlend(GL_SRC_ALPHA), destBlend(GL_ONE_MINUS_SRC_ALPHA),
+		: ci(ci), enableGLBlend(true), sourceBlend(PulsarSettings::premultiplied_alpha() ? GL_ONE : GL_SRC_ALPHA), destBlend(GL_ONE_MINUS_SRC_ALPHA),
 		pLeft(0), pRight(PulsarSettings::initial_window_width()), pBottom(0), pTop(PulsarSettings::initial_window_height()),
 		maxVertexPoolSize(max_vertex_pool_size > 0 ? max_vertex_pool_size : PulsarSettings::standard_vertex_pool_size()),
 		maxIndexPoolSize(max_index_pool_size > 0 ? max_index_pool_size : PulsarSettings::standard_index_pool_size())
 	{}
 };
 
-typedef GLuint VAO;
-
 enum class DrawMode : unsigned char
 {
 	VOID,
@@ -43,12 +42,11 @@ enum class DrawMode : unsigned char
 	RECT
 };
 
+// Tracks how many rects the current batch holds. The { 0, 4, 8, ... } and { 4, 4, 4, ... } arrays passed to glMultiDrawArrays are shared and grown on submission.
 class RectBatcher
 {
 	friend class CanvasLayer;
 
-	std::vector<GLint> indexes; // { 0, 4, 8, ... }
-	std::vector<GLsizei> index_counts; // { 4, 4, 4, ... }
 	GLsizei draw_count = 0;
 	GLsizei size = 0;
 
@@ -57,23 +55,99 @@ class RectBatcher
 	bool try_increment();
 };
 
+// Compact, non-owning view of an ActorPrimitive2D's draw state, stored contiguously by the canvas layer.
+struct PrimitiveProxy2D
+{
+	class ActorPrimitive2D* actor;
+	Renderable* render;
+	const unsigned char* status;
+};
+
+// Flat batcher entry. The sort key orders entries by ZIndex, then proxy type and shader, then attach order.
+struct DrawEntry2D
+{
+	unsigned long long key;
+	ActorRenderBase2D* actor;
+	PrimitiveProxy2D proxy;
+	RenderProxyType type;
+};
+
+// A texture slot of a batch. A sampler of 0 samples the texture with its own settings.
+struct TextureBinding
+{
+	TextureHandle texture = 0;
+	SamplerHandle sampler = 0;
+
+	bool operator==(const TextureBinding&) const = default;
+};
+
+// A recorded batch. Vertex, index, texture and multi-array ranges refer to the pools of the snapshot it was recorded into.
+struct DrawCommand2D
+{
+	DrawMode mode = DrawMode::VOID;
+	BatchModel model;
+	ShaderVariant variant = 0;
+	size_t firstUniform = 0, uniformCount = 0;
+	size_t firstVertex = 0, vertexCount = 0;
+	size_t firstIndex = 0, indexCount = 0;
+	size_t firstTexture = 0, textureCount = 0;
+	GLenum indexingMode = GL_TRIANGLES;
+	GLsizei drawCount = 0;
+	size_t firstMulti = 0;
+};
+
+// Everything needed to submit one recorded frame of a canvas layer, independent of the actors and the layer's live state.
+// Layers keep two snapshots, so that a render thread can submit one while the next frame is recorded into the other.
+struct LayerSnapshot2D
+{
+	std::vector<GLfloat> vertexPool;
+	std::vector<GLuint> indexPool;
+	std::vector<TextureBinding> textures;
+	std::vector<GLint> multiFirsts;
+	std::vector<GLsizei> multiCounts;
+	// uniform slots past pooledUniforms are kept between frames, so that their names reuse their string buffers
+	std::vector<std::pair<std::string, Uniform>> uniforms;
+	size_t pooledUniforms = 0;
+	std::vector<DrawCommand2D> commands;
+	glm::mat3 vp;
+	bool enableGLBlend = true;
+	GLenum sourceBlend = GL_SRC_ALPHA, destBlend = GL_ONE_MINUS_SRC_ALPHA;
+
+	void Clear();
+};
+
 class CanvasLayer
 {
 	friend class Renderer;
 	CanvasLayerData m_Data;
 	LayerView2D m_LayerView;
-	std::map<ZIndex, std::list<ActorRenderBase2D*>> m_Batcher;
-	GLfloat* m_VertexPool;
-	GLfloat* vertexPos;
-	GLuint* m_IndexPool;
-	GLuint* indexPos;
-	GLuint m_VB, m_IB;
+	std::vector<DrawEntry2D> m_Batcher;
+	std::vector<DrawEntry2D> m_BatcherSortBuffer;
+	std::unordered_map<ActorRenderBase2D*, size_t> m_BatcherLookup;
+	unsigned int m_AttachSequence = 0;
+	bool m_BatcherDirty = false;
+	LayerSnapshot2D m_Snapshots[2];
+	LayerSnapshot2D* m_Recording = &m_Snapshots[0];
+	size_t vertexBatch = 0;
+	size_t indexBatch = 0;
 	BatchModel currentModel;
 	DrawMode currentDrawMode = DrawMode::VOID;
-	UniformLexicon currentLexicon;
-	std::vector<TextureHandle> m_TextureSlotBatch;
-	std::unordered_map<BatchModel, VAO> m_VAOs;
+	// lexicons merged into the current batch, in merge order. Uniforms of earlier lexicons take precedence.
+	std::vector<UniformLexiconHandle> m_LexiconBatch;
+	// texture and sampler pairs, so that one texture sampled two ways takes two slots
+	std::vector<TextureBinding> m_TextureSlotBatch;
 	RectBatcher rectBatcher;
+	bool m_BatchUntextured = false;
+	bool m_BatchModulated = false;
+	Stride m_ModulationOffset = 0;
+	Stride m_ModulationWidth = 0;
+	Stride m_TexCoordOffset = 0;
+	Stride m_TexCoordWidth = 0;
+	// set when the renderable being batched draws a dynamic atlas region, whose UVs are remapped as it is pooled
+	bool m_AtlasRemap = false;
+	glm::vec4 m_AtlasUVRect;
+	// textures batched by the last recording. Touching one may start a reload, so it is left to the main thread once recording is done.
+	std::vector<TextureHandle> m_Touched;
 
 public:
 	CanvasLayer(const CanvasLayerData& data);
@@ -86,6 +160,11 @@ public:
 	bool OnDetach(ActorRenderBase2D* const actor);
 	void Clear();
 	void OnDraw();
+	bool SharesState(const CanvasLayer& other) const;
+
+	void _Record(const frame_vector<CanvasLayer*>& layers, unsigned char snapshot = 0);
+	void _ApplyTouches();
+	void _Submit(unsigned char snapshot = 0) const;
 
 	LayerView2D& GetLayerView2DRef() { return m_LayerView; }
 	CanvasIndex GetZIndex() const { return m_Data.ci; }
@@ -97,25 +176,35 @@ public:
 	void DrawRect(const Renderable& renderable, const Functor<void, TextureSlot>& on_draw_callback);
 
 private:
-	void SetBlending() const;
+	static PrimitiveProxy2D MakeProxy(class ActorPrimitive2D*);
+	void SortBatcher();
+	void RenumberBatcher();
+	void BeginDraw();
+	void DrawBatcherOf(CanvasLayer& layer);
+	void EndDraw();
+	void DrawRectProxy(const PrimitiveProxy2D&);
+	void DrawPrimitiveProxy(const PrimitiveProxy2D&);
+	TextureSlot BatchPrimitive(const Renderable&);
+	TextureSlot BatchRect(const Renderable&);
+
+	static void SetBlending(const LayerSnapshot2D& snapshot);
 	void SetBatchModel(const BatchModel&);
 	void SetUniformLexicon(UniformLexiconHandle lexicon);
 	void PoolOverAll(const Renderable&);
 	void PoolOverIndexBuffer(const Renderable&);
 	void PoolOverVertexBuffer(const Renderable&);
+	void RemapAtlasUVs(const Renderable&, size_t first);
 	void PoolOverLexicon(UniformLexiconHandle lexicon);
+	bool BatchSharesLexicon(UniformLexiconHandle lexicon) const;
 	void FlushAndReset();
 	TextureSlot GetTextureSlot(const Renderable&);
 	
-	void RegisterModel();
-	void BindVertexArray(GLuint) const;
-	void UnbindVertexArray() const;
-	void OpenShading() const;
-	void CloseShading() const;
+	size_t PooledVertexCount() const { return m_Recording->vertexPool.size() - vertexBatch; }
+	size_t PooledIndexCount() const { return m_Recording->indexPool.size() - indexBatch; }
+	ShaderVariant BatchVariant() const;
+	DrawCommand2D& RecordCommand(DrawMode mode, bool bind_textures);
+	static void SubmitCommand(const LayerSnapshot2D& snapshot, const DrawCommand2D& command);
 	void ResetPoolsAndLexicon();
-	void BindTextureSlots() const;
-	void SendVertexPool() const;
-	void SendIndexPool() const;
 
 	void SendTriangles();
 	void SendArray(const Renderable& renderable, GLenum indexing_mode);
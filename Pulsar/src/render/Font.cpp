@@ -150,11 +150,8 @@ Font::Glyph::Glyph(Font* font, int gIndex, float scale, size_t buffer_pos)
 
 void Font::Glyph::RenderOnBitmap(unsigned char* bmp, size_t common_stride, size_t common_height, bool plus_one)
 {
-	unsigned char* temp = new unsigned char[width * height];
-	stbtt_MakeGlyphBitmap(&font->font_info, temp, width, height, width, font->scale, font->scale, gIndex);
-	for (size_t row = 0; row < height; ++row)
-		memcpy(bmp + row * common_stride, temp + row * width, width);
-	delete[] temp;
+	// rasterized straight into the common bitmap, whose stride stbtt takes
+	stbtt_MakeGlyphBitmap(&font->font_info, bmp, width, height, static_cast<int>(common_stride), font->scale, font->scale, gIndex);
 	for (size_t row = height; row < common_height; ++row)
 		memset(bmp + row * common_stride, 0x0, width);
 	if (plus_one)
@@ -278,6 +275,9 @@ bool Font::Cache(Fonts::Codepoint codepoint)
 		return true;
 	if (int gIndex = stbtt_FindGlyphIndex(&font_info, codepoint))
 	{
+		// glyph textures can only be created on the GL thread
+		if (!LayerRecorder::RequireGLContext())
+			return false;
 		Font::Glyph glyph(this, gIndex, scale, -1);
 		unsigned char* bmp = new unsigned char[glyph.Area()];
 		glyph.RenderOnBitmap(bmp);
@@ -461,7 +461,9 @@ void TextRender::FormattingData::NextLine(const TextRender& text_render)
 
 void TextRender::FormattingData::KerningAdvanceX(const TextRender& text_render, const Font::Glyph& glyph, Fonts::Codepoint codepoint)
 {
-	x += text_render.font->KerningOf(prev_codepoint, codepoint, text_render.font->glyphs[prev_codepoint].gIndex, glyph.gIndex, line.mul_x);
+	// lookups during drawing must not insert, since canvas layers may be recorded concurrently
+	auto prev = text_render.font->glyphs.find(prev_codepoint);
+	x += text_render.font->KerningOf(prev_codepoint, codepoint, prev != text_render.font->glyphs.end() ? prev->second.gIndex : 0, glyph.gIndex, line.mul_x);
 }
 
 void TextRender::RequestDraw(CanvasLayer* canvas_layer)
@@ -487,7 +489,7 @@ void TextRender::RequestDraw(CanvasLayer* canvas_layer)
 			formatting.NextLine(*this);
 		else if (font->Cache(codepoint))
 		{
-			const Font::Glyph& glyph = font->glyphs[codepoint];
+			const Font::Glyph& glyph = font->glyphs.find(codepoint)->second;
 			formatting.KerningAdvanceX(*this, glyph, codepoint);
 			DrawGlyph(glyph, formatting.x, formatting.y, canvas_layer);
 			formatting.AdvanceX(glyph.advance_width * font->scale * formatting.line.mul_x, codepoint);
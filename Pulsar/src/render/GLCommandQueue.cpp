@@ -0,0 +1,39 @@
+#include "GLCommandQueue.h"
+
+#include <chrono>
+
+void GLCommandQueue::Enqueue(std::function<void()>&& command)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Commands.push_back(std::move(command));
+}
+
+// Runs commands in submission order until the budget is spent. At least one command is run, so the queue always makes progress.
+// Returns the number of commands run.
+size_t GLCommandQueue::Drain(float budget_ms)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t count = 0;
+	while (true)
+	{
+		std::function<void()> command;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Commands.empty())
+				break;
+			command = std::move(m_Commands.front());
+			m_Commands.pop_front();
+		}
+		command();
+		++count;
+		if (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() >= budget_ms)
+			break;
+	}
+	return count;
+}
+
+size_t GLCommandQueue::Size()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Commands.size();
+}
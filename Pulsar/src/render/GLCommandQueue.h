@@ -0,0 +1,21 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Multi-producer queue of GL work. Any thread may enqueue, and the thread owning the GL context drains it once per frame.
+class GLCommandQueue
+{
+	std::deque<std::function<void()>> m_Commands;
+	std::mutex m_Mutex;
+
+public:
+	GLCommandQueue() = default;
+	GLCommandQueue(const GLCommandQueue&) = delete;
+	GLCommandQueue(GLCommandQueue&&) = delete;
+
+	void Enqueue(std::function<void()>&& command);
+	size_t Drain(float budget_ms);
+	size_t Size();
+};
@@ -0,0 +1,116 @@
+#include "GLDebug.h"
+
+#include <cstring>
+#include <vector>
+
+#include "Logger.inl"
+#include "Macros.h"
+
+static bool enabled = false;
+
+// Groups pushed on the current thread, innermost last. Messages are tagged with them.
+static thread_local std::vector<std::string> group_stack;
+
+static const char* source_name(GLenum source)
+{
+	switch (source)
+	{
+	case GL_DEBUG_SOURCE_API: return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+	case GL_DEBUG_SOURCE_APPLICATION: return "application";
+	default: return "other";
+	}
+}
+
+static const char* type_name(GLenum type)
+{
+	switch (type)
+	{
+	case GL_DEBUG_TYPE_ERROR: return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+	default: return "other";
+	}
+}
+
+static void GLAPIENTRY message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void*)
+{
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION || type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP)
+		return;
+	std::string text = std::string("GL ") + type_name(type) + " (" + source_name(source) + " #" + std::to_string(id) + "): "
+		+ std::string(message, length >= 0 ? length : strlen(message));
+	if (!group_stack.empty())
+	{
+		text += " [in ";
+		for (size_t i = 0; i < group_stack.size(); ++i)
+		{
+			if (i > 0)
+				text += " > ";
+			text += group_stack[i];
+		}
+		text += "]";
+	}
+	if (severity == GL_DEBUG_SEVERITY_HIGH || type == GL_DEBUG_TYPE_ERROR)
+		Logger::LogError(text);
+	else
+		Logger::LogWarning(text);
+}
+
+void GLDebug::Init(bool synchronous)
+{
+	enabled = false;
+	if (!GLEW_KHR_debug && !GLEW_VERSION_4_3)
+	{
+		Logger::LogWarning("KHR_debug is not supported: GL validation is disabled.");
+		return;
+	}
+	GLint flags = 0;
+	PULSAR_TRY(glGetIntegerv(GL_CONTEXT_FLAGS, &flags));
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+		Logger::LogWarning("GL context is not a debug context: the driver may report few messages.");
+	PULSAR_TRY(glEnable(GL_DEBUG_OUTPUT));
+	if (synchronous)
+	{
+		PULSAR_TRY(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+	}
+	else
+	{
+		PULSAR_TRY(glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+	}
+	PULSAR_TRY(glDebugMessageCallback(message_callback, nullptr));
+	PULSAR_TRY(glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE));
+	enabled = true;
+}
+
+bool GLDebug::Enabled()
+{
+	return enabled;
+}
+
+void GLDebug::Label(GLenum identifier, GLuint name, const std::string& label)
+{
+	if (enabled && name)
+	{
+		PULSAR_TRY(glObjectLabel(identifier, name, static_cast<GLsizei>(label.size()), label.c_str()));
+	}
+}
+
+void GLDebug::PushGroup(const std::string& name)
+{
+	if (!enabled)
+		return;
+	group_stack.push_back(name);
+	PULSAR_TRY(glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, static_cast<GLsizei>(name.size()), name.c_str()));
+}
+
+void GLDebug::PopGroup()
+{
+	if (!enabled || group_stack.empty())
+		return;
+	PULSAR_TRY(glPopDebugGroup());
+	group_stack.pop_back();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <GL/glew.h>
+
+// Validation on top of KHR_debug. The driver reports errors through a message callback, so PULSAR_TRY need not poll glGetError.
+// Engine buffers, textures and programs are labelled, and each canvas layer submission is wrapped in a debug group, so that messages name the objects involved.
+// Synchronous output makes the callback run inside the offending call, on the thread owning the context. Otherwise, the group stack in messages may be stale.
+namespace GLDebug {
+
+	// Must be called with the context current. Has no effect if the context does not support KHR_debug.
+	void Init(bool synchronous);
+	bool Enabled();
+
+	void Label(GLenum identifier, GLuint name, const std::string& label);
+	void PushGroup(const std::string& name);
+	void PopGroup();
+
+}
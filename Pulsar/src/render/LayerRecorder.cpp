@@ -0,0 +1,46 @@
+#include "LayerRecorder.h"
+
+#include "CanvasLayer.h"
+#include "JobSystem.h"
+
+// Set while the current thread records a group in parallel. GL work is then deferred by bailing the group.
+static thread_local bool* bail_flag = nullptr;
+
+void LayerRecorder::Record(std::vector<RecordingGroup>& groups, unsigned char snapshot)
+{
+	if (JobSystem::Serial() || groups.size() < 2)
+	{
+		for (auto& group : groups)
+		{
+			group.submission->_Record(group.layers, snapshot);
+			group.submission->_ApplyTouches();
+		}
+		return;
+	}
+	for (auto& group : groups)
+		group.bailed = false;
+	JobSystem::ParallelFor(groups.size(), 1, [&groups, snapshot](size_t begin, size_t end) {
+		// recording may wait on nested jobs, which can record another group on this thread in the meantime
+		bool* outer_flag = bail_flag;
+		for (size_t i = begin; i < end; ++i)
+		{
+			bail_flag = &groups[i].bailed;
+			groups[i].submission->_Record(groups[i].layers, snapshot);
+		}
+		bail_flag = outer_flag;
+	});
+	for (auto& group : groups)
+	{
+		if (group.bailed)
+			group.submission->_Record(group.layers, snapshot);
+		group.submission->_ApplyTouches();
+	}
+}
+
+bool LayerRecorder::RequireGLContext()
+{
+	if (!bail_flag)
+		return true;
+	*bail_flag = true;
+	return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "utils/FrameArena.h"
+
+class CanvasLayer;
+
+// Consecutive canvas layers that are recorded into, and submitted by, the first layer of the group.
+struct RecordingGroup
+{
+	CanvasLayer* submission;
+	frame_vector<CanvasLayer*> layers;
+	bool bailed = false;
+};
+
+// Records canvas layer groups in parallel as jobs on the JobSystem. The calling thread participates as well.
+// Groups write only to their own submission layer, so the recorded command lists are identical to serial recording.
+// Recording code that needs the GL context calls RequireGLContext(). If it fails, the group is recorded again serially once all jobs are done.
+// Textures batched by a group are touched on the calling thread once recording is done, since touching may start a reload.
+// Dynamic atlas regions only move while the main thread waits on the GL thread before recording (see Renderer::_Maintain), so lookups during recording are stable.
+// NOTE an actor must not be attached to more than one canvas layer, since groups are recorded concurrently.
+class LayerRecorder
+{
+public:
+	static void Record(std::vector<RecordingGroup>& groups, unsigned char snapshot);
+
+	static bool RequireGLContext();
+};
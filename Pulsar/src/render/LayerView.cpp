@@ -2,8 +2,6 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "registry/Shader.h"
-#include "Renderer.h"
 #include "transform/Transforms.h"
 
 LayerView2D::LayerView2D(float pLeft, float pRight, float pBottom, float pTop)
@@ -12,17 +10,7 @@ LayerView2D::LayerView2D(float pLeft, float pRight, float pBottom, float pTop)
 	UpdateVP();
 }
 
-void LayerView2D::PassVPUniform(ShaderHandle handle) const
-{
-	if (shaderCache.find(handle) == shaderCache.end())
-	{
-		Renderer::Shaders().SetUniformMatrix3fv(handle, "u_VP", &m_VP[0][0]);
-		shaderCache.insert(handle);
-	}
-}
-
 void LayerView2D::UpdateVP()
 {
 	m_VP = m_ProjectionMatrix * Transforms::ToInverseMatrix(m_Transform);
-	shaderCache.clear();
 }
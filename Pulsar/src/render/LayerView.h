@@ -1,7 +1,5 @@
 #pragma once
 
-#include <unordered_set>
-
 #include <glm/glm.hpp>
 
 #include "Handles.inl"
@@ -12,7 +10,6 @@ class LayerView2D
 {
 	glm::mat3 m_ProjectionMatrix;
 	glm::mat3 m_VP;
-	mutable std::unordered_set<ShaderHandle> shaderCache;
 
 public:
 	LayerView2D(float pLeft, float pRight, float pBottom, float pTop);
@@ -21,9 +18,9 @@ public:
 
 	Transform2D m_Transform;
 	void NotifyTransform() { UpdateVP(); }
+	bool SharesView(const LayerView2D& other) const { return m_VP == other.m_VP; }
 
 private:
 	friend class CanvasLayer;
-	void PassVPUniform(ShaderHandle) const;
 	void UpdateVP();
 };
@@ -0,0 +1,112 @@
+#include "RenderThread.h"
+
+#include "CanvasLayer.h"
+#include "Renderer.h"
+#include "platform/WindowManager.h"
+
+RenderThread::RenderThread(WindowHandle window)
+	: m_Window(window)
+{
+	// the context can only be current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	m_Thread = std::thread(&RenderThread::Loop, this);
+	// OnThread() must be answerable on either thread before any Invoke()
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return m_Started; });
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Wake.notify_all();
+	m_Thread.join();
+	WindowManager::GetWindow(m_Window)->Focus();
+}
+
+// Hands the recorded snapshot to the render thread. Waits for the previous frame to be submitted first, which bounds latency to one frame.
+void RenderThread::Present(const frame_vector<CanvasLayer*>& submissions, unsigned char snapshot)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return !m_FramePending; });
+	m_Submissions.assign(submissions.begin(), submissions.end());
+	m_Snapshot = snapshot;
+	m_FramePending = true;
+	lock.unlock();
+	m_Wake.notify_all();
+}
+
+// Waits until no frame is in flight, after which the render thread no longer reads any snapshot.
+void RenderThread::Sync()
+{
+	if (OnThread())
+		return;
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return !m_FramePending; });
+}
+
+// Runs op on the render thread and blocks until it has completed.
+void RenderThread::Invoke(const std::function<void()>& op)
+{
+	if (OnThread())
+	{
+		op();
+		return;
+	}
+	Invocation invocation{ &op };
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Invocations.push_back(&invocation);
+	m_Wake.notify_all();
+	m_Idle.wait(lock, [&invocation]() { return invocation.done; });
+}
+
+void RenderThread::Loop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_ThreadID = std::this_thread::get_id();
+		m_Started = true;
+	}
+	m_Idle.notify_all();
+	WindowManager::GetWindow(m_Window)->Focus();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true)
+	{
+		m_Wake.wait(lock, [this]() { return m_Stopping || m_FramePending || !m_Invocations.empty(); });
+		RunInvocations(lock);
+		if (m_FramePending)
+		{
+			lock.unlock();
+			Renderer::_DrainGLQueue();
+			for (CanvasLayer* layer : m_Submissions)
+				layer->_Submit(m_Snapshot);
+			WindowManager::GetWindow(m_Window)->_ForceRefresh();
+			lock.lock();
+			m_FramePending = false;
+			m_Idle.notify_all();
+		}
+		if (m_Stopping)
+			break;
+	}
+	RunInvocations(lock);
+	lock.unlock();
+	glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::RunInvocations(std::unique_lock<std::mutex>& lock)
+{
+	while (!m_Invocations.empty())
+	{
+		m_Running.swap(m_Invocations);
+		lock.unlock();
+		for (Invocation* invocation : m_Running)
+			(*invocation->op)();
+		lock.lock();
+		for (Invocation* invocation : m_Running)
+			invocation->done = true;
+		m_Running.clear();
+		m_Idle.notify_all();
+	}
+}
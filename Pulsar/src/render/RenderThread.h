@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Handles.inl"
+#include "utils/FrameArena.h"
+
+class CanvasLayer;
+
+// Optional thread that owns the GL context and submits recorded canvas layer snapshots.
+// The main thread records frame N+1 while frame N is submitted, so presenting waits for at most one frame in flight.
+// GL work requested by other threads, such as resource creation, is handed off through Invoke() and runs between frames.
+class RenderThread
+{
+	struct Invocation
+	{
+		const std::function<void()>* op;
+		bool done = false;
+	};
+
+	std::thread m_Thread;
+	std::thread::id m_ThreadID;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Idle;
+	std::vector<Invocation*> m_Invocations;
+	std::vector<Invocation*> m_Running; // swapped with m_Invocations while they run, so neither buffer is reallocated
+	std::vector<CanvasLayer*> m_Submissions;
+	unsigned char m_Snapshot = 0;
+	bool m_FramePending = false;
+	bool m_Stopping = false;
+	bool m_Started = false;
+	WindowHandle m_Window;
+
+public:
+	RenderThread(WindowHandle window);
+	RenderThread(const RenderThread&) = delete;
+	RenderThread(RenderThread&&) = delete;
+	~RenderThread();
+
+	void Present(const frame_vector<CanvasLayer*>& submissions, unsigned char snapshot);
+	void Sync();
+	void Invoke(const std::function<void()>& op);
+	bool OnThread() const { return std::this_thread::get_id() == m_ThreadID; }
+
+private:
+	void Loop();
+	void RunInvocations(std::unique_lock<std::mutex>& lock);
+};
@@ -41,17 +41,30 @@ namespace Render
 		return stride;
 	}
 
+	// Retrieves the float offset and width of an attribute within one vertex. Returns false if the attribute is not in the layout.
+	bool AttribOf(const VertexLayout& layout, const VertexLayoutMask& mask, unsigned char attrib, Stride& offset, Stride& width)
+	{
+		if (attrib >= 16 || mask >> attrib == 0)
+			return false;
+		offset = 0;
+		for (unsigned char i = 0; i < attrib; ++i)
+			offset += ((layout & (0b11 << (2 * i))) >> (2 * i)) + 1;
+		width = ((layout & (0b11 << (2 * attrib))) >> (2 * attrib)) + 1;
+		return true;
+	}
+
+	// All attributes source from vertex binding 0, so the buffer and its offset can be rebound without touching the layout.
 	void _AttribLayout(const VertexLayout& layout, const VertexLayoutMask& mask)
 	{
 		unsigned short offset = 0;
 		unsigned char num_attribs = 0;
-		Stride stride = Render::StrideCountOf(layout, mask) * sizeof(GLfloat);
 		while (mask >> num_attribs != 0)
 		{
 			PULSAR_TRY(glEnableVertexAttribArray(num_attribs));
 			auto shift = 2 * num_attribs;
 			unsigned char attrib = ((layout & (3 << shift)) >> shift) + 1;
-			PULSAR_TRY(glVertexAttribPointer(num_attribs, attrib, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offset));
+			PULSAR_TRY(glVertexAttribFormat(num_attribs, attrib, GL_FLOAT, GL_FALSE, offset));
+			PULSAR_TRY(glVertexAttribBinding(num_attribs, 0));
 			offset += attrib * sizeof(GLfloat);
 			num_attribs++;
 		}
@@ -64,7 +77,7 @@ Renderable::Renderable(BatchModel model, TextureHandle texture_handle, UniformLe
 }
 
 Renderable::Renderable(Renderable&& other) noexcept
-	: model(other.model), textureHandle(other.textureHandle), uniformLexicon(other.uniformLexicon),
+	: model(other.model), textureHandle(other.textureHandle), samplerHandle(other.samplerHandle), uniformLexicon(other.uniformLexicon),
 	vertexBufferData(other.vertexBufferData), vertexCount(other.vertexCount), indexBufferData(other.indexBufferData), indexCount(other.indexCount)
 {
 	other.vertexBufferData = nullptr;
@@ -72,7 +85,7 @@ Renderable::Renderable(Renderable&& other) noexcept
 }
 
 Renderable::Renderable(const Renderable& other)
-	: model(other.model), textureHandle(other.textureHandle), uniformLexicon(other.uniformLexicon),
+	: model(other.model), textureHandle(other.textureHandle), samplerHandle(other.samplerHandle), uniformLexicon(other.uniformLexicon),
 	vertexBufferData(nullptr), vertexCount(other.vertexCount), indexBufferData(nullptr), indexCount(other.indexCount)
 {
 	if (other.vertexBufferData)
@@ -94,6 +107,7 @@ Renderable& Renderable::operator=(const Renderable& other)
 		return *this;
 	model = other.model;
 	textureHandle = other.textureHandle;
+	samplerHandle = other.samplerHandle;
 	uniformLexicon = other.uniformLexicon;
 	
 	if (vertexBufferData)
@@ -129,6 +143,7 @@ Renderable& Renderable::operator=(Renderable&& other) noexcept
 		return *this;
 	model = other.model;
 	textureHandle = other.textureHandle;
+	samplerHandle = other.samplerHandle;
 	uniformLexicon = other.uniformLexicon;
 	if (vertexBufferData)
 		delete[] vertexBufferData;
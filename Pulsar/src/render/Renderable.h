@@ -33,6 +33,7 @@ namespace Render
 	extern VertexBufferCounter VertexBufferLayoutCount(const Renderable&);
 	extern VertexBufferCounter VertexBufferLayoutCount(const VertexBufferCounter&, const VertexLayout&, const VertexLayoutMask&);
 	extern Stride StrideCountOf(const VertexLayout&, const VertexLayoutMask&);
+	extern bool AttribOf(const VertexLayout&, const VertexLayoutMask&, unsigned char attrib, Stride& offset, Stride& width);
 	extern void _AttribLayout(const VertexLayout&, const VertexLayoutMask&);
 }
 
@@ -40,6 +41,8 @@ struct Renderable
 {
 	BatchModel model;
 	TextureHandle textureHandle;
+	// samples the texture with other settings than its own, if not 0
+	SamplerHandle samplerHandle = 0;
 	UniformLexiconHandle uniformLexicon;
 
 	Renderable(BatchModel model = BatchModel(), TextureHandle texture_handle = 0, UniformLexiconHandle uniform_lexicon = 0);
@@ -4,6 +4,7 @@
 
 #include "Macros.h"
 #include "Logger.inl"
+#include "render/GLDebug.h"
 #include "render/actors/RectRender.h"
 #include "platform/InputManager.h"
 
@@ -17,14 +18,22 @@
 #endif // PULSAR_CHECK_INITIALIZED
 
 std::map<CanvasIndex, CanvasLayer> Renderer::layers;
+std::vector<RecordingGroup> Renderer::recording_groups;
+RenderThread* Renderer::render_thread = nullptr;
+GLCommandQueue* Renderer::gl_queue = nullptr;
+unsigned char Renderer::record_snapshot = 0;
 WindowHandle focused_window;
 
 ShaderRegistry* Renderer::shaders = nullptr;
 TextureRegistry* Renderer::textures = nullptr;
+SamplerRegistry* Renderer::samplers = nullptr;
 TileRegistry* Renderer::tiles = nullptr;
 UniformLexiconRegistry* Renderer::uniform_lexicons = nullptr;
 FontRegistry* Renderer::fonts = nullptr;
 KerningRegistry* Renderer::kernings = nullptr;
+StreamingArena* Renderer::arena = nullptr;
+TextureUploader* Renderer::uploader = nullptr;
+DynamicAtlas* Renderer::atlases = nullptr;
 
 #if !PULSAR_ASSUME_INITIALIZED
 bool uninitialized = true;
@@ -34,10 +43,16 @@ void Renderer::Init()
 {
 #if !PULSAR_ASSUME_INITIALIZED
 	uninitialized = false;
+#endif
+#if PULSAR_GL_DEBUG_OUTPUT
+	if (PulsarSettings::gl_debug_output())
+		GLDebug::Init(PulsarSettings::gl_debug_synchronous());
 #endif
 	if (!shaders)
 		shaders = new ShaderRegistry();
 	shaders->DefineStandardShader();
+	if (!samplers)
+		samplers = new SamplerRegistry();
 	if (!textures)
 		textures = new TextureRegistry();
 	if (!tiles)
@@ -48,10 +63,22 @@ void Renderer::Init()
 		fonts = new FontRegistry();
 	if (!kernings)
 		kernings = new KerningRegistry();
-	InputManager::Instance(); // TODO put somewhere else?
-	RectRender::DefineRectRenderable();
+	if (!arena)
+		arena = new StreamingArena(PulsarSettings::streaming_vertex_arena_size(), PulsarSettings::streaming_index_arena_size());
+	if (!gl_queue)
+		gl_queue = new GLCommandQueue();
+	if (!uploader)
+		uploader = new TextureUploader(PulsarSettings::texture_upload_buffer_size());
+	if (!atlases)
+		atlases = new DynamicAtlas(PulsarSettings::dynamic_atlas_page_size(), PulsarSettings::dynamic_atlas_max_size(),
+			PulsarSettings::dynamic_atlas_padding(), PulsarSettings::dynamic_atlas_defrag_threshold());
+	TextureCache::Init();
+	textures->DefineFallbackTexture();
 	PULSAR_TRY(glEnable(GL_PROGRAM_POINT_SIZE));
 	_SetClearColor();
+	// the render thread takes over the GL context, so it is started last
+	if (!render_thread && PulsarSettings::render_thread())
+		render_thread = new RenderThread(focused_window);
 }
 
 void Renderer::Terminate()
@@ -60,6 +87,18 @@ void Renderer::Terminate()
 #if !PULSAR_ASSUME_INITIALIZED
 	uninitialized = true;
 #endif
+	if (render_thread)
+	{
+		delete render_thread;
+		render_thread = nullptr;
+	}
+	// queued GL work is dropped, since the registries it refers to are about to be deleted
+	if (gl_queue)
+	{
+		delete gl_queue;
+		gl_queue = nullptr;
+	}
+	recording_groups.clear();
 	layers.clear();
 	RectRender::DestroyRectRenderable();
 	if (shaders)
@@ -67,11 +106,29 @@ void Renderer::Terminate()
 		delete shaders;
 		shaders = nullptr;
 	}
+	// page textures and tiles are left to their registries, which are deleted next
+	if (atlases)
+	{
+		delete atlases;
+		atlases = nullptr;
+	}
 	if (textures)
 	{
 		delete textures;
 		textures = nullptr;
 	}
+	// deleted after the texture registry, which waits for decode jobs that enqueue uploads
+	if (uploader)
+	{
+		delete uploader;
+		uploader = nullptr;
+	}
+	// deleted after the textures and atlas pages that refer to them
+	if (samplers)
+	{
+		delete samplers;
+		samplers = nullptr;
+	}
 	if (tiles)
 	{
 		delete tiles;
@@ -92,16 +149,92 @@ void Renderer::Terminate()
 		delete kernings;
 		kernings = nullptr;
 	}
+	if (arena)
+	{
+		delete arena;
+		arena = nullptr;
+	}
 }
 
 void Renderer::OnDraw()
 {
 	PULSAR_CHECK_INITIALIZED
+	textures->_NextFrame();
+	atlases->_NextFrame();
+	_Maintain();
+	// with a render thread, the queue is drained there before each frame is submitted
+	if (!render_thread)
+		_DrainGLQueue();
+	// consecutive layers that share view and blending continue the batches of the first such layer
+	recording_groups.clear();
 	for (auto& [z, layer] : layers)
-		layer.OnDraw();
+	{
+		if (!recording_groups.empty() && PulsarSettings::merge_canvas_layers() && recording_groups.back().submission->SharesState(layer))
+			recording_groups.back().layers.push_back(&layer);
+		else
+			recording_groups.push_back({ &layer, { &layer } });
+	}
+	// CPU recording may run in parallel, while GL submission stays serial and in canvas order
+	LayerRecorder::Record(recording_groups, record_snapshot);
+	if (render_thread)
+	{
+		frame_vector<CanvasLayer*> submissions;
+		submissions.reserve(recording_groups.size());
+		for (const auto& group : recording_groups)
+			submissions.push_back(group.submission);
+		render_thread->Present(submissions, record_snapshot);
+		record_snapshot ^= 1;
+		return;
+	}
+	for (const auto& group : recording_groups)
+		group.submission->_Submit(record_snapshot);
 	WindowManager::GetWindow(focused_window)->_ForceRefresh();
 }
 
+// Runs GL work on the thread owning the context. Without a render thread, that is the calling thread.
+void Renderer::_GLInvoke(const std::function<void()>& op)
+{
+	if (render_thread)
+		render_thread->Invoke(op);
+	else
+		op();
+}
+
+// Runs queued GL resource work and texture uploads within their per-frame budgets.
+// Must be called on the thread owning the context.
+void Renderer::_DrainGLQueue()
+{
+	gl_queue->Drain(PulsarSettings::gl_queue_budget_ms());
+	uploader->Pump(PulsarSettings::texture_upload_budget());
+}
+
+// Maintains the dynamic atlas, destroys textures passed to DestroyAsync, and evicts textures over the VRAM budget. All of them free textures that main thread callers may still point to,
+// and move regions that recorders look up, so they run before recording, once the render thread has finished its frame, while this thread waits for it.
+void Renderer::_Maintain()
+{
+	bool atlas = atlases->_NeedsMaintenance();
+	bool destroy = textures->_HasDeferredDestroys();
+	bool evict = textures->_OverBudget(PulsarSettings::texture_vram_budget());
+	if (!atlas && !destroy && !evict)
+		return;
+	_SyncRenderThread();
+	_GLInvoke([atlas, destroy, evict]() {
+		if (atlas)
+			atlases->_Maintain();
+		if (destroy)
+			textures->_DestroyDeferred();
+		if (evict)
+			textures->_EnforceBudget(PulsarSettings::texture_vram_budget());
+	});
+}
+
+// Waits until the render thread no longer submits any canvas layer snapshot.
+void Renderer::_SyncRenderThread()
+{
+	if (render_thread)
+		render_thread->Sync();
+}
+
 void Renderer::FocusWindow(WindowHandle window)
 {
 	focused_window = window;
@@ -128,7 +261,10 @@ void Renderer::RemoveCanvasLayer(CanvasIndex ci)
 	PULSAR_CHECK_INITIALIZED
 	auto layer_it = layers.find(ci);
 	if (layer_it != layers.end())
+	{
+		_SyncRenderThread();
 		layers.erase(layer_it);
+	}
 	else
 		Logger::LogErrorFatal(std::string("Tried to remove a canvas layer at renderer canvas index (") + std::to_string(ci)
 			+ "), but no canvas layer under that canvas index exists!");
@@ -1,24 +1,41 @@
 #pragma once
 
+#include <functional>
+#include <map>
 #include <unordered_map>
 
 #include "CanvasLayer.h"
+#include "GLCommandQueue.h"
+#include "LayerRecorder.h"
+#include "RenderThread.h"
+#include "StreamingArena.h"
+#include "TextureUploader.h"
+#include "registry/Sampler.h"
 #include "registry/Shader.h"
 #include "registry/Texture.h"
 #include "registry/Tile.h"
 #include "registry/UniformLexicon.h"
+#include "registry/compound/DynamicAtlas.h"
 #include "render/Font.h"
 
 class Renderer
 {
 	static std::map<CanvasIndex, CanvasLayer> layers;
+	static std::vector<RecordingGroup> recording_groups;
+	static RenderThread* render_thread;
+	static GLCommandQueue* gl_queue;
+	static unsigned char record_snapshot;
 
 	static ShaderRegistry* shaders;
 	static TextureRegistry* textures;
+	static SamplerRegistry* samplers;
 	static TileRegistry* tiles;
 	static UniformLexiconRegistry* uniform_lexicons;
 	static FontRegistry* fonts;
 	static KerningRegistry* kernings;
+	static StreamingArena* arena;
+	static TextureUploader* uploader;
+	static DynamicAtlas* atlases;
 
 public:
 	static void Init();
@@ -30,11 +47,20 @@ public:
 	static void RemoveCanvasLayer(CanvasIndex);
 	static CanvasLayer* GetCanvasLayer(CanvasIndex);
 	static void ChangeCanvasLayerIndex(CanvasIndex old_index, CanvasIndex new_index);
+	static void _GLInvoke(const std::function<void()>& op);
+	static void _SyncRenderThread();
+	static void _DrainGLQueue();
+	static void _Maintain();
 
 	static ShaderRegistry& Shaders() { return *shaders; }
 	static TextureRegistry& Textures() { return *textures; }
+	static SamplerRegistry& Samplers() { return *samplers; }
 	static TileRegistry& Tiles() { return *tiles; }
 	static UniformLexiconRegistry& UniformLexicons() { return *uniform_lexicons; }
 	static FontRegistry& Fonts() { return *fonts; }
 	static KerningRegistry& Kernings() { return *kernings; }
+	static StreamingArena& Arena() { return *arena; }
+	static GLCommandQueue& GLQueue() { return *gl_queue; }
+	static TextureUploader& Uploader() { return *uploader; }
+	static DynamicAtlas& Atlases() { return *atlases; }
 };
@@ -0,0 +1,105 @@
+#include "StreamingArena.h"
+
+#include "GLDebug.h"
+#include "Macros.h"
+
+StreamingArena::StreamingArena(VertexSize vertex_capacity, VertexSize index_capacity)
+	: m_VertexCapacity(vertex_capacity * sizeof(GLfloat)), m_IndexCapacity(index_capacity * sizeof(GLuint))
+{
+	PULSAR_TRY(glGenBuffers(1, &m_VB));
+	PULSAR_TRY(glGenBuffers(1, &m_IB));
+	PULSAR_TRY(glBindBuffer(GL_COPY_WRITE_BUFFER, m_VB));
+	PULSAR_TRY(glBufferData(GL_COPY_WRITE_BUFFER, m_VertexCapacity, nullptr, GL_STREAM_DRAW));
+	PULSAR_TRY(glBindBuffer(GL_COPY_WRITE_BUFFER, m_IB));
+	PULSAR_TRY(glBufferData(GL_COPY_WRITE_BUFFER, m_IndexCapacity, nullptr, GL_STREAM_DRAW));
+	PULSAR_TRY(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	GLDebug::Label(GL_BUFFER, m_VB, "StreamingArena vertices");
+	GLDebug::Label(GL_BUFFER, m_IB, "StreamingArena indexes");
+}
+
+StreamingArena::~StreamingArena()
+{
+	ClearModels();
+	PULSAR_TRY(glDeleteBuffers(1, &m_VB));
+	PULSAR_TRY(glDeleteBuffers(1, &m_IB));
+	m_VB = m_IB = 0;
+}
+
+void StreamingArena::BindModel(const BatchModel& model)
+{
+	auto iter = m_VAOs.find(model);
+	VAO vao = iter != m_VAOs.end() ? iter->second : RegisterModel(model);
+	m_BoundModel = model;
+	PULSAR_TRY(glBindVertexArray(vao));
+}
+
+void StreamingArena::Unbind() const
+{
+	PULSAR_TRY(glBindVertexArray(0));
+}
+
+void StreamingArena::StreamVertices(const GLfloat* data, GLsizeiptr count)
+{
+	GLintptr offset = Stream(m_VB, m_VertexCapacity, m_VertexCursor, data, count * sizeof(GLfloat));
+	GLsizei stride = Render::StrideCountOf(m_BoundModel.layout, m_BoundModel.layoutMask) * sizeof(GLfloat);
+	PULSAR_TRY(glBindVertexBuffer(0, m_VB, offset, stride));
+}
+
+GLintptr StreamingArena::StreamIndexes(const GLuint* data, GLsizeiptr count)
+{
+	return Stream(m_IB, m_IndexCapacity, m_IndexCursor, data, count * sizeof(GLuint));
+}
+
+void StreamingArena::ClearModels()
+{
+	for (const auto& [model, vao] : m_VAOs)
+	{
+		PULSAR_TRY(glDeleteVertexArrays(1, &vao));
+	}
+	m_VAOs.clear();
+}
+
+VAO StreamingArena::RegisterModel(const BatchModel& model)
+{
+	VAO vao;
+	PULSAR_TRY(glGenVertexArrays(1, &vao));
+	PULSAR_TRY(glBindVertexArray(vao));
+	Render::_AttribLayout(model.layout, model.layoutMask);
+	// element array binding is part of VAO state
+	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IB));
+	PULSAR_TRY(glBindVertexArray(0));
+	PULSAR_TRY(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	if (GLDebug::Enabled())
+		GLDebug::Label(GL_VERTEX_ARRAY, vao, "StreamingArena VAO " + std::to_string(m_VAOs.size()));
+	m_VAOs[model] = vao;
+	return vao;
+}
+
+GLintptr StreamingArena::Stream(GLuint buffer, GLsizeiptr& capacity, GLintptr& cursor, const void* data, GLsizeiptr size)
+{
+	// GL_COPY_WRITE_BUFFER is used so that writes never disturb the currently bound VAO.
+	PULSAR_TRY(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+	if (cursor + size > capacity)
+	{
+		// orphan the buffer so that in-flight draws keep their storage, and restart at the front.
+		while (capacity < size)
+			capacity *= 2;
+		PULSAR_TRY(glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STREAM_DRAW));
+		cursor = 0;
+	}
+	GLintptr offset = cursor;
+	if (size > 0)
+	{
+		void* dst = nullptr;
+		PULSAR_TRY(dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+		if (dst)
+		{
+			memcpy_s(dst, size, data, size);
+			PULSAR_TRY(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+		}
+	}
+	PULSAR_TRY(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	// keep sub-allocations 16-byte aligned
+	cursor = (offset + size + 15) & ~GLintptr(15);
+	return offset;
+}
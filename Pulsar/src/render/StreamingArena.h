@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <unordered_map>
+
+#include "PulsarSettings.h"
+#include "Renderable.h"
+
+typedef GLuint VAO;
+
+// Renderer-wide vertex and index buffers that every CanvasLayer streams its pools into.
+// Pools are sub-allocated front to back. Once the arena is full, its buffers are orphaned and writing restarts at the front.
+// VAOs only describe vertex formats, so a single VAO per BatchModel is shared by all layers.
+class StreamingArena
+{
+	GLuint m_VB = 0, m_IB = 0;
+	GLsizeiptr m_VertexCapacity, m_IndexCapacity;
+	GLintptr m_VertexCursor = 0, m_IndexCursor = 0;
+	std::unordered_map<BatchModel, VAO> m_VAOs;
+	BatchModel m_BoundModel;
+
+public:
+	StreamingArena(VertexSize vertex_capacity, VertexSize index_capacity);
+	StreamingArena(const StreamingArena&) = delete;
+	StreamingArena(StreamingArena&&) = delete;
+	~StreamingArena();
+
+	void BindModel(const BatchModel& model);
+	void Unbind() const;
+	void StreamVertices(const GLfloat* data, GLsizeiptr count);
+	GLintptr StreamIndexes(const GLuint* data, GLsizeiptr count);
+	void ClearModels();
+
+private:
+	VAO RegisterModel(const BatchModel& model);
+	GLintptr Stream(GLuint buffer, GLsizeiptr& capacity, GLintptr& cursor, const void* data, GLsizeiptr size);
+};
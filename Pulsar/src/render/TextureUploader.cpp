@@ -0,0 +1,136 @@
+#include "TextureUploader.h"
+
+#include "Macros.h"
+#include "Renderer.h"
+
+static size_t upload_size(const Tile* tile)
+{
+	return tile ? static_cast<size_t>(tile->GetWidth()) * tile->GetHeight() * tile->GetBPP() : 0;
+}
+
+TextureUploader::TextureUploader(size_t capacity)
+	: m_Capacity(static_cast<GLsizeiptr>(capacity > 0 ? capacity : 1))
+{
+	PULSAR_TRY(glGenBuffers(1, &m_PBO));
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO));
+	PULSAR_TRY(glBufferData(GL_PIXEL_UNPACK_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW));
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+TextureUploader::~TextureUploader()
+{
+	PULSAR_TRY(glDeleteBuffers(1, &m_PBO));
+}
+
+void TextureUploader::Enqueue(Upload&& upload)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Uploads.push_back(std::move(upload));
+}
+
+// Runs uploads in submission order until the budget is spent. At least one upload is run, so oversized textures still make progress.
+// Returns the number of uploads run.
+size_t TextureUploader::Pump(size_t budget_bytes)
+{
+	size_t count = 0, bytes = 0;
+	while (true)
+	{
+		Upload upload;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Uploads.empty())
+				break;
+			Upload& front = m_Uploads.front();
+			size_t size = front.image ? front.image->data.size() : upload_size(front.tile ? front.tile.get() : Renderer::Tiles().Get(front.tileHandle));
+			if (count > 0 && bytes + size > budget_bytes)
+				break;
+			bytes += size;
+			upload = std::move(front);
+			m_Uploads.pop_front();
+		}
+		Run(upload);
+		++count;
+	}
+	m_UploadedBytes += bytes;
+	return count;
+}
+
+size_t TextureUploader::Size()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Uploads.size();
+}
+
+void TextureUploader::Run(Upload& upload)
+{
+	if (upload.image)
+	{
+		const void* data = Stage(upload.image->data.data(), upload.image->data.size());
+		Texture texture(*upload.image, data, upload.settings);
+		PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+		upload.finish(texture ? &texture : nullptr);
+		return;
+	}
+	Tile const* tile = upload.tile ? upload.tile.get() : Renderer::Tiles().Get(upload.tileHandle);
+	if (!tile || !*tile)
+	{
+		upload.finish(nullptr);
+		return;
+	}
+	const void* pixels = Stage(tile->GetImageBuffer(), upload_size(tile));
+	Texture texture(pixels, tile->GetWidth(), tile->GetHeight(), tile->GetBPP(), upload.tileHandle, upload.settings, tile->GetImageBuffer());
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	upload.finish(texture ? &texture : nullptr);
+}
+
+void TextureUploader::SubImage(const Texture& texture, const unsigned char* pixels, int x, int y, int width, int height, int row_length)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	size_t stride = static_cast<size_t>(row_length > 0 ? row_length : width) * 4;
+	const void* staged = Stage(pixels, static_cast<GLsizeiptr>(width) * 4, height, stride);
+	// the staged rows are packed tightly, while unstaged client pixels keep their row length
+	texture.SubImage(staged, x, y, width, height, staged == pixels ? row_length : 0);
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	m_UploadedBytes += static_cast<size_t>(width) * height * 4;
+}
+
+const void* TextureUploader::Stage(const unsigned char* pixels, GLsizeiptr size)
+{
+	return Stage(pixels, size, 1, static_cast<size_t>(size));
+}
+
+// Copies rows of row_size bytes, stride bytes apart in pixels, tightly packed into the unpack buffer and leaves it bound.
+// Once the buffer is full, it is orphaned and writing restarts at the front, so uploads still reading the previous storage are never overwritten.
+// Returns the pixel pointer to pass to glTexImage2D: an offset into the unpack buffer, or the client pixels if the buffer could not be mapped.
+const void* TextureUploader::Stage(const unsigned char* pixels, GLsizeiptr row_size, int rows, size_t stride)
+{
+	GLsizeiptr size = row_size * rows;
+	PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PBO));
+	if (m_Cursor + size > m_Capacity)
+	{
+		while (m_Capacity < size)
+			m_Capacity *= 2;
+		PULSAR_TRY(glBufferData(GL_PIXEL_UNPACK_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW));
+		m_Cursor = 0;
+	}
+	GLintptr offset = m_Cursor;
+	void* dst = nullptr;
+	PULSAR_TRY(dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	if (!dst)
+	{
+		PULSAR_TRY(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+		return pixels;
+	}
+	if (static_cast<size_t>(row_size) == stride)
+		memcpy_s(dst, size, pixels, size);
+	else
+	{
+		for (int row = 0; row < rows; ++row)
+			memcpy_s(static_cast<unsigned char*>(dst) + row * row_size, row_size, pixels + row * stride, row_size);
+	}
+	PULSAR_TRY(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+	// rows are at most 4-byte aligned, so keeping offsets 16-byte aligned satisfies every unpack alignment
+	m_Cursor = (offset + size + 15) & ~GLintptr(15);
+	return reinterpret_cast<const void*>(offset);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <GL/glew.h>
+
+#include "registry/Texture.h"
+#include "registry/TextureCache.h"
+#include "registry/Tile.h"
+
+// Creates textures from decoded tiles by staging their pixels in a streamed GL_PIXEL_UNPACK_BUFFER. Any thread may enqueue uploads,
+// and the thread owning the GL context pumps them once per frame, up to a byte budget, so that large batches of textures do not stall a frame.
+// Decoding happens before enqueueing, typically on a job worker, so the GL thread only copies pixels and issues the upload.
+class TextureUploader
+{
+public:
+	struct Upload
+	{
+		// a cached image, or a tile that is either owned by the upload or looked up from the tile registry when the upload runs
+		std::unique_ptr<CompressedImage> image;
+		std::unique_ptr<Tile> tile;
+		TileHandle tileHandle = 0;
+		TextureSettings settings;
+		// receives the created texture, or nullptr if the tile could not be uploaded
+		std::function<void(Texture*)> finish;
+	};
+
+private:
+	std::deque<Upload> m_Uploads;
+	std::mutex m_Mutex;
+	GLuint m_PBO = 0;
+	GLsizeiptr m_Capacity;
+	GLintptr m_Cursor = 0;
+	size_t m_UploadedBytes = 0;
+
+public:
+	TextureUploader(size_t capacity);
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader(TextureUploader&&) = delete;
+	~TextureUploader();
+
+	void Enqueue(Upload&& upload);
+	size_t Pump(size_t budget_bytes);
+	// Replaces a region of texture right away, staging the RGBA8 pixels in the unpack buffer so that the copy into the texture runs asynchronously.
+	// Rows of pixels are row_length texels apart (width if 0). Must be called on the GL thread.
+	void SubImage(const Texture& texture, const unsigned char* pixels, int x, int y, int width, int height, int row_length = 0);
+	size_t Size();
+	size_t UploadedBytes() const { return m_UploadedBytes; }
+
+private:
+	void Run(Upload& upload);
+	const void* Stage(const unsigned char* pixels, GLsizeiptr size);
+	const void* Stage(const unsigned char* pixels, GLsizeiptr row_size, int rows, size_t stride);
+};
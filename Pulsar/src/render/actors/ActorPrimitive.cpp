@@ -1,6 +1,7 @@
 #include "ActorPrimitive.h"
 
 #include "Logger.inl"
+#include "Pulsar.h"
 #include "render/CanvasLayer.h"
 
 ActorPrimitive2D::ActorPrimitive2D(const Renderable& render, ZIndex z, FickleType fickle_type, bool visible)
@@ -30,6 +31,7 @@ ActorPrimitive2D& ActorPrimitive2D::operator=(const ActorPrimitive2D& primitive)
 	m_Render = primitive.m_Render;
 	m_Status = primitive.m_Status;
 	m_ModulationColors = primitive.m_ModulationColors;
+	m_TransformHistory = {};
 	f_BufferPackedP = primitive.f_BufferPackedP;
 	f_BufferPackedRS = primitive.f_BufferPackedRS;
 	f_BufferPackedM = primitive.f_BufferPackedM;
@@ -44,6 +46,7 @@ ActorPrimitive2D& ActorPrimitive2D::operator=(ActorPrimitive2D&& primitive) noex
 	m_Render = std::move(primitive.m_Render);
 	m_Status = primitive.m_Status;
 	m_ModulationColors = std::move(primitive.m_ModulationColors);
+	m_TransformHistory = {};
 	f_BufferPackedP = primitive.f_BufferPackedP;
 	f_BufferPackedRS = primitive.f_BufferPackedRS;
 	f_BufferPackedM = primitive.f_BufferPackedM;
@@ -73,6 +76,12 @@ void ActorPrimitive2D::OnDraw(signed char texture_slot)
 		for (VertexBufferCounter i = 0; i < m_Render.vertexCount; i++)
 			m_Render.vertexBufferData[i * stride] = static_cast<GLfloat>(texture_slot);
 	}
+	// blend between the last two simulation updates
+	if (Pulsar::InterpolatingUpdates() && m_Fickler.PackedP())
+	{
+		if (m_TransformHistory.Advance(*m_Fickler.PackedP(), *m_Fickler.PackedRS(), Pulsar::updateCount))
+			m_Status |= 0b110;
+	}
 	// update TransformP
 	if (m_Status & 0b10)
 	{
@@ -143,7 +152,7 @@ void ActorPrimitive2D::BindBufferFuncs()
 
 void ActorPrimitive2D::buffer_packed_p(Stride stride)
 {
-	const PackedP2D& position = *m_Fickler.PackedP();
+	const PackedP2D position = m_TransformHistory.moving ? m_TransformHistory.BlendP(Pulsar::updateAlpha) : *m_Fickler.PackedP();
 	for (VertexBufferCounter i = 0; i < m_Render.vertexCount; i++)
 	{
 		m_Render.vertexBufferData[i * stride + 1] = static_cast<GLfloat>(position.x);
@@ -162,7 +171,7 @@ void ActorPrimitive2D::buffer_packed_p_default(Stride stride)
 
 void ActorPrimitive2D::buffer_packed_rs(Stride stride)
 {
-	const PackedRS2D& condensed_rs_matrix = *m_Fickler.PackedRS();
+	const PackedRS2D condensed_rs_matrix = m_TransformHistory.moving ? m_TransformHistory.BlendRS(Pulsar::updateAlpha) : *m_Fickler.PackedRS();
 	for (VertexBufferCounter i = 0; i < m_Render.vertexCount; i++)
 	{
 		m_Render.vertexBufferData[i * stride + 3] = static_cast<GLfloat>(condensed_rs_matrix[0][0]);
@@ -20,6 +20,7 @@ protected:
 	std::vector<glm::vec4> m_ModulationColors;
 	// m_Status = 0b... transformM updated | transformRS updated | transformP updated | visible
 	unsigned char m_Status = 0b111;
+	PackedTransformHistory2D m_TransformHistory;
 
 public:
 	ActorPrimitive2D(const Renderable& render = Renderable(), ZIndex z = 0, FickleType fickle_type = FickleType::Protean, bool visible = true);
@@ -30,9 +31,12 @@ public:
 	~ActorPrimitive2D();
 
 	virtual void RequestDraw(class CanvasLayer* canvas_layer) override;
+	virtual RenderProxyType ProxyType() const override { return RenderProxyType::PRIMITIVE; }
 
 	void SetShaderHandle(ShaderHandle handle) { m_Render.model.shader = handle; }
 	virtual void SetTextureHandle(TextureHandle handle) { m_Render.textureHandle = handle; }
+	// Samples the texture with a sampler from Renderer::Samplers(), or with the texture's own settings if 0.
+	void SetSamplerHandle(SamplerHandle handle) { m_Render.samplerHandle = handle; }
 
 	void SetVisible(bool visible) { m_Status = (visible ? m_Status |= 1 : m_Status &= ~1); }
 	bool IsVisible() const { return m_Status & 0b1; }
@@ -57,6 +61,7 @@ public:
 	void CropRelativePoints(const std::vector<glm::vec2>& atlas_points);
 
 	TextureHandle GetTextureHandle() const { return m_Render.textureHandle; }
+	SamplerHandle GetSamplerHandle() const { return m_Render.samplerHandle; }
 	const Renderable& GetRenderable() const { return m_Render; }
 
 	void OnDraw(signed char texture_slot);
@@ -68,6 +68,7 @@ public:
 	NonantLines lines;
 
 	void RequestDraw(class CanvasLayer* canvas_layer) override;
+	RenderProxyType ProxyType() const override { return RenderProxyType::NONE; }
 
 	void SetPivot(float x, float y) override { m_Pivot = { x, y }; }
 	void SetPivot(const glm::vec2& pivot) override { m_Pivot = pivot; }
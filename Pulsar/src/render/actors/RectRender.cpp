@@ -17,7 +17,7 @@ static Functor<void, TextureSlot> create_on_draw_callback(RectRender* rr)
 }
 
 RectRender::RectRender(TextureHandle texture, const glm::vec2& pivot, ShaderHandle shader, ZIndex z, FickleType fickle_type, bool visible)
-	: ActorPrimitive2D(*rect_renderable, z, fickle_type, visible), on_draw_callback(create_on_draw_callback(this))
+	: ActorPrimitive2D(GetRectRenderable(), z, fickle_type, visible), on_draw_callback(create_on_draw_callback(this))
 {
 	SetShaderHandle(shader == ShaderRegistry::HANDLE_CAP ? Renderer::Shaders().Standard() : shader);
 	SetTextureHandle(texture);
@@ -74,6 +74,13 @@ void RectRender::DefineRectRenderable()
 		Logger::LogErrorFatal("Could not load rect renderable. Load Status = " + std::to_string(static_cast<int>(load_status)));
 }
 
+// The rect renderable is loaded by the first RectRender rather than at startup.
+Renderable& RectRender::GetRectRenderable()
+{
+	DefineRectRenderable();
+	return *rect_renderable;
+}
+
 void RectRender::DestroyRectRenderable()
 {
 	if (rect_renderable)
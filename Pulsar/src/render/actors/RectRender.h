@@ -25,8 +25,10 @@ public:
 	
 	static void DefineRectRenderable();
 	static void DestroyRectRenderable();
+	static Renderable& GetRectRenderable();
 
 	virtual void RequestDraw(class CanvasLayer*) override;
+	virtual RenderProxyType ProxyType() const override { return RenderProxyType::RECT; }
 
 	int GetWidth() const { return Renderer::Textures().GetWidth(m_Render.textureHandle); }
 	int GetHeight() const { return Renderer::Textures().GetHeight(m_Render.textureHandle); }
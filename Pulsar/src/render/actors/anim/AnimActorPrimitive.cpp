@@ -34,7 +34,7 @@ void AnimActorPrimitive2D::OnUpdate()
 {
 	if (m_FrameLength > 0.0f)
 	{
-		m_TimeElapsed += m_SpeedScale * Pulsar::deltaDrawTime;
+		m_TimeElapsed += m_SpeedScale * Pulsar::deltaUpdateTime;
 		if (m_TimeElapsed > m_FrameLength)
 		{
 			auto& currentAnim = m_Anims[m_CurrentAnimIndex];
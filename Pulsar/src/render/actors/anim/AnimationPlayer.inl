@@ -79,13 +79,13 @@ inline void AnimationPlayer<_Target>::OnUpdate()
 {
 	if (isInReverse)
 	{
-		time -= speed * Pulsar::deltaDrawTime;
+		time -= speed * Pulsar::deltaUpdateTime;
 		for (auto& track : tracks)
 			track->AdvanceBackward(time, period);
 	}
 	else
 	{
-		time += speed * Pulsar::deltaDrawTime;
+		time += speed * Pulsar::deltaUpdateTime;
 		for (auto& track : tracks)
 			track->AdvanceForward(time, period);
 	}
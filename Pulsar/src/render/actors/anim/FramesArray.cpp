@@ -4,7 +4,9 @@
 #include <fstream>
 
 #include "Logger.inl"
+#include "PulsarSettings.h"
 #include "registry/Texture.h"
+#include "utils/PixelKernels.h"
 #include "../../Renderer.h"
 
 FramesArray::FramesArray(const char* gif_filepath, const TextureSettings& settings, unsigned short starting_index, bool temporary_buffer)
@@ -40,6 +42,8 @@ FramesArray::FramesArray(const char* gif_filepath, const TextureSettings& settin
 	size_t stride = static_cast<size_t>(width) * bpp;
 	size_t image_size = stride * height;
 	size_t full_size = image_size * num_frames;
+	if (PulsarSettings::premultiplied_alpha() && bpp == 4)
+		PixelKernels::Premultiply(stbi_buffer, full_size / 4);
 	m_Frames = Array<TileHandle>(num_frames, 0);
 	
 	if (temporary_buffer)
@@ -48,7 +52,9 @@ FramesArray::FramesArray(const char* gif_filepath, const TextureSettings& settin
 		{
 			unsigned char* image = new unsigned char[image_size];
 			memcpy_s(image, image_size, stbi_buffer + image_size * i, image_size);
-			m_Frames[i] = Renderer::Textures().Register(Texture(Tile(TileConstructArgs_buffer(image, width, height, bpp, TileDeletionPolicy::FROM_NEW)), settings));
+			Renderer::_GLInvoke([this, i, image, width, height, bpp, &settings]() {
+				m_Frames[i] = Renderer::Textures().Register(Texture(Tile(TileConstructArgs_buffer(image, width, height, bpp, TileDeletionPolicy::FROM_NEW)), settings));
+			});
 		}
 	}
 	else
@@ -37,8 +37,10 @@ void ParticleEffect::OnUpdate()
 	// TODO perhaps spawning and enabled should be moved to particle subsystem?
 	if (!paused)
 	{
-		m_LeftoverDT += Pulsar::deltaDrawTime;
-		if (m_LeftoverDT >= PulsarSettings::particle_frame_length())
+		// with a fixed timestep, every update already advances by one step
+		if (PulsarSettings::fixed_timestep() > 0.0f)
+			m_DeltaTime = Pulsar::deltaUpdateTime;
+		else if ((m_LeftoverDT += Pulsar::deltaUpdateTime) >= PulsarSettings::particle_frame_length())
 		{
 			m_DeltaTime = PulsarSettings::particle_frame_length();
 			m_LeftoverDT -= PulsarSettings::particle_frame_length();
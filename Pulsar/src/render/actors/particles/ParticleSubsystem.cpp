@@ -1,6 +1,7 @@
 #include "ParticleSubsystem.h"
 
 #include "Macros.h"
+#include "JobSystem.h"
 #include "ParticleSystem.h"
 #include "Logger.inl"
 #include "utils/Data.inl"
@@ -93,7 +94,7 @@ void ParticleSubsystem::OnSpawnFrame(ParticleEffect& psys)
 
 void ParticleSubsystem::Spawn(ParticleEffect& psys, const Particles::CHRSeed& seed)
 {
-	std::shared_ptr<DebugPolygon> shape(std::make_shared<DebugPolygon>(*m_Data.prototypeShape));
+	std::shared_ptr<DebugPolygon> shape(std::allocate_shared<DebugPolygon>(m_ShapeAllocator, *m_Data.prototypeShape));
 	(this->*f_AttachFickle)(shape->Fickler());
 	m_Particles.push_back(Particle(shape, m_Data.lifespanFunc(seed), m_Data.characteristicGen(seed)));
 	psys.AddParticleShape(m_SubsystemIndex, shape);
@@ -101,10 +102,14 @@ void ParticleSubsystem::Spawn(ParticleEffect& psys, const Particles::CHRSeed& se
 
 void ParticleSubsystem::OnParticlesUpdate(ParticleEffect& psys)
 {
+	// particles only write to their own shape, so they are updated in parallel. Removal stays serial.
+	JobSystem::ParallelFor(m_Particles.size(), 64, [this, &psys](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			m_Particles[i].OnDraw(psys.m_DeltaTime);
+	});
 	for (ParticleCount i = 0; i < m_Particles.size(); i++)
 	{
 		auto& p = m_Particles[i];
-		p.OnDraw(psys.m_DeltaTime);
 		if (p.m_Invalid)
 		{
 			psys.InvalidateParticleShape(m_SubsystemIndex, p.m_Shape);
@@ -6,6 +6,7 @@
 
 #include "Pulsar.h"
 #include "utils/CommonMath.h"
+#include "utils/PoolAllocator.inl"
 #include "Particle.h"
 #include "../../transform/Fickle.inl"
 
@@ -34,6 +35,8 @@ class ParticleSubsystem
 	ParticleSubsystemIndex m_SubsystemIndex;
 	Fickler2D m_Fickler;
 	std::vector<Particle> m_Particles;
+	// particle shapes are recycled through a pool, since they are spawned and despawned every frame
+	PoolAllocator<DebugPolygon> m_ShapeAllocator;
 
 public:
 	ParticleSubsystem(const ParticleSubsystemData& wave_data, ParticleSubsystemIndex subsystem_index, FickleType fickle_type = FickleType::Protean);
@@ -7,6 +7,17 @@
 
 typedef glm::vec4 Modulate;
 
+// Modulation and vertex colors are always straight. With premultiplied_alpha on, the shaders premultiply them, and a negative alpha
+// writes an alpha of 0, which blends additively at that opacity. Additive and alpha-blended actors then share draw calls.
+// The encoding lives in the premultiply() helper that Shader.cpp injects into vertex shaders: a color (rgb, a) becomes (rgb * |a|, max(a, 0)).
+// With the GL_ONE, GL_ONE_MINUS_SRC_ALPHA blend of premultiplied layers, a negative a then adds rgb * |a| to the destination without darkening it.
+// With straight alpha, the sign is dropped and the color blends normally at |a|.
+// The sign survives modulation by straight parents, so only set it on leaves.
+inline Modulate additive_modulate(const Modulate& color)
+{
+	return { glm::vec3(color), -glm::abs(color.a) };
+}
+
 struct PackedModulate
 {
 	Modulate modulate = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -61,3 +61,40 @@ void Transformer2D::SetPackedLocalOf(const PackedRS2D& globalPackedRS)
 {
 	self.packedRS = globalPackedRS / parent->self.packedRS;
 }
+
+// Records the current packed transform as the latest state, rolling the previous latest state back if a new update has run since the last call.
+// Returns whether the drawn transform may differ from the previous draw, i.e. whether vertex data must be refreshed.
+bool PackedTransformHistory2D::Advance(const PackedP2D& p, const PackedRS2D& rs, unsigned long long update_count)
+{
+	if (update == ~0ull)
+	{
+		fromP = p;
+		fromRS = rs;
+		span = 1;
+	}
+	else if (update != update_count)
+	{
+		fromP = toP;
+		fromRS = toRS;
+		span = update_count - update;
+	}
+	update = update_count;
+	toP = p;
+	toRS = rs;
+	bool was_moving = moving;
+	moving = fromP != toP || fromRS != toRS;
+	return moving || was_moving;
+}
+
+// If several updates ran since the previous state was recorded, motion is assumed to be linear across them, and only the last update's segment is blended over.
+PackedP2D PackedTransformHistory2D::BlendP(float alpha) const
+{
+	float t = (static_cast<float>(span - 1) + alpha) / static_cast<float>(span);
+	return fromP + (toP - fromP) * t;
+}
+
+PackedRS2D PackedTransformHistory2D::BlendRS(float alpha) const
+{
+	float t = (static_cast<float>(span - 1) + alpha) / static_cast<float>(span);
+	return fromRS + (toRS - fromRS) * t;
+}
@@ -37,6 +37,22 @@ struct PackedTransform2D
 	void SyncRS(const PackedTransform2D& parent);
 };
 
+// Packed transform as of the previous and the latest simulation update, so that drawing can blend between the two.
+// The packed (global) values are blended rather than the local Transform2D, so parent motion is accounted for. RS is blended componentwise,
+// which is accurate for the small rotations of a single update.
+struct PackedTransformHistory2D
+{
+	PackedP2D fromP = { 0.0f, 0.0f }, toP = { 0.0f, 0.0f };
+	PackedRS2D fromRS = { 1.0f, 0.0f, 0.0f, 1.0f }, toRS = { 1.0f, 0.0f, 0.0f, 1.0f };
+	unsigned long long update = ~0ull;
+	unsigned long long span = 1;
+	bool moving = false;
+
+	bool Advance(const PackedP2D& p, const PackedRS2D& rs, unsigned long long update_count);
+	PackedP2D BlendP(float alpha) const;
+	PackedRS2D BlendRS(float alpha) const;
+};
+
 struct Transformer2D
 {
 	PackedTransform2D self;
@@ -75,3 +75,36 @@ inline void insertion_sort(std::vector<T>& vec, CompareGreaterThan compare_great
 		i++;
 	}
 }
+
+// Stable LSD radix sort on a 64-bit key, one byte per pass. buffer is scratch space that is reused across calls.
+// Passes where every element shares the same key byte are skipped, so keys that mostly agree sort in few passes.
+template<typename T, typename KeyOf>
+inline void radix_sort_64(std::vector<T>& vec, std::vector<T>& buffer, KeyOf key_of)
+{
+	if (vec.size() < 2)
+		return;
+	size_t counts[8][256] = {};
+	for (const T& el : vec)
+	{
+		unsigned long long key = key_of(el);
+		for (unsigned char pass = 0; pass < 8; ++pass)
+			++counts[pass][(key >> (8 * pass)) & 0xFF];
+	}
+	buffer.resize(vec.size());
+	for (unsigned char pass = 0; pass < 8; ++pass)
+	{
+		size_t* count = counts[pass];
+		if (count[(key_of(vec[0]) >> (8 * pass)) & 0xFF] == vec.size())
+			continue;
+		size_t offset = 0;
+		for (size_t i = 0; i < 256; ++i)
+		{
+			size_t c = count[i];
+			count[i] = offset;
+			offset += c;
+		}
+		for (T& el : vec)
+			buffer[count[(key_of(el) >> (8 * pass)) & 0xFF]++] = std::move(el);
+		vec.swap(buffer);
+	}
+}
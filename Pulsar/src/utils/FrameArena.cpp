@@ -0,0 +1,89 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+std::vector<std::unique_ptr<FrameArena::SubArena>> FrameArena::sub_arenas;
+std::mutex FrameArena::mutex;
+size_t FrameArena::block_size = 0;
+unsigned int FrameArena::generation = 0;
+size_t FrameArena::last_frame_bytes = 0;
+
+// Sub-arena of the current thread, tagged with the generation it was created in, so that a re-initialized arena is not used through a stale pointer.
+static thread_local std::pair<void*, unsigned int> local_sub_arena = { nullptr, 0 };
+
+void FrameArena::Init(size_t size)
+{
+	Terminate();
+	block_size = size;
+}
+
+void FrameArena::Terminate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& sub_arena : sub_arenas)
+	{
+		for (auto& [data, size] : sub_arena->blocks)
+			delete[] data;
+	}
+	sub_arenas.clear();
+	block_size = 0;
+	++generation;
+}
+
+FrameArena::SubArena& FrameArena::Local()
+{
+	if (local_sub_arena.first && local_sub_arena.second == generation)
+		return *static_cast<SubArena*>(local_sub_arena.first);
+	std::lock_guard<std::mutex> lock(mutex);
+	sub_arenas.push_back(std::make_unique<SubArena>());
+	local_sub_arena = { sub_arenas.back().get(), generation };
+	return *sub_arenas.back();
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	SubArena& arena = Local();
+	while (arena.block < arena.blocks.size())
+	{
+		auto& [data, size] = arena.blocks[arena.block];
+		size_t aligned = (reinterpret_cast<uintptr_t>(data) + arena.offset + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(data);
+		if (aligned + bytes <= size)
+		{
+			arena.offset = aligned + bytes;
+			arena.used += bytes;
+			return data + aligned;
+		}
+		++arena.block;
+		arena.offset = 0;
+	}
+	// oversized requests get a block of their own, which is reused like any other block after Reset()
+	size_t size = std::max(block_size, bytes + alignment);
+	arena.blocks.push_back({ new unsigned char[size], size });
+	arena.block = arena.blocks.size() - 1;
+	arena.offset = 0;
+	return Allocate(bytes, alignment);
+}
+
+void FrameArena::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	last_frame_bytes = 0;
+	for (auto& sub_arena : sub_arenas)
+	{
+		last_frame_bytes += sub_arena->used;
+		sub_arena->block = 0;
+		sub_arena->offset = 0;
+		sub_arena->used = 0;
+	}
+}
+
+// Bytes allocated since the last Reset(), summed over all threads.
+size_t FrameArena::BytesUsed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t used = 0;
+	for (const auto& sub_arena : sub_arenas)
+		used += sub_arena->used;
+	return used;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame. Each thread allocates from its own sub-arena, so allocation never locks.
+// Reset() rewinds every sub-arena at once, and must only be called when no thread is allocating, i.e. after the frame's jobs are done.
+// Blocks are kept across frames, so a warmed-up frame does not touch the heap. With a block size of 0, the arena is disabled and allocations go to the heap.
+class FrameArena
+{
+	struct SubArena
+	{
+		std::vector<std::pair<unsigned char*, size_t>> blocks;
+		size_t block = 0;
+		size_t offset = 0;
+		size_t used = 0;
+	};
+	static std::vector<std::unique_ptr<SubArena>> sub_arenas;
+	static std::mutex mutex;
+	static size_t block_size;
+	static unsigned int generation;
+	static size_t last_frame_bytes;
+
+public:
+	static void Init(size_t block_size);
+	static void Terminate();
+
+	static bool Enabled() { return block_size > 0; }
+	static void* Allocate(size_t bytes, size_t alignment);
+	static void Reset();
+	static size_t BytesUsed();
+	static size_t LastFrameBytes() { return last_frame_bytes; }
+
+private:
+	static SubArena& Local();
+};
+
+// std-compatible allocator on the frame arena. Deallocation is a no-op, so containers using it must not outlive the frame.
+template<typename T>
+struct FrameAllocator
+{
+	typedef T value_type;
+
+	FrameAllocator() = default;
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (FrameArena::Enabled())
+			return static_cast<T*>(FrameArena::Allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* ptr, size_t)
+	{
+		if (!FrameArena::Enabled())
+			::operator delete(ptr);
+	}
+
+	template<typename U>
+	bool operator==(const FrameAllocator<U>&) const { return true; }
+};
+
+template<typename T>
+using frame_vector = std::vector<T, FrameAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char>> frame_string;
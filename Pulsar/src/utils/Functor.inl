@@ -1,25 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <new>
 #include <type_traits>
 
 #include "utils/Meta.inl"
 
-template<typename Ret, typename Arg>
-struct _FunctorInterface
-{
-	virtual ~_FunctorInterface() = default;
-	virtual Ret operator()(Arg arg) = 0;
-	virtual _FunctorInterface<Ret, Arg>* clone() = 0;
-};
-
-template<typename Ret>
-struct _FunctorInterface<Ret, void>
-{
-	virtual ~_FunctorInterface() = default;
-	virtual Ret operator()() = 0;
-	virtual _FunctorInterface<Ret, void>* clone() = 0;
-};
-
 template<typename Ret, typename Arg, typename Cls>
 struct func_signature
 {
@@ -63,7 +49,7 @@ template<typename T>
 using strip_rvalue_reference_t = strip_rvalue_reference<T>::type;
 
 template<typename Ret, typename Arg, typename Cls, typename _Storage, bool _ValueIn = true>
-struct _FunctorEnclosure : public _FunctorInterface<Ret, Arg>
+struct _FunctorEnclosure
 {
 	static_assert(!std::is_lvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be l-value reference when _ValueIn=true.");
 	static_assert(!std::is_rvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be r-value reference.");
@@ -73,24 +59,20 @@ struct _FunctorEnclosure : public _FunctorInterface<Ret, Arg>
 
 	_FunctorEnclosure(func_signature function, _Storage closure) : function(function), closure(closure) {}
 
-	Ret operator()(Arg arg) override
+	Ret operator()(Arg arg)
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function(redirect<Arg>(arg), redirect<Cls>(closure));
 		else
 			return function(redirect<Arg>(arg), redirect<Cls>(closure));
 	}
-	_FunctorInterface<Ret, Arg>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, Arg, Cls, _Storage, true>(function, closure);
-	}
 
 	func_signature function;
 	_Storage closure;
 };
 
 template<typename Ret, typename Arg, typename Cls, typename _Storage>
-struct _FunctorEnclosure<Ret, Arg, Cls, _Storage, false> : public _FunctorInterface<Ret, Arg>
+struct _FunctorEnclosure<Ret, Arg, Cls, _Storage, false>
 {
 	static_assert(!std::is_rvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be r-value reference.");
 	static_assert(std::is_convertible_v<_Storage, Cls>, "_FunctorEnclosure: _Storage is not convertible to Cls.");
@@ -99,47 +81,39 @@ struct _FunctorEnclosure<Ret, Arg, Cls, _Storage, false> : public _FunctorInterf
 
 	_FunctorEnclosure(func_signature function, auto&& closure) : function(function), closure(forward(closure)) {}
 
-	Ret operator()(Arg arg) override
+	Ret operator()(Arg arg)
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function(redirect<Arg>(arg), redirect<Cls>(closure));
 		else
 			return function(redirect<Arg>(arg), redirect<Cls>(closure));
 	}
-	_FunctorInterface<Ret, Arg>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, Arg, Cls, _Storage, false>(function, std::forward<_Storage&>(closure));
-	}
 
 	func_signature function;
 	_Storage closure;
 };
 
 template<typename Ret, typename Arg, typename _Storage, bool _ValueIn>
-struct _FunctorEnclosure<Ret, Arg, void, _Storage, _ValueIn> : public _FunctorInterface<Ret, Arg>
+struct _FunctorEnclosure<Ret, Arg, void, _Storage, _ValueIn>
 {
 	static_assert(std::is_void_v<_Storage>, "_FunctorEnclosure: _Storage must be void when Cls is void.");
 	using func_signature = func_signature_t<Ret, Arg, void>;
 
 	_FunctorEnclosure(func_signature function) : function(function) {}
 
-	Ret operator()(Arg arg) override
+	Ret operator()(Arg arg)
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function(redirect<Arg>(arg));
 		else
 			return function(redirect<Arg>(arg));
 	}
-	_FunctorInterface<Ret, Arg>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, Arg, void, void, _ValueIn>(function);
-	}
 
 	func_signature function;
 };
 
 template<typename Ret, typename Cls, typename _Storage>
-struct _FunctorEnclosure<Ret, void, Cls, _Storage, true> : public _FunctorInterface<Ret, void>
+struct _FunctorEnclosure<Ret, void, Cls, _Storage, true>
 {
 	static_assert(!std::is_lvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be l-value reference when _ValueIn=true.");
 	static_assert(!std::is_rvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be r-value reference.");
@@ -149,24 +123,20 @@ struct _FunctorEnclosure<Ret, void, Cls, _Storage, true> : public _FunctorInterf
 
 	_FunctorEnclosure(func_signature function, _Storage closure) : function(function), closure(closure) {}
 
-	Ret operator()() override
+	Ret operator()()
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function(redirect<Cls>(closure));
 		else
 			return function(redirect<Cls>(closure));
 	}
-	_FunctorInterface<Ret, void>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, void, Cls, _Storage, true>(function, closure);
-	}
 
 	func_signature function;
 	_Storage closure;
 };
 
 template<typename Ret, typename Cls, typename _Storage>
-struct _FunctorEnclosure<Ret, void, Cls, _Storage, false> : public _FunctorInterface<Ret, void>
+struct _FunctorEnclosure<Ret, void, Cls, _Storage, false>
 {
 	static_assert(!std::is_rvalue_reference_v<_Storage>, "_FunctorEnclosure: _Storage cannot be r-value reference.");
 	static_assert(std::is_convertible_v<_Storage, Cls>, "_FunctorEnclosure: _Storage is not convertible to Cls.");
@@ -175,41 +145,33 @@ struct _FunctorEnclosure<Ret, void, Cls, _Storage, false> : public _FunctorInter
 
 	_FunctorEnclosure(func_signature function, auto&& closure) : function(function), closure(forward(closure)) {}
 
-	Ret operator()() override
+	Ret operator()()
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function(redirect<Cls>(closure));
 		else
 			return function(redirect<Cls>(closure));
 	}
-	_FunctorInterface<Ret, void>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, void, Cls, _Storage, false>(function, std::forward<_Storage&>(closure));
-	}
 
 	func_signature function;
 	_Storage closure;
 };
 
 template<typename Ret, typename _Storage, bool _ValueIn>
-struct _FunctorEnclosure<Ret, void, void, _Storage, _ValueIn> : public _FunctorInterface<Ret, void>
+struct _FunctorEnclosure<Ret, void, void, _Storage, _ValueIn>
 {
 	static_assert(std::is_void_v<_Storage>, "_FunctorEnclosure: _Storage must be void when Cls is void.");
 	using func_signature = func_signature_t<Ret, void, void>;
 
 	_FunctorEnclosure(func_signature function) : function(function) {}
 
-	Ret operator()() override
+	Ret operator()()
 	{
 		if constexpr (std::is_void_v<Ret>)
 			function();
 		else
 			return function();
 	}
-	_FunctorInterface<Ret, void>* clone() override
-	{
-		return new _FunctorEnclosure<Ret, void, void, void, _ValueIn>(function);
-	}
 
 	func_signature function;
 };
@@ -252,144 +214,227 @@ struct parse_function<Ret(*)()>
 template<typename Lambda>
 constexpr unsigned char parse_function_v = parse_function<Lambda>::value;
 
-template<typename Ret, typename Arg>
-class Functor
+// Callables of at most FUNCTOR_INLINE_SIZE bytes, which covers function pointers with a few captured values, are stored inside the Functor itself.
+// Larger or throwing-move callables are allocated on the heap, and moving the Functor then only transfers ownership of the allocation.
+constexpr size_t FUNCTOR_INLINE_SIZE = 48;
+
+template<typename T>
+constexpr bool _functor_stored_inline_v = sizeof(T) <= FUNCTOR_INLINE_SIZE && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>;
+
+struct _FunctorOps
 {
-	_FunctorInterface<Ret, Arg>* f = nullptr;
+	void(*copy)(void* dst, const void* src);
+	void(*move)(void* dst, void* src) noexcept;
+	void(*destroy)(void* storage) noexcept;
+};
 
-public:
-	using RetType = Ret;
-	using ArgType = Arg;
+// Type-erased operations on a stored callable of type T. Calls go through a plain function pointer (the trampoline) instead of a virtual operator().
+template<typename T>
+struct _FunctorTarget
+{
+	static T* Get(void* storage)
+	{
+		if constexpr (_functor_stored_inline_v<T>)
+			return std::launder(static_cast<T*>(storage));
+		else
+			return *static_cast<T**>(storage);
+	}
 
-	Functor() = default;
-	template<typename Cls, typename _Storage, bool _ValueIn>
-	Functor(_FunctorEnclosure<Ret, Arg, Cls, _Storage, _ValueIn>* f) : f(f) {}
-	Functor(_FunctorInterface<Ret, Arg>* f) : f(f) {}
-	Functor(const Functor<Ret, Arg>& other)
+	static void Emplace(void* storage, T&& target)
 	{
-		if (other.f)
-			f = other.f->clone();
+		if constexpr (_functor_stored_inline_v<T>)
+			new (storage) T(std::move(target));
+		else
+			*static_cast<T**>(storage) = new T(std::move(target));
 	}
-	Functor(Functor<Ret, Arg>&& other) noexcept : f(other.f) { other.f = nullptr; }
-	template<typename Func, typename = std::enable_if_t<std::is_invocable_r_v<Ret, Func, Arg> && !std::is_base_of_v<Functor<Ret, Arg>, std::decay_t<Func>>>>
-	Functor(Func func) : f(new _FunctorEnclosure<Ret, Arg, void, void>(func)) {}
-	Functor<Ret, Arg>& operator=(const Functor<Ret, Arg>& other)
+
+	static void Copy(void* dst, const void* src)
+	{
+		const T& target = *Get(const_cast<void*>(src));
+		if constexpr (_functor_stored_inline_v<T>)
+			new (dst) T(target);
+		else
+			*static_cast<T**>(dst) = new T(target);
+	}
+
+	static void Move(void* dst, void* src) noexcept
+	{
+		if constexpr (_functor_stored_inline_v<T>)
+		{
+			new (dst) T(std::move(*Get(src)));
+			Get(src)->~T();
+		}
+		else
+			*static_cast<T**>(dst) = *static_cast<T**>(src);
+	}
+
+	static void Destroy(void* storage) noexcept
+	{
+		if constexpr (_functor_stored_inline_v<T>)
+			Get(storage)->~T();
+		else
+			delete Get(storage);
+	}
+
+	static constexpr _FunctorOps ops = { &Copy, &Move, &Destroy };
+
+	template<typename Ret, typename Arg>
+	static Ret Invoke(void* storage, Arg arg)
+	{
+		return (*Get(storage))(redirect<Arg>(arg));
+	}
+
+	template<typename Ret>
+	static Ret InvokeVoid(void* storage)
+	{
+		return (*Get(storage))();
+	}
+};
+
+// Owns the storage of a Functor, independently of its signature.
+class _FunctorStorage
+{
+protected:
+	alignas(std::max_align_t) mutable unsigned char m_Storage[FUNCTOR_INLINE_SIZE];
+	const _FunctorOps* m_Ops = nullptr;
+
+	_FunctorStorage() = default;
+	_FunctorStorage(const _FunctorStorage& other) : m_Ops(other.m_Ops)
+	{
+		if (m_Ops)
+			m_Ops->copy(m_Storage, other.m_Storage);
+	}
+	_FunctorStorage(_FunctorStorage&& other) noexcept : m_Ops(other.m_Ops)
+	{
+		if (m_Ops)
+		{
+			m_Ops->move(m_Storage, other.m_Storage);
+			other.m_Ops = nullptr;
+		}
+	}
+	_FunctorStorage& operator=(const _FunctorStorage& other)
 	{
 		if (this == &other)
 			return *this;
-		if (f)
-			delete f;
-		if (other.f)
-			f = other.f->clone();
-		else
-			f = nullptr;
+		Reset();
+		if (other.m_Ops)
+		{
+			other.m_Ops->copy(m_Storage, other.m_Storage);
+			m_Ops = other.m_Ops;
+		}
 		return *this;
 	}
-	Functor<Ret, Arg>& operator=(Functor<Ret, Arg>&& other) noexcept
+	_FunctorStorage& operator=(_FunctorStorage&& other) noexcept
 	{
 		if (this == &other)
 			return *this;
-		if (f)
-			delete f;
-		f = other.f;
-		other.f = nullptr;
+		Reset();
+		if (other.m_Ops)
+		{
+			other.m_Ops->move(m_Storage, other.m_Storage);
+			m_Ops = other.m_Ops;
+			other.m_Ops = nullptr;
+		}
 		return *this;
 	}
-	~Functor() { if (f) delete f; }
+	~_FunctorStorage() { Reset(); }
+
+	template<typename T>
+	void Emplace(T&& target)
+	{
+		_FunctorTarget<T>::Emplace(m_Storage, std::move(target));
+		m_Ops = &_FunctorTarget<T>::ops;
+	}
+
+	void Reset()
+	{
+		if (m_Ops)
+		{
+			m_Ops->destroy(m_Storage);
+			m_Ops = nullptr;
+		}
+	}
+
+public:
+	explicit operator bool() const { return m_Ops != nullptr; }
+};
+
+template<typename Ret, typename Arg>
+class Functor : public _FunctorStorage
+{
+	Ret(*m_Invoke)(void*, Arg) = nullptr;
+
+public:
+	using RetType = Ret;
+	using ArgType = Arg;
+
+	Functor() = default;
+	Functor(const Functor<Ret, Arg>&) = default;
+	Functor(Functor<Ret, Arg>&&) noexcept = default;
+	template<typename Func, typename = std::enable_if_t<std::is_invocable_r_v<Ret, Func, Arg> && !std::is_base_of_v<Functor<Ret, Arg>, std::decay_t<Func>>>>
+	Functor(Func func)
+	{
+		Emplace(std::move(func));
+		m_Invoke = &_FunctorTarget<Func>::template Invoke<Ret, Arg>;
+	}
+	Functor<Ret, Arg>& operator=(const Functor<Ret, Arg>&) = default;
+	Functor<Ret, Arg>& operator=(Functor<Ret, Arg>&&) noexcept = default;
+
 	Functor<Ret, Arg> clone() const
 	{
-		if (f)
-			return Functor<Ret, Arg>(f->clone());
+		if (m_Ops)
+			return *this;
 		else
 			throw null_functor_error("Tried to clone null functor.");
 	}
 	Ret operator()(Arg arg) const
 	{
-		if constexpr (std::is_void_v<Ret>)
-			(*f)(arg);
-		else
-			return (*f)(arg);
+		return m_Invoke(m_Storage, redirect<Arg>(arg));
 	}
 	Ret safe_call(Arg arg) const
 	{
-		if (f)
-		{
-			if constexpr (std::is_void_v<Ret>)
-				(*f)(arg);
-			else
-				return (*f)(arg);
-		}
+		if (m_Ops)
+			return m_Invoke(m_Storage, redirect<Arg>(arg));
 		else throw null_functor_error();
 	}
 };
 
 template<typename Ret>
-class Functor<Ret, void>
+class Functor<Ret, void> : public _FunctorStorage
 {
-	_FunctorInterface<Ret, void>* f = nullptr;
+	Ret(*m_Invoke)(void*) = nullptr;
 
 public:
 	using RetType = Ret;
 	using ArgType = void;
 
-	template<typename Cls, typename _Storage, bool _ValueIn>
-	Functor(_FunctorEnclosure<Ret, void, Cls, _Storage, _ValueIn>* f) : f(f) {}
-	Functor(_FunctorInterface<Ret, void>* f) : f(f) {}
-	Functor(const Functor<Ret, void>& other)
-	{
-		if (other.f)
-			f = other.f->clone();
-	}
-	Functor(Functor<Ret, void>&& other) noexcept : f(other.f) { other.f = nullptr; }
+	Functor() = default;
+	Functor(const Functor<Ret, void>&) = default;
+	Functor(Functor<Ret, void>&&) noexcept = default;
 	template<typename Func, typename = std::enable_if_t<std::is_invocable_r_v<Ret, Func> && !std::is_base_of_v<Functor<Ret, void>, std::decay_t<Func>>>>
-	Functor(Func func) : f(new _FunctorEnclosure<Ret, void, void, void>(func)) {}
-	Functor& operator=(const Functor<Ret, void>& other)
-	{
-		if (this == &other)
-			return *this;
-		if (f)
-			delete f;
-		if (other.f)
-			f = other.f->clone();
-		else
-			f = nullptr;
-		return *this;
-	}
-	Functor& operator=(Functor&& other) noexcept
+	Functor(Func func)
 	{
-		if (this == &other)
-			return *this;
-		if (f)
-			delete f;
-		f = other.f;
-		other.f = nullptr;
-		return *this;
+		Emplace(std::move(func));
+		m_Invoke = &_FunctorTarget<Func>::template InvokeVoid<Ret>;
 	}
-	~Functor() { if (f) delete f; }
+	Functor<Ret, void>& operator=(const Functor<Ret, void>&) = default;
+	Functor<Ret, void>& operator=(Functor<Ret, void>&&) noexcept = default;
+
 	Functor<Ret, void> clone() const
 	{
-		if (f)
-			return Functor<Ret, void>(f->clone());
+		if (m_Ops)
+			return *this;
 		else
 			throw null_functor_error("Tried to clone null functor.");
 	}
-
 	Ret operator()() const
 	{
-		if constexpr (std::is_void_v<Ret>)
-			(*f)();
-		else
-			return (*f)();
+		return m_Invoke(m_Storage);
 	}
 	Ret safe_call() const
 	{
-		if (f)
-		{
-			if constexpr (std::is_void_v<Ret>)
-				(*f)();
-			else
-				return (*f)();
-		}
+		if (m_Ops)
+			return m_Invoke(m_Storage);
 		else throw null_functor_error();
 	}
 };
@@ -424,12 +469,12 @@ inline auto make_functor(auto f, auto&& closure) requires (!_ValueIn)
 		if constexpr (_ReferExternal)
 		{
 			using _Storage = strip_rvalue_reference_t<decltype(closure)>;
-			return Functor<Ret, Arg>(new _FunctorEnclosure<Ret, Arg, Cls, _Storage, false>(f, forward(closure)));
+			return Functor<Ret, Arg>(_FunctorEnclosure<Ret, Arg, Cls, _Storage, false>(f, forward(closure)));
 		}
 		else
 		{
 			using _Storage = std::remove_reference_t<decltype(closure)>;
-			return Functor<Ret, Arg>(new _FunctorEnclosure<Ret, Arg, Cls, _Storage, false>(f, forward(closure)));
+			return Functor<Ret, Arg>(_FunctorEnclosure<Ret, Arg, Cls, _Storage, false>(f, forward(closure)));
 		}
 	}
 	else
@@ -441,12 +486,12 @@ inline auto make_functor(auto f, auto&& closure) requires (!_ValueIn)
 		if constexpr (_ReferExternal)
 		{
 			using _Storage = strip_rvalue_reference_t<decltype(closure)>;
-			return Functor<Ret, void>(new _FunctorEnclosure<Ret, void, Cls, _Storage, false>(f, forward(closure)));
+			return Functor<Ret, void>(_FunctorEnclosure<Ret, void, Cls, _Storage, false>(f, forward(closure)));
 		}
 		else
 		{
 			using _Storage = std::remove_reference_t<decltype(closure)>;
-			return Functor<Ret, void>(new _FunctorEnclosure<Ret, void, Cls, _Storage, false>(f, forward(closure)));
+			return Functor<Ret, void>(_FunctorEnclosure<Ret, void, Cls, _Storage, false>(f, forward(closure)));
 		}
 	}
 }
@@ -465,7 +510,7 @@ inline auto make_functor(auto f, auto closure) requires (_ValueIn)
 		using _Storage = decltype(closure);
 		static_assert(std::is_same_v<std::decay_t<Cls>, std::decay_t<decltype(closure)>>);
 		static_assert(std::is_same_v<Func, func_signature_t<Ret, Arg, Cls>>);
-		return Functor<Ret, Arg>(new _FunctorEnclosure<Ret, Arg, Cls, _Storage, true>(f, closure));
+		return Functor<Ret, Arg>(_FunctorEnclosure<Ret, Arg, Cls, _Storage, true>(f, closure));
 	}
 	else
 	{
@@ -474,7 +519,7 @@ inline auto make_functor(auto f, auto closure) requires (_ValueIn)
 		using _Storage = decltype(closure);
 		static_assert(std::is_same_v<std::decay_t<Cls>, std::decay_t<decltype(closure)>>);
 		static_assert(std::is_same_v<Func, func_signature_t<Ret, void, Cls>>);
-		return Functor<Ret, void>(new _FunctorEnclosure<Ret, void, Cls, _Storage, true>(f, closure));
+		return Functor<Ret, void>(_FunctorEnclosure<Ret, void, Cls, _Storage, true>(f, closure));
 	}
 }
 
@@ -488,11 +533,11 @@ inline auto make_functor(auto f)
 	{
 		using Arg = parse_function<Func>::par_type;
 		static_assert(std::is_same_v<Func, func_signature_t<Ret, Arg, void>>);
-		return Functor<Ret, Arg>(new _FunctorEnclosure<Ret, Arg, void, void, true>(f));
+		return Functor<Ret, Arg>(_FunctorEnclosure<Ret, Arg, void, void, true>(f));
 	}
 	else
 	{
 		static_assert(std::is_same_v<Func, func_signature_t<Ret, void, void>>);
-		return Functor<Ret, void>(new _FunctorEnclosure<Ret, void, void, void, true>(f));
+		return Functor<Ret, void>(_FunctorEnclosure<Ret, void, void, void, true>(f));
 	}
 }
@@ -0,0 +1,152 @@
+#include "LZ4.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+static constexpr size_t MIN_MATCH = 4;
+// the last match must start this many bytes before the end of the block
+static constexpr size_t MATCH_LIMIT = 12;
+// the last bytes of the block are always literals
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr int HASH_LOG = 16;
+
+static uint32_t read32(const unsigned char* at)
+{
+	uint32_t value;
+	memcpy(&value, at, 4);
+	return value;
+}
+
+static uint32_t hash4(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+static unsigned char* write_length(unsigned char* op, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		*op++ = 255;
+	*op++ = static_cast<unsigned char>(length);
+	return op;
+}
+
+static unsigned char* write_sequence(unsigned char* op, const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+	unsigned char* token = op++;
+	*token = static_cast<unsigned char>((literal_length < 15 ? literal_length : 15) << 4);
+	if (literal_length >= 15)
+		op = write_length(op, literal_length - 15);
+	memcpy(op, literals, literal_length);
+	op += literal_length;
+	if (match_length == 0)
+		return op;
+	*op++ = static_cast<unsigned char>(offset);
+	*op++ = static_cast<unsigned char>(offset >> 8);
+	match_length -= MIN_MATCH;
+	*token |= static_cast<unsigned char>(match_length < 15 ? match_length : 15);
+	if (match_length >= 15)
+		op = write_length(op, match_length - 15);
+	return op;
+}
+
+size_t LZ4::Bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+// Greedy matching against the last position of every hashed 4 byte sequence.
+// The step grows while no match is found, so that incompressible data is skipped quickly.
+size_t LZ4::Compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity)
+{
+	if (capacity < Bound(size))
+		return 0;
+	unsigned char* op = dst;
+	size_t anchor = 0;
+	if (size > MATCH_LIMIT)
+	{
+		// positions + 1, so that 0 marks an empty entry
+		std::unique_ptr<uint32_t[]> table(new uint32_t[size_t(1) << HASH_LOG](0));
+		size_t match_end = size - LAST_LITERALS;
+		size_t ip = 0;
+		while (ip + MATCH_LIMIT <= size)
+		{
+			uint32_t sequence = read32(src + ip);
+			uint32_t& entry = table[hash4(sequence)];
+			size_t candidate = entry;
+			entry = static_cast<uint32_t>(ip + 1);
+			if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence)
+			{
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			size_t ref = candidate - 1;
+			size_t length = MIN_MATCH;
+			while (ip + length < match_end && src[ref + length] == src[ip + length])
+				++length;
+			op = write_sequence(op, src + anchor, ip - anchor, ip - ref, length);
+			ip += length;
+			anchor = ip;
+		}
+	}
+	op = write_sequence(op, src + anchor, size - anchor, 0, 0);
+	return static_cast<size_t>(op - dst);
+}
+
+static bool read_length(const unsigned char* src, size_t size, size_t& ip, size_t& length)
+{
+	unsigned char byte;
+	do
+	{
+		if (ip >= size)
+			return false;
+		byte = src[ip++];
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool LZ4::Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t raw_size)
+{
+	size_t ip = 0, op = 0;
+	while (ip < size)
+	{
+		unsigned char token = src[ip++];
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !read_length(src, size, ip, literal_length))
+			return false;
+		if (literal_length > size - ip || literal_length > raw_size - op)
+			return false;
+		memcpy(dst + op, src + ip, literal_length);
+		ip += literal_length;
+		op += literal_length;
+		if (ip == size)
+			break;
+
+		if (size - ip < 2)
+			return false;
+		size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > op)
+			return false;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(src, size, ip, match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if (match_length > raw_size - op)
+			return false;
+		unsigned char* out = dst + op;
+		const unsigned char* ref = out - offset;
+		if (offset >= match_length)
+			memcpy(out, ref, match_length);
+		else
+		{
+			// overlapping matches repeat the last offset bytes
+			for (size_t i = 0; i < match_length; ++i)
+				out[i] = ref[i];
+		}
+		op += match_length;
+	}
+	return op == raw_size;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// Compressor and decompressor for the LZ4 block format, without frames or checksums.
+namespace LZ4 {
+
+	// Largest compressed size of size bytes.
+	size_t Bound(size_t size);
+	// Returns the compressed size, or 0 if capacity is below Bound(size).
+	size_t Compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity);
+	// Fails on malformed blocks, and on blocks that do not decompress to exactly raw_size bytes.
+	bool Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t raw_size);
+
+}
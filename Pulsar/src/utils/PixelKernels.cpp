@@ -0,0 +1,607 @@
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PULSAR_PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PULSAR_TARGET_SSE2
+#define PULSAR_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PULSAR_TARGET_SSE2 __attribute__((target("sse2")))
+#define PULSAR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PULSAR_PIXEL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Every kernel processes the texels that fill its registers, and leaves the rest to the scalar kernel.
+struct KernelTable
+{
+	void(*swap_rows)(unsigned char* a, unsigned char* b, size_t bytes);
+	void(*rgb_to_rgba)(const unsigned char* src, unsigned char* dst, size_t count);
+	void(*grey_to_rgba)(const unsigned char* src, unsigned char* dst, size_t count);
+	void(*grey_alpha_to_rgba)(const unsigned char* src, unsigned char* dst, size_t count);
+	void(*premultiply)(unsigned char* rgba, size_t count);
+	// averages texels 2x and 2x + 1 of both rows into texel x of dst
+	void(*downsample_row)(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t dst_count);
+};
+
+// ---------- scalar ----------
+
+static void swap_rows_scalar(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	unsigned char temp[64];
+	for (size_t i = 0; i < bytes; i += sizeof(temp))
+	{
+		size_t n = std::min(sizeof(temp), bytes - i);
+		memcpy(temp, a + i, n);
+		memcpy(a + i, b + i, n);
+		memcpy(b + i, temp, n);
+	}
+}
+
+static void rgb_to_rgba_scalar(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i, src += 3, dst += 4)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255;
+	}
+}
+
+static void grey_to_rgba_scalar(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i, ++src, dst += 4)
+	{
+		dst[0] = dst[1] = dst[2] = *src;
+		dst[3] = 255;
+	}
+}
+
+static void grey_alpha_to_rgba_scalar(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i, src += 2, dst += 4)
+	{
+		dst[0] = dst[1] = dst[2] = src[0];
+		dst[3] = src[1];
+	}
+}
+
+static void premultiply_scalar(unsigned char* rgba, size_t count)
+{
+	for (size_t i = 0; i < count; ++i, rgba += 4)
+	{
+		unsigned int alpha = rgba[3];
+		for (int c = 0; c < 3; ++c)
+			rgba[c] = static_cast<unsigned char>((rgba[c] * alpha + 127) / 255);
+	}
+}
+
+static void downsample_row_scalar(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t dst_count)
+{
+	for (size_t x = 0; x < dst_count; ++x, row0 += 8, row1 += 8, dst += 4)
+	{
+		for (int c = 0; c < 4; ++c)
+			dst[c] = static_cast<unsigned char>((row0[c] + row0[c + 4] + row1[c] + row1[c + 4] + 2) >> 2);
+	}
+}
+
+static constexpr KernelTable SCALAR_KERNELS = { swap_rows_scalar, rgb_to_rgba_scalar, grey_to_rgba_scalar, grey_alpha_to_rgba_scalar,
+	premultiply_scalar, downsample_row_scalar };
+
+#if PULSAR_PIXEL_KERNELS_X86
+
+// ---------- SSE2 ----------
+
+PULSAR_TARGET_SSE2 static void swap_rows_sse2(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), y);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), x);
+	}
+	swap_rows_scalar(a + i, b + i, bytes - i);
+}
+
+// SSE2 has no byte shuffle, so texel k of the 4 loaded is shifted k bytes up into its dword, and the 4 shifts are masked together.
+PULSAR_TARGET_SSE2 static void rgb_to_rgba_sse2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m128i mask0 = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0);
+	const __m128i mask1 = _mm_setr_epi32(0, 0x00FFFFFF, 0, 0);
+	const __m128i mask2 = _mm_setr_epi32(0, 0, 0x00FFFFFF, 0);
+	const __m128i mask3 = _mm_setr_epi32(0, 0, 0, 0x00FFFFFF);
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	// 16 bytes are loaded for 12, so the last 2 texels are left to the scalar kernel
+	for (; i + 6 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+		__m128i out = _mm_or_si128(_mm_and_si128(v, mask0), _mm_and_si128(_mm_slli_si128(v, 1), mask1));
+		out = _mm_or_si128(out, _mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 2), mask2), _mm_and_si128(_mm_slli_si128(v, 3), mask3)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_or_si128(out, alpha));
+	}
+	rgb_to_rgba_scalar(src + 3 * i, dst + 4 * i, count - i);
+}
+
+PULSAR_TARGET_SSE2 static void grey_to_rgba_sse2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m128i opaque = _mm_set1_epi8(-1);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i gg_lo = _mm_unpacklo_epi8(grey, grey), gg_hi = _mm_unpackhi_epi8(grey, grey);
+		__m128i ga_lo = _mm_unpacklo_epi8(grey, opaque), ga_hi = _mm_unpackhi_epi8(grey, opaque);
+		__m128i* out = reinterpret_cast<__m128i*>(dst + 4 * i);
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
+	}
+	grey_to_rgba_scalar(src + i, dst + 4 * i, count - i);
+}
+
+PULSAR_TARGET_SSE2 static void grey_alpha_to_rgba_sse2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m128i low = _mm_set1_epi16(0x00FF);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i ga = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+		__m128i grey = _mm_and_si128(ga, low);
+		__m128i gg = _mm_or_si128(grey, _mm_slli_epi16(grey, 8));
+		__m128i* out = reinterpret_cast<__m128i*>(dst + 4 * i);
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(gg, ga));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+	}
+	grey_alpha_to_rgba_scalar(src + 2 * i, dst + 4 * i, count - i);
+}
+
+// round(c * a / 255) is (x + (x >> 8)) >> 8 for x = c * a + 128. Alpha is multiplied by 255, which leaves it unchanged.
+PULSAR_TARGET_SSE2 static __m128i premultiply_epi16_sse2(__m128i texels)
+{
+	const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alpha), _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(texels, alpha), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+PULSAR_TARGET_SSE2 static void premultiply_sse2(unsigned char* rgba, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i* at = reinterpret_cast<__m128i*>(rgba + 4 * i);
+		__m128i v = _mm_loadu_si128(at);
+		__m128i lo = premultiply_epi16_sse2(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = premultiply_epi16_sse2(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128(at, _mm_packus_epi16(lo, hi));
+	}
+	premultiply_scalar(rgba + 4 * i, count - i);
+}
+
+PULSAR_TARGET_SSE2 static void downsample_row_sse2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t dst_count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+	size_t x = 0;
+	for (; x + 2 <= dst_count; x += 2)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+		// texels 0 and 1, and 2 and 3, summed over both rows
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+		hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+		__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), rounding), 2);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_packus_epi16(sum, sum));
+	}
+	downsample_row_scalar(row0 + 8 * x, row1 + 8 * x, dst + 4 * x, dst_count - x);
+}
+
+static constexpr KernelTable SSE2_KERNELS = { swap_rows_sse2, rgb_to_rgba_sse2, grey_to_rgba_sse2, grey_alpha_to_rgba_sse2,
+	premultiply_sse2, downsample_row_sse2 };
+
+// ---------- AVX2 ----------
+
+PULSAR_TARGET_AVX2 static void swap_rows_avx2(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), y);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(b + i), x);
+	}
+	swap_rows_scalar(a + i, b + i, bytes - i);
+}
+
+// Each 128 bit lane holds 4 texels, which are shuffled into place.
+PULSAR_TARGET_AVX2 static void rgb_to_rgba_avx2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	// the upper lane loads 16 bytes for 12, so the last 2 texels are left to the scalar kernel
+	for (; i + 10 <= count; i += 8)
+	{
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i + 12));
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+	}
+	rgb_to_rgba_scalar(src + 3 * i, dst + 4 * i, count - i);
+}
+
+PULSAR_TARGET_AVX2 static void grey_to_rgba_avx2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m256i replicate = _mm256_set1_epi32(0x00010101);
+	const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m256i lo = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(grey), replicate);
+		__m256i hi = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(grey, 8)), replicate);
+		__m256i* out = reinterpret_cast<__m256i*>(dst + 4 * i);
+		_mm256_storeu_si256(out, _mm256_or_si256(lo, alpha));
+		_mm256_storeu_si256(out + 1, _mm256_or_si256(hi, alpha));
+	}
+	grey_to_rgba_scalar(src + i, dst + 4 * i, count - i);
+}
+
+PULSAR_TARGET_AVX2 static void grey_alpha_to_rgba_avx2(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	const __m256i replicate = _mm256_set1_epi32(0x00010101);
+	const __m256i low = _mm256_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i ga = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i)));
+		__m256i grey = _mm256_mullo_epi32(_mm256_and_si256(ga, low), replicate);
+		__m256i alpha = _mm256_slli_epi32(_mm256_srli_epi32(ga, 8), 24);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), _mm256_or_si256(grey, alpha));
+	}
+	grey_alpha_to_rgba_scalar(src + 2 * i, dst + 4 * i, count - i);
+}
+
+PULSAR_TARGET_AVX2 static __m256i premultiply_epi16_avx2(__m256i texels)
+{
+	const __m256i alpha_lanes = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+	__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm256_blendv_epi8(alpha, _mm256_set1_epi16(255), alpha_lanes);
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(texels, alpha), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+PULSAR_TARGET_AVX2 static void premultiply_avx2(unsigned char* rgba, size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i* at = reinterpret_cast<__m256i*>(rgba + 4 * i);
+		__m256i v = _mm256_loadu_si256(at);
+		__m256i lo = premultiply_epi16_avx2(_mm256_unpacklo_epi8(v, zero));
+		__m256i hi = premultiply_epi16_avx2(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256(at, _mm256_packus_epi16(lo, hi));
+	}
+	premultiply_scalar(rgba + 4 * i, count - i);
+}
+
+PULSAR_TARGET_AVX2 static void downsample_row_avx2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t dst_count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i rounding = _mm256_set1_epi16(2);
+	size_t x = 0;
+	for (; x + 4 <= dst_count; x += 4)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 8 * x));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 8 * x));
+		// per lane, texels 0 and 1, and 2 and 3, summed over both rows
+		__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+		__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+		lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+		hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+		__m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), rounding), 2);
+		// the low 8 bytes of each lane hold 2 texels
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm256_castsi256_si128(packed));
+	}
+	downsample_row_scalar(row0 + 8 * x, row1 + 8 * x, dst + 4 * x, dst_count - x);
+}
+
+static constexpr KernelTable AVX2_KERNELS = { swap_rows_avx2, rgb_to_rgba_avx2, grey_to_rgba_avx2, grey_alpha_to_rgba_avx2,
+	premultiply_avx2, downsample_row_avx2 };
+
+static void cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, static_cast<int>(leaf), 0);
+	for (int i = 0; i < 4; ++i)
+		regs[i] = static_cast<unsigned int>(r[i]);
+#else
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static bool cpu_supports(PixelKernels::ISA isa)
+{
+	unsigned int regs[4];
+	cpuid(0, regs);
+	unsigned int max_leaf = regs[0];
+	cpuid(1, regs);
+	if (isa == PixelKernels::ISA::SSE2)
+		return regs[3] & (1u << 26);
+	if (isa != PixelKernels::ISA::AVX2 || max_leaf < 7)
+		return false;
+	// AVX needs the OS to save YMM registers, which XGETBV reports
+	constexpr unsigned int osxsave = 1u << 27, avx = 1u << 28;
+	if ((regs[2] & (osxsave | avx)) != (osxsave | avx))
+		return false;
+#ifdef _MSC_VER
+	unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	unsigned long long xcr0 = xcr0_lo | (static_cast<unsigned long long>(xcr0_hi) << 32);
+#endif
+	if ((xcr0 & 6) != 6)
+		return false;
+	cpuid(7, regs);
+	return regs[1] & (1u << 5);
+}
+
+#elif PULSAR_PIXEL_KERNELS_NEON
+
+// ---------- NEON ----------
+
+static void swap_rows_neon(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16)
+	{
+		uint8x16_t x = vld1q_u8(a + i);
+		uint8x16_t y = vld1q_u8(b + i);
+		vst1q_u8(a + i, y);
+		vst1q_u8(b + i, x);
+	}
+	swap_rows_scalar(a + i, b + i, bytes - i);
+}
+
+static void rgb_to_rgba_neon(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x3_t rgb = vld3q_u8(src + 3 * i);
+		uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) } };
+		vst4q_u8(dst + 4 * i, rgba);
+	}
+	rgb_to_rgba_scalar(src + 3 * i, dst + 4 * i, count - i);
+}
+
+static void grey_to_rgba_neon(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16_t grey = vld1q_u8(src + i);
+		uint8x16x4_t rgba = { { grey, grey, grey, vdupq_n_u8(255) } };
+		vst4q_u8(dst + 4 * i, rgba);
+	}
+	grey_to_rgba_scalar(src + i, dst + 4 * i, count - i);
+}
+
+static void grey_alpha_to_rgba_neon(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x2_t ga = vld2q_u8(src + 2 * i);
+		uint8x16x4_t rgba = { { ga.val[0], ga.val[0], ga.val[0], ga.val[1] } };
+		vst4q_u8(dst + 4 * i, rgba);
+	}
+	grey_alpha_to_rgba_scalar(src + 2 * i, dst + 4 * i, count - i);
+}
+
+// round(t / 255) for t = c * a is (t + ((t + 128) >> 8) + 128) >> 8, which is a rounding shift followed by a rounding narrowing add.
+static uint8x8_t premultiply_u8_neon(uint8x8_t color, uint8x8_t alpha)
+{
+	uint16x8_t t = vmull_u8(color, alpha);
+	return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+static void premultiply_neon(unsigned char* rgba, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x4_t texels = vld4q_u8(rgba + 4 * i);
+		uint8x8_t alpha_lo = vget_low_u8(texels.val[3]), alpha_hi = vget_high_u8(texels.val[3]);
+		for (int c = 0; c < 3; ++c)
+			texels.val[c] = vcombine_u8(premultiply_u8_neon(vget_low_u8(texels.val[c]), alpha_lo), premultiply_u8_neon(vget_high_u8(texels.val[c]), alpha_hi));
+		vst4q_u8(rgba + 4 * i, texels);
+	}
+	premultiply_scalar(rgba + 4 * i, count - i);
+}
+
+static void downsample_row_neon(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, size_t dst_count)
+{
+	size_t x = 0;
+	for (; x + 8 <= dst_count; x += 8)
+	{
+		uint8x16x4_t a = vld4q_u8(row0 + 8 * x);
+		uint8x16x4_t b = vld4q_u8(row1 + 8 * x);
+		uint8x8x4_t out;
+		for (int c = 0; c < 4; ++c)
+			out.val[c] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c])), 2);
+		vst4_u8(dst + 4 * x, out);
+	}
+	downsample_row_scalar(row0 + 8 * x, row1 + 8 * x, dst + 4 * x, dst_count - x);
+}
+
+static constexpr KernelTable NEON_KERNELS = { swap_rows_neon, rgb_to_rgba_neon, grey_to_rgba_neon, grey_alpha_to_rgba_neon,
+	premultiply_neon, downsample_row_neon };
+
+#endif
+
+// ---------- dispatch ----------
+
+bool PixelKernels::Supported(ISA isa)
+{
+	switch (isa)
+	{
+	case ISA::Scalar:
+		return true;
+#if PULSAR_PIXEL_KERNELS_X86
+	case ISA::SSE2:
+	case ISA::AVX2:
+	{
+		static const bool sse2 = cpu_supports(ISA::SSE2), avx2 = cpu_supports(ISA::AVX2);
+		return isa == ISA::SSE2 ? sse2 : avx2;
+	}
+#elif PULSAR_PIXEL_KERNELS_NEON
+	case ISA::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+static const KernelTable& kernels_of(PixelKernels::ISA isa)
+{
+	switch (isa)
+	{
+#if PULSAR_PIXEL_KERNELS_X86
+	case PixelKernels::ISA::SSE2:
+		return SSE2_KERNELS;
+	case PixelKernels::ISA::AVX2:
+		return AVX2_KERNELS;
+#elif PULSAR_PIXEL_KERNELS_NEON
+	case PixelKernels::ISA::NEON:
+		return NEON_KERNELS;
+#endif
+	default:
+		return SCALAR_KERNELS;
+	}
+}
+
+struct Dispatch
+{
+	PixelKernels::ISA isa = PixelKernels::ISA::Scalar;
+	const KernelTable* kernels = &SCALAR_KERNELS;
+
+	Dispatch()
+	{
+		for (PixelKernels::ISA candidate : { PixelKernels::ISA::SSE2, PixelKernels::ISA::AVX2, PixelKernels::ISA::NEON })
+		{
+			if (PixelKernels::Supported(candidate))
+			{
+				isa = candidate;
+				kernels = &kernels_of(candidate);
+			}
+		}
+	}
+};
+
+// selected on first use, so that kernels called during static initialization are dispatched too
+static Dispatch& dispatch()
+{
+	static Dispatch d;
+	return d;
+}
+
+PixelKernels::ISA PixelKernels::Active()
+{
+	return dispatch().isa;
+}
+
+bool PixelKernels::Select(ISA isa)
+{
+	if (!Supported(isa))
+		return false;
+	dispatch().isa = isa;
+	dispatch().kernels = &kernels_of(isa);
+	return true;
+}
+
+const char* PixelKernels::Name(ISA isa)
+{
+	switch (isa)
+	{
+	case ISA::SSE2:
+		return "SSE2";
+	case ISA::AVX2:
+		return "AVX2";
+	case ISA::NEON:
+		return "NEON";
+	default:
+		return "scalar";
+	}
+}
+
+void PixelKernels::FlipVertically(unsigned char* pixels, int height, size_t stride)
+{
+	auto swap_rows = dispatch().kernels->swap_rows;
+	for (int row = 0; row < height / 2; ++row)
+		swap_rows(pixels + row * stride, pixels + (height - 1 - row) * stride, stride);
+}
+
+void PixelKernels::RGBToRGBA(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	dispatch().kernels->rgb_to_rgba(src, dst, count);
+}
+
+void PixelKernels::GreyToRGBA(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	dispatch().kernels->grey_to_rgba(src, dst, count);
+}
+
+void PixelKernels::GreyAlphaToRGBA(const unsigned char* src, unsigned char* dst, size_t count)
+{
+	dispatch().kernels->grey_alpha_to_rgba(src, dst, count);
+}
+
+void PixelKernels::Premultiply(unsigned char* rgba, size_t count)
+{
+	dispatch().kernels->premultiply(rgba, count);
+}
+
+void PixelKernels::Downsample(const unsigned char* src, int width, int height, unsigned char* dst)
+{
+	int dst_width = std::max(width / 2, 1), dst_height = std::max(height / 2, 1);
+	size_t stride = static_cast<size_t>(width) * 4;
+	auto downsample_row = dispatch().kernels->downsample_row;
+	for (int y = 0; y < dst_height; ++y)
+	{
+		const unsigned char* row0 = src + std::min(2 * y, height - 1) * stride;
+		const unsigned char* row1 = src + std::min(2 * y + 1, height - 1) * stride;
+		unsigned char* out = dst + static_cast<size_t>(y) * dst_width * 4;
+		if (width > 1)
+			downsample_row(row0, row1, out, dst_width);
+		else
+		{
+			for (int c = 0; c < 4; ++c)
+				out[c] = static_cast<unsigned char>((2 * row0[c] + 2 * row1[c] + 2) >> 2);
+		}
+	}
+}
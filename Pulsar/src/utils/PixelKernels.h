@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+// Conversions of 8 bit images, with SSE2, AVX2 and NEON versions that match the scalar versions exactly.
+// The widest instruction set the CPU supports is selected on startup. Counts are in texels.
+namespace PixelKernels {
+
+	enum class ISA : unsigned char
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON
+	};
+
+	bool Supported(ISA isa);
+	ISA Active();
+	// Switches every kernel to isa, if supported. Not safe to call while kernels run on other threads.
+	bool Select(ISA isa);
+	const char* Name(ISA isa);
+
+	// Swaps rows in place, without a temporary row.
+	void FlipVertically(unsigned char* pixels, int height, size_t stride);
+	// Missing alpha is opaque.
+	void RGBToRGBA(const unsigned char* src, unsigned char* dst, size_t count);
+	// Grey is replicated into RGB, and missing alpha is opaque.
+	void GreyToRGBA(const unsigned char* src, unsigned char* dst, size_t count);
+	void GreyAlphaToRGBA(const unsigned char* src, unsigned char* dst, size_t count);
+	// Multiplies RGB by alpha in place, rounding to nearest.
+	void Premultiply(unsigned char* rgba, size_t count);
+	// Averages 2x2 blocks of an RGBA image, rounding halves up, into an image of max(width / 2, 1) x max(height / 2, 1).
+	// The last row and column are repeated for images 1 texel wide or high.
+	void Downsample(const unsigned char* src, int width, int height, unsigned char* dst);
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// Free list of equally sized blocks. Freed blocks are handed out again before the heap is touched.
+class BlockPool
+{
+	std::vector<void*> m_Free;
+	size_t m_BlockSize = 0;
+
+public:
+	BlockPool() = default;
+	BlockPool(const BlockPool&) = delete;
+	BlockPool(BlockPool&&) = delete;
+	~BlockPool()
+	{
+		for (void* block : m_Free)
+			::operator delete(block);
+	}
+
+	void* Allocate(size_t bytes)
+	{
+		if (m_BlockSize == 0)
+			m_BlockSize = bytes;
+		if (bytes != m_BlockSize)
+			return ::operator new(bytes);
+		if (m_Free.empty())
+			return ::operator new(m_BlockSize);
+		void* block = m_Free.back();
+		m_Free.pop_back();
+		return block;
+	}
+
+	void Deallocate(void* block, size_t bytes)
+	{
+		if (bytes == m_BlockSize)
+			m_Free.push_back(block);
+		else
+			::operator delete(block);
+	}
+};
+
+// std-compatible allocator for single objects on a shared BlockPool, e.g. for std::allocate_shared, which allocates one control block at a time.
+// Copies share the pool, and every copy keeps it alive, so objects may outlive the allocator they were created with. The pool is not thread-safe.
+template<typename T>
+struct PoolAllocator
+{
+	typedef T value_type;
+
+	std::shared_ptr<BlockPool> pool;
+
+	PoolAllocator() : pool(std::make_shared<BlockPool>()) {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(pool->Allocate(n * sizeof(T))); }
+	void deallocate(T* ptr, size_t n) { pool->Deallocate(ptr, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+};